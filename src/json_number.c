@@ -0,0 +1,436 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "json_number.h"
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef REDIS_MODULE_TARGET
+#include <alloc.h>
+#endif
+
+#define _isdigit(c) ((unsigned)((c) - '0') < 10)
+
+/* === Parsing === */
+
+/* The powers of ten that are exactly representable as doubles. */
+static const double __exactPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                      1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                      1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* Copies a number to a NUL terminated buffer for strtod and strtoll, to `small` if it fits. */
+static char *__terminated(const char *s, size_t len, char *small, size_t size) {
+    char *copy = len < size ? small : malloc(len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static int __strtoll(const char *s, size_t len, int64_t *v) {
+    char small[64], *eptr;
+    char *copy = __terminated(s, len, small, sizeof(small));
+
+    errno = 0;
+    long long value = strtoll(copy, &eptr, 10);
+    // in lieu of "ERR value is not an integer or out of range"
+    int ret = !len || (errno == ERANGE && (value == LLONG_MAX || value == LLONG_MIN)) ||
+                      (errno != 0 && value == 0) || eptr != copy + len
+                  ? JSONNUMBER_ERR
+                  : JSONNUMBER_OK;
+    if (copy != small) free(copy);
+    *v = value;
+    return ret;
+}
+
+static int __strtod(const char *s, size_t len, double *d) {
+    char small[64], *eptr;
+    char *copy = __terminated(s, len, small, sizeof(small));
+
+    errno = 0;
+    double value = strtod(copy, &eptr);
+    // in lieu of "ERR value is not a double or out of range"
+    int ret = !len || (errno == ERANGE && (value == HUGE_VAL || value == -HUGE_VAL)) ||
+                      (errno != 0 && value == 0) || isnan(value) || eptr != copy + len
+                  ? JSONNUMBER_ERR
+                  : JSONNUMBER_OK;
+    if (copy != small) free(copy);
+    *d = value;
+    return ret;
+}
+
+int JSONNumber_ToInt(const char *s, size_t len, int64_t *v) {
+    const char *c = s, *end = s + len;
+    int neg = c < end && '-' == *c;
+    uint64_t u = 0;
+
+    c += neg;
+    if (c < end && end - c <= 18) {
+        while (c < end && _isdigit(*c)) u = u * 10 + (*c++ - '0');
+        if (c == end) {
+            *v = neg ? -(int64_t)u : (int64_t)u;
+            return JSONNUMBER_OK;
+        }
+    }
+    return __strtoll(s, len, v);
+}
+
+int JSONNumber_ToDouble(const char *s, size_t len, double *d) {
+    const char *c = s, *end = s + len;
+    uint64_t m = 0;  // the significant digits
+    int neg = 0, digits = 0, exp10 = 0;
+
+    if (c < end && '-' == *c) {
+        neg = 1;
+        c++;
+    }
+    if (c == end || !_isdigit(*c)) goto slow;
+    for (; c < end && _isdigit(*c); c++) {
+        if (19 == digits) goto slow;
+        m = m * 10 + (*c - '0');
+        digits += 0 != m;
+    }
+    if (c < end && '.' == *c) {
+        if (++c == end || !_isdigit(*c)) goto slow;
+        for (; c < end && _isdigit(*c); c++) {
+            if (19 == digits) goto slow;
+            m = m * 10 + (*c - '0');
+            digits += 0 != m;
+            exp10--;
+        }
+    }
+    if (c < end && ('e' == *c || 'E' == *c)) {
+        int eneg = 0, e = 0;
+        if (++c < end && ('+' == *c || '-' == *c)) eneg = '-' == *c++;
+        if (c == end || !_isdigit(*c)) goto slow;
+        for (; c < end && _isdigit(*c); c++) {
+            if (e > 1000) goto slow;
+            e = e * 10 + (*c - '0');
+        }
+        exp10 += eneg ? -e : e;
+    }
+    if (c != end) goto slow;
+
+    if (!m) {
+        *d = neg ? -0.0 : 0.0;
+        return JSONNUMBER_OK;
+    }
+
+#if FLT_EVAL_METHOD == 0
+    // Clinger's fast path: when both the significand and the power of ten are exact doubles, a
+    // single multiplication or division rounds correctly. A big exponent can move to a small
+    // significand for as long as it stays exact, e.g. 1e30 is 1000000000 * 1e21.
+    while (exp10 > 22 && m <= (1ull << 53) / 10) {
+        m *= 10;
+        exp10--;
+    }
+    if (m <= (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+        double v = (double)m;
+        v = exp10 < 0 ? v / __exactPow10[-exp10] : v * __exactPow10[exp10];
+        *d = neg ? -v : v;
+        return JSONNUMBER_OK;
+    }
+#endif
+
+slow:
+    return __strtod(s, len, d);
+}
+
+/* === Formatting === */
+
+static const char __digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+size_t JSONNumber_FormatInt(char *buf, int64_t v) {
+    char digits[20], *p = &digits[sizeof(digits)];
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    size_t len = 0;
+
+    // two digits at a time, from the end
+    while (u >= 100) {
+        const char *pair = &__digitPairs[(u % 100) * 2];
+        u /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (u >= 10) {
+        *--p = __digitPairs[u * 2 + 1];
+        *--p = __digitPairs[u * 2];
+    } else {
+        *--p = '0' + u;
+    }
+    if (v < 0) buf[len++] = '-';
+    memcpy(&buf[len], p, &digits[sizeof(digits)] - p);
+    return len + (&digits[sizeof(digits)] - p);
+}
+
+/* Grisu2, from "Printing Floating-Point Numbers Quickly and Accurately with Integers" by Florian
+ * Loitsch, finds the shortest digits in the rounding interval of a double with 64 bit integers, at
+ * the cost of a digit too many for a small fraction of the values. */
+
+static const uint64_t __pow10[] = {1ull,
+                                   10ull,
+                                   100ull,
+                                   1000ull,
+                                   10000ull,
+                                   100000ull,
+                                   1000000ull,
+                                   10000000ull,
+                                   100000000ull,
+                                   1000000000ull,
+                                   10000000000ull,
+                                   100000000000ull,
+                                   1000000000000ull,
+                                   10000000000000ull,
+                                   100000000000000ull,
+                                   1000000000000000ull,
+                                   10000000000000000ull,
+                                   100000000000000000ull,
+                                   1000000000000000000ull,
+                                   10000000000000000000ull};
+
+/* A floating point number with a 64 bit significand, i.e. f * 2^e. */
+typedef struct {
+    uint64_t f;
+    int e;
+} _DiyFp;
+
+/* The normalized 10^k for k = -348, -340, ..., 340. */
+static const struct {
+    uint64_t f;
+    int16_t e;
+} __cachedPowers[] = {
+    {0xfa8fd5a0081c0288ull, -1220}, {0xbaaee17fa23ebf76ull, -1193},
+    {0x8b16fb203055ac76ull, -1166}, {0xcf42894a5dce35eaull, -1140},
+    {0x9a6bb0aa55653b2dull, -1113}, {0xe61acf033d1a45dfull, -1087},
+    {0xab70fe17c79ac6caull, -1060}, {0xff77b1fcbebcdc4full, -1034},
+    {0xbe5691ef416bd60cull, -1007}, {0x8dd01fad907ffc3cull, -980},
+    {0xd3515c2831559a83ull, -954}, {0x9d71ac8fada6c9b5ull, -927},
+    {0xea9c227723ee8bcbull, -901}, {0xaecc49914078536dull, -874},
+    {0x823c12795db6ce57ull, -847}, {0xc21094364dfb5637ull, -821},
+    {0x9096ea6f3848984full, -794}, {0xd77485cb25823ac7ull, -768},
+    {0xa086cfcd97bf97f4ull, -741}, {0xef340a98172aace5ull, -715},
+    {0xb23867fb2a35b28eull, -688}, {0x84c8d4dfd2c63f3bull, -661},
+    {0xc5dd44271ad3cdbaull, -635}, {0x936b9fcebb25c996ull, -608},
+    {0xdbac6c247d62a584ull, -582}, {0xa3ab66580d5fdaf6ull, -555},
+    {0xf3e2f893dec3f126ull, -529}, {0xb5b5ada8aaff80b8ull, -502},
+    {0x87625f056c7c4a8bull, -475}, {0xc9bcff6034c13053ull, -449},
+    {0x964e858c91ba2655ull, -422}, {0xdff9772470297ebdull, -396},
+    {0xa6dfbd9fb8e5b88full, -369}, {0xf8a95fcf88747d94ull, -343},
+    {0xb94470938fa89bcfull, -316}, {0x8a08f0f8bf0f156bull, -289},
+    {0xcdb02555653131b6ull, -263}, {0x993fe2c6d07b7facull, -236},
+    {0xe45c10c42a2b3b06ull, -210}, {0xaa242499697392d3ull, -183},
+    {0xfd87b5f28300ca0eull, -157}, {0xbce5086492111aebull, -130},
+    {0x8cbccc096f5088ccull, -103}, {0xd1b71758e219652cull, -77},
+    {0x9c40000000000000ull, -50}, {0xe8d4a51000000000ull, -24},
+    {0xad78ebc5ac620000ull, 3}, {0x813f3978f8940984ull, 30},
+    {0xc097ce7bc90715b3ull, 56}, {0x8f7e32ce7bea5c70ull, 83},
+    {0xd5d238a4abe98068ull, 109}, {0x9f4f2726179a2245ull, 136},
+    {0xed63a231d4c4fb27ull, 162}, {0xb0de65388cc8ada8ull, 189},
+    {0x83c7088e1aab65dbull, 216}, {0xc45d1df942711d9aull, 242},
+    {0x924d692ca61be758ull, 269}, {0xda01ee641a708deaull, 295},
+    {0xa26da3999aef774aull, 322}, {0xf209787bb47d6b85ull, 348},
+    {0xb454e4a179dd1877ull, 375}, {0x865b86925b9bc5c2ull, 402},
+    {0xc83553c5c8965d3dull, 428}, {0x952ab45cfa97a0b3ull, 455},
+    {0xde469fbd99a05fe3ull, 481}, {0xa59bc234db398c25ull, 508},
+    {0xf6c69a72a3989f5cull, 534}, {0xb7dcbf5354e9beceull, 561},
+    {0x88fcf317f22241e2ull, 588}, {0xcc20ce9bd35c78a5ull, 614},
+    {0x98165af37b2153dfull, 641}, {0xe2a0b5dc971f303aull, 667},
+    {0xa8d9d1535ce3b396ull, 694}, {0xfb9b7cd9a4a7443cull, 720},
+    {0xbb764c4ca7a44410ull, 747}, {0x8bab8eefb6409c1aull, 774},
+    {0xd01fef10a657842cull, 800}, {0x9b10a4e5e9913129ull, 827},
+    {0xe7109bfba19c0c9dull, 853}, {0xac2820d9623bf429ull, 880},
+    {0x80444b5e7aa7cf85ull, 907}, {0xbf21e44003acdd2dull, 933},
+    {0x8e679c2f5e44ff8full, 960}, {0xd433179d9c8cb841ull, 986},
+    {0x9e19db92b4e31ba9ull, 1013}, {0xeb96bf6ebadf77d9ull, 1039},
+    {0xaf87023b9bf0ee6bull, 1066},
+};
+
+static inline _DiyFp __diyfp(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    int be = (int)(bits >> 52 & 0x7ff);
+    uint64_t significand = bits & ((1ull << 52) - 1);
+    if (!be) return (_DiyFp){significand, -1074};  // subnormal
+    return (_DiyFp){significand | (1ull << 52), be - 1075};
+}
+
+static inline _DiyFp __diyfp_normalize(_DiyFp x) {
+    int s = __builtin_clzll(x.f);
+    return (_DiyFp){x.f << s, x.e - s};
+}
+
+/* The product's upper 64 bits, rounded. */
+static inline _DiyFp __diyfp_mul(_DiyFp x, _DiyFp y) {
+    uint64_t a = x.f >> 32, b = x.f & 0xffffffff, c = y.f >> 32, d = y.f & 0xffffffff;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & 0xffffffff) + (bc & 0xffffffff) + (1ull << 31);
+    return (_DiyFp){ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64};
+}
+
+/* The boundaries of the rounding interval of v, halfway to its neighbours, with plus normalized
+ * and minus at the same exponent. */
+static inline void __diyfp_boundaries(_DiyFp v, _DiyFp *minus, _DiyFp *plus) {
+    *plus = __diyfp_normalize((_DiyFp){(v.f << 1) + 1, v.e - 1});
+    // the interval is narrower below a power of two
+    *minus = v.f == 1ull << 52 ? (_DiyFp){(v.f << 2) - 1, v.e - 2}
+                               : (_DiyFp){(v.f << 1) - 1, v.e - 1};
+    minus->f <<= minus->e - plus->e;
+    minus->e = plus->e;
+}
+
+/* Returns the cached power of ten 10^-K that brings a number with exponent `e` into [-60, -32]. */
+static inline _DiyFp __cachedPower(int e, int *K) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;  // log10(2)
+    int k = (int)dk;
+    if (dk - k > 0.0) k++;
+    unsigned i = (unsigned)((k >> 3) + 1);
+    *K = -(-348 + (int)(i << 3));
+    return (_DiyFp){__cachedPowers[i].f, __cachedPowers[i].e};
+}
+
+/* Moves the last digit closer to w while it stays in the interval. */
+static inline void __grisuRound(char *buf, int len, uint64_t delta, uint64_t rest,
+                                uint64_t tenKappa, uint64_t wpw) {
+    while (rest < wpw && delta - rest >= tenKappa &&
+           (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw)) {
+        buf[len - 1]--;
+        rest += tenKappa;
+    }
+}
+
+/* Generates the digits of Mp until they're within delta of it. */
+static inline void __digitGen(_DiyFp W, _DiyFp Mp, uint64_t delta, char *buf, int *len, int *K) {
+    _DiyFp one = {1ull << -Mp.e, Mp.e};
+    uint64_t wpw = Mp.f - W.f;
+    uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    int kappa = 1;
+    while (kappa < 10 && p1 >= __pow10[kappa]) kappa++;
+    *len = 0;
+
+    // the integral part
+    while (kappa > 0) {
+        uint32_t d = (uint32_t)(p1 / __pow10[kappa - 1]);
+        p1 %= __pow10[kappa - 1];
+        if (d || *len) buf[(*len)++] = '0' + d;
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *K += kappa;
+            __grisuRound(buf, *len, delta, rest, __pow10[kappa] << -one.e, wpw);
+            return;
+        }
+    }
+
+    // the fraction
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || *len) buf[(*len)++] = '0' + d;
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            __grisuRound(buf, *len, delta, p2, one.f, -kappa < 20 ? wpw * __pow10[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/* Sets `buf` to the digits of a positive double d, such that d is about buf * 10^K. */
+static void __grisu2(double d, char *buf, int *len, int *K) {
+    _DiyFp v = __diyfp(d), minus, plus;
+    __diyfp_boundaries(v, &minus, &plus);
+    _DiyFp c = __cachedPower(plus.e, K);
+    _DiyFp W = __diyfp_mul(__diyfp_normalize(v), c);
+    _DiyFp Wp = __diyfp_mul(plus, c), Wm = __diyfp_mul(minus, c);
+    // the products are off by up to one unit, so the interval is shrunk to stay inside it
+    Wm.f++;
+    Wp.f--;
+    __digitGen(W, Wp, Wp.f - Wm.f, buf, len, K);
+}
+
+/* Writes the digits, whose value is digits * 10^k, in fixed or exponential notation. */
+static size_t __prettify(char *buf, const char *digits, int len, int k) {
+    int point = len + k;  // the position of the decimal point after the first digit
+    char *p = buf;
+
+    if (k >= 0 && point <= 18) {
+        // an integer, e.g. 1230
+        memcpy(p, digits, len);
+        p += len;
+        memset(p, '0', k);
+        p += k;
+    } else if (k < 0 && point > 0) {
+        // a fraction, e.g. 12.3
+        memcpy(p, digits, point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, &digits[point], len - point);
+        p += len - point;
+    } else if (point > -6 && point <= 0) {
+        // a small fraction, e.g. 0.00123
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        p += -point;
+        memcpy(p, digits, len);
+        p += len;
+    } else {
+        // an exponent, e.g. 1.23e+20
+        int e = point - 1;
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, &digits[1], len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        *p++ = e < 0 ? '-' : '+';
+        if (e < 0) e = -e;
+        if (e >= 100) *p++ = '0' + e / 100;
+        if (e >= 10) *p++ = '0' + e / 10 % 10;
+        *p++ = '0' + e % 10;
+    }
+    return p - buf;
+}
+
+size_t JSONNumber_FormatDouble(char *buf, double d) {
+    char digits[20];
+    int len, k;
+    size_t sign = 0;
+
+    if (!isfinite(d)) return snprintf(buf, JSONNUMBER_MAX_LENGTH, "%g", d);
+    if (signbit(d)) {
+        buf[sign++] = '-';
+        d = -d;
+    }
+    if (0 == d) {
+        buf[sign] = '0';
+        return sign + 1;
+    }
+    __grisu2(d, digits, &len, &k);
+    return sign + __prettify(&buf[sign], digits, len, k);
+}
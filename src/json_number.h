@@ -0,0 +1,59 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __JSON_NUMBER_H__
+#define __JSON_NUMBER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSONNUMBER_OK 0
+#define JSONNUMBER_ERR 1
+
+/* The longest formatted number, e.g. "-2.2250738585072014e-308", with room to spare. */
+#define JSONNUMBER_MAX_LENGTH 32
+
+/**
+* Converts the `len` bytes at `s`, which needn't be NUL terminated, to an integer. Up to 18 digits
+* are converted directly, anything else is passed to strtoll. Returns JSONNUMBER_ERR if the bytes
+* aren't all an integer, or if it is out of range.
+*/
+int JSONNumber_ToInt(const char *s, size_t len, int64_t *v);
+
+/**
+* Converts the `len` bytes at `s`, which needn't be NUL terminated, to the nearest double. Numbers
+* with up to 19 significant digits and a small exponent are converted exactly with a single floating
+* point operation, anything else is passed to strtod, so the result is always correctly rounded.
+* Returns JSONNUMBER_ERR if the bytes aren't all a number, or if it overflows.
+*/
+int JSONNumber_ToDouble(const char *s, size_t len, double *d);
+
+/**
+* Formats an integer into `buf`, which must be JSONNUMBER_MAX_LENGTH long. Returns the length.
+*/
+size_t JSONNumber_FormatInt(char *buf, int64_t v);
+
+/**
+* Formats a double into `buf`, which must be JSONNUMBER_MAX_LENGTH long, with the fewest digits that
+* convert back to the same double, give or take a digit for a fraction of a percent of the values
+* (Grisu2). Returns the length. Integral values under 1e18 have no fraction or exponent (e.g. "3"),
+* other values from 1e-6 up to 1e18 are written with a fraction (e.g. "0.001"), and the rest have
+* an exponent (e.g. "1.5e+300").
+*/
+size_t JSONNumber_FormatDouble(char *buf, double d);
+
+#endif
@@ -15,20 +15,139 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <pthread.h>
 #include "json_object.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* === Parser === */
+
+/**
+* A value that the parsers staged while its container is open. Numbers are staged as values, so a
+* container that's all numbers of the same type is packed without creating nodes for them.
+*/
+typedef struct {
+    union {
+        Node *node;
+        int64_t i;
+        double d;
+    } v;
+    NodeType type;  // N_INTEGER or N_NUMBER for a number, and N_NULL for a node (or null)
+} _JSONStaged;
+
+/**
+* The values of the open containers, in the order of the text. A container is created when it ends
+* from the values that were staged after its start, so it has the capacity for them and no more.
+*/
+typedef struct {
+    _JSONStaged *items;
+    size_t len;
+    size_t cap;  // grown as needed since most values are shallow
+} _JSONStage;
+
+static inline _JSONStaged *_JSONStage_Push(_JSONStage *st) {
+    if (st->len == st->cap) {
+        st->cap = st->cap ? st->cap * 2 : 16;
+        st->items = realloc(st->items, st->cap * sizeof(_JSONStaged));
+    }
+    return &st->items[st->len++];
+}
+
+static inline void _JSONStage_Node(_JSONStage *st, Node *n) {
+    _JSONStaged *s = _JSONStage_Push(st);
+    s->v.node = n;
+    s->type = N_NULL;
+}
+
+static inline void _JSONStage_Int(_JSONStage *st, int64_t i) {
+    _JSONStaged *s = _JSONStage_Push(st);
+    s->v.i = i;
+    s->type = N_INTEGER;
+}
+
+static inline void _JSONStage_Double(_JSONStage *st, double d) {
+    _JSONStaged *s = _JSONStage_Push(st);
+    s->v.d = d;
+    s->type = N_NUMBER;
+}
+
+/* Returns the node of a staged value, which is created for a number. */
+static inline Node *_JSONStaged_Node(const _JSONStaged *s, NodeArena *a) {
+    switch (s->type) {
+        case N_INTEGER:
+            return NewIntNodeEx(a, s->v.i);
+        case N_NUMBER:
+            return NewDoubleNodeEx(a, s->v.d);
+        default:
+            return s->v.node;
+    }
+}
+
+/**
+* Creates an array of the values that were staged from `from` on, and unstages them. The values are
+* packed when they are all numbers of the same type.
+*/
+static Node *_JSONStage_Array(_JSONStage *st, size_t from, NodeArena *a) {
+    const _JSONStaged *items = &st->items[from];
+    uint32_t len = st->len - from;
+    NodeType t = len ? items[0].type : N_NULL;
+    for (uint32_t i = 1; N_NULL != t && i < len; i++) {
+        if (items[i].type != t) t = N_NULL;
+    }
+
+    Node *arr;
+    if (N_INTEGER == t) {
+        arr = NewPackedArrayNodeEx(a, NODE_F_INT_ARRAY, len);
+        for (uint32_t i = 0; i < len; i++) NODE_ARRAY_INTS(arr)[i] = items[i].v.i;
+    } else if (N_NUMBER == t) {
+        arr = NewPackedArrayNodeEx(a, NODE_F_NUM_ARRAY, len);
+        for (uint32_t i = 0; i < len; i++) NODE_ARRAY_NUMS(arr)[i] = items[i].v.d;
+    } else {
+        arr = NewArrayNodeEx(a, len);
+        for (uint32_t i = 0; i < len; i++) Node_ArrayAppend(arr, _JSONStaged_Node(&items[i], a));
+    }
+    st->len = from;
+    return arr;
+}
+
+/**
+* Creates a dictionary of the keys and values that were staged from `from` on, in turns, and
+* unstages them. Only a repeated key, which replaces the earlier one, leaves spare capacity.
+*/
+static Node *_JSONStage_Dict(_JSONStage *st, size_t from, NodeArena *a) {
+    const _JSONStaged *items = &st->items[from];
+    uint32_t len = (st->len - from) / 2;
+    Node *dict = NewDictNodeEx(a, len);
+    for (uint32_t i = 0; i < len; i++) {
+        Node *kv = items[2 * i].v.node;
+        kv->value.kvval.val = _JSONStaged_Node(&items[2 * i + 1], a);
+        Node_DictSetKeyVal(dict, kv);
+    }
+    st->len = from;
+    return dict;
+}
+
+/* Frees the staged values, after an error. */
+static void _JSONStage_Free(_JSONStage *st) {
+    for (size_t i = 0; i < st->len; i++) {
+        if (N_NULL == st->items[i].type) Node_Free(st->items[i].v.node);
+    }
+    st->len = 0;
+}
+
 /* A custom context for the JSON lexer. */
 typedef struct {
     jsonsl_error_t err;  // lexer error
     size_t errpos;       // error position
-    Node **nodes;        // stack of created nodes
-    int nlen;            // size of node stack
+    _JSONStage *stage;   // the values of the open containers, and then the root
+    unsigned maxlevel;   // the deepest level that the lexer pushed, which a reset clears up to
+    NodeArena *arena;    // the arena to create nodes in, or NULL for the heap
 } JsonObjectContext;
 
-#define _pushNode(ctx, n) ctx->nodes[ctx->nlen++] = n
-#define _popNode(ctx) ctx->nodes[--ctx->nlen]
-
 /* Decalre it. */
 static int _AllowedEscapes[];
 static int _IsAllowedWhitespace(unsigned c);
@@ -45,17 +164,11 @@ inline static int errorCallback(jsonsl_t jsn, jsonsl_error_t err, struct jsonsl_
 inline static void pushCallback(jsonsl_t jsn, jsonsl_action_t action, struct jsonsl_state_st *state,
                   const jsonsl_char_t *at) {
     JsonObjectContext *joctx = (JsonObjectContext *)jsn->data;
+    if (state->level > joctx->maxlevel) joctx->maxlevel = state->level;
 
-    // only objects (dictionaries) and lists (arrays) create a container on push
-    switch (state->type) {
-        case JSONSL_T_OBJECT:
-            _pushNode(joctx, NewDictNode(1));
-            break;
-        case JSONSL_T_LIST:
-            _pushNode(joctx, NewArrayNode(1));
-            break;
-        default:
-            break;
+    // jsonsl lets a second root value follow a comma after the first, e.g. '[1],2'
+    if (1 == state->level && joctx->stage->len) {
+        errorCallback(jsn, JSONSL_ERROR_CANT_INSERT, state, NULL);
     }
 }
 
@@ -65,106 +178,106 @@ inline static void popCallback(jsonsl_t jsn, jsonsl_action_t action, struct json
     const char *pos = jsn->base + state->pos_begin;  // element starting position
     size_t len = state->pos_cur - state->pos_begin;  // element length
 
-    // popping string and key values means addingg them to the node stack
+    // popping string and key values means staging them
     if (JSONSL_T_STRING == state->type || JSONSL_T_HKEY == state->type) {
-        char *buffer = NULL;  // a temporary buffer for unescaped strings
-
         // ignore the quote marks
         pos++;
         len--;
 
-        // deal with escapes
-        if (state->nescapes) {
-            jsonsl_error_t err;
-            size_t newlen;
-
-            buffer = calloc(len, sizeof(char));
-            newlen = jsonsl_util_unescape(pos, buffer, len, _AllowedEscapes, &err);
-            if (!newlen) {
-                free(buffer);
-                errorCallback(jsn, err, state, NULL);
-                return;
+        if (joctx->arena) {
+            // the lexer is done with the string, so the arena's copy of the text is rewritten in place
+            char *s = (char *)pos;
+            if (state->nescapes) {
+                // unescaping never lengthens the string
+                jsonsl_error_t err;
+                len = jsonsl_util_unescape(pos, s, len, _AllowedEscapes, &err);
+                if (!len) {
+                    errorCallback(jsn, err, state, NULL);
+                    return;
+                }
             }
+            s[len] = '\0';  // overwrites the closing quote mark
 
-            pos = buffer;
-            len = newlen;
-        }
+            Node *n;
+            if (JSONSL_T_STRING == state->type) n = NewStringNodeFromArena(joctx->arena, s, len);
+            else n = NewKeyValNodeEx(joctx->arena, s, len, NULL);  // NULL is a placeholder
+            _JSONStage_Node(joctx->stage, n);
+        } else {
+            char *buffer = NULL;  // a temporary buffer for unescaped strings
 
-        // push it
-        Node *n;
-        if (JSONSL_T_STRING == state->type) n = NewStringNode(pos, len);
-        else n = NewKeyValNode(pos, len, NULL);  // NULL is a placeholder for now
-        _pushNode(joctx, n);
+            // deal with escapes
+            if (state->nescapes) {
+                jsonsl_error_t err;
+                size_t newlen;
 
-        if (buffer) free(buffer);
+                buffer = calloc(len, sizeof(char));
+                newlen = jsonsl_util_unescape(pos, buffer, len, _AllowedEscapes, &err);
+                if (!newlen) {
+                    free(buffer);
+                    errorCallback(jsn, err, state, NULL);
+                    return;
+                }
+
+                pos = buffer;
+                len = newlen;
+            }
+
+            // stage it
+            Node *n;
+            if (JSONSL_T_STRING == state->type) n = NewStringNode(pos, len);
+            else n = NewKeyValNode(pos, len, NULL);  // NULL is a placeholder for now
+            _JSONStage_Node(joctx->stage, n);
+
+            if (buffer) free(buffer);
+        }
     }
 
-    // popped special values are also added to the node stack
+    // popped special values are also staged, numbers as values
     if (JSONSL_T_SPECIAL == state->type) {
         if (state->special_flags & JSONSL_SPECIALf_NUMERIC) {
             if (state->special_flags & (JSONSL_SPECIALf_FLOAT | JSONSL_SPECIALf_EXPONENT)) {
-                // convert to double
                 double value;
-                char *eptr;
-
-                errno = 0;
-                value = strtod (pos, &eptr);
-                // in lieu of "ERR value is not a double or out of range"
-                if ((errno == ERANGE && (value == HUGE_VAL || value == -HUGE_VAL)) || 
-                    (errno != 0 && value == 0) ||
-                    isnan(value) ||
-                    (eptr != pos + len)) {
-                        errorCallback(jsn, JSONSL_ERROR_INVALID_NUMBER, state, NULL);
-                        return;
+                if (JSONNUMBER_OK != JSONNumber_ToDouble(pos, len, &value)) {
+                    errorCallback(jsn, JSONSL_ERROR_INVALID_NUMBER, state, NULL);
+                    return;
                 }
-                _pushNode(joctx, NewDoubleNode(value));
+                _JSONStage_Double(joctx->stage, value);
             } else {
-                // convert long long (int64_t)
-                long long value;
-                char *eptr;
-
-                errno = 0;
-                value = strtoll(pos, &eptr, 10);
-                // in lieu of "ERR value is not an integer or out of range"
-                if ((errno == ERANGE && (value == LLONG_MAX || value == LLONG_MIN)) ||
-                    (errno != 0 && value == 0) ||
-                    (eptr != pos + len)) {
-                        errorCallback(jsn, JSONSL_ERROR_INVALID_NUMBER, state, NULL);
-                        return;
+                int64_t value;
+                if (JSONNUMBER_OK != JSONNumber_ToInt(pos, len, &value)) {
+                    errorCallback(jsn, JSONSL_ERROR_INVALID_NUMBER, state, NULL);
+                    return;
                 }
-
-                _pushNode(joctx, NewIntNode((int64_t)value));
+                _JSONStage_Int(joctx->stage, value);
             }
         } else if (state->special_flags & JSONSL_SPECIALf_BOOLEAN) {
-            _pushNode(joctx, NewBoolNode(state->special_flags & JSONSL_SPECIALf_TRUE));
+            Node *n = NewBoolNodeEx(joctx->arena, state->special_flags & JSONSL_SPECIALf_TRUE);
+            _JSONStage_Node(joctx->stage, n);
         } else if (state->special_flags & JSONSL_SPECIALf_NULL) {
-            _pushNode(joctx, NULL);
+            _JSONStage_Node(joctx->stage, NULL);
         }
     }
 
-    // anything that pops needs to be set in its parent, except the root element and keys
-    if (joctx->nlen > 1 && state->type != JSONSL_T_HKEY) {
-        NodeType p = joctx->nodes[joctx->nlen - 2]->type;
-        switch (p) {
-            case N_DICT:
-                Node_DictSetKeyVal(joctx->nodes[joctx->nlen - 1], _popNode(joctx));
-                break;
-            case N_ARRAY:
-                Node_ArrayAppend(joctx->nodes[joctx->nlen - 1], _popNode(joctx));
-                break;
-            case N_KEYVAL:
-                joctx->nodes[joctx->nlen - 2]->value.kvval.val = _popNode(joctx);
-                Node_DictSetKeyVal(joctx->nodes[joctx->nlen - 1], _popNode(joctx));
-                break;
-            default:
-                break;
+    // a popped container is created from its elements, the last ones that were staged
+    if (JSONSL_T_OBJECT == state->type || JSONSL_T_LIST == state->type) {
+        _JSONStage *st = joctx->stage;
+        if (state->nelem > st->len) {
+            errorCallback(jsn, JSONSL_ERROR_CANT_INSERT, state, NULL);
+            return;
         }
+        size_t from = st->len - state->nelem;
+        Node *n = JSONSL_T_OBJECT == state->type ? _JSONStage_Dict(st, from, joctx->arena)
+                                                 : _JSONStage_Array(st, from, joctx->arena);
+        _JSONStage_Node(st, n);
     }
 }
 
-int CreateNodeFromJSON(const char *buf, size_t len, Node **node, char **err) {
-    int levels = JSONSL_MAX_LEVELS;  // TODO: heur levels from len since we're not really streaming?
-
+/**
+* Parses the text with jsonsl, which reports the errors of both engines. The lexer and its context
+* are reused between parses, and are reset by the caller afterwards.
+*/
+static int _JSONSLParse(jsonsl_t jsn, JsonObjectContext *joctx, const char *buf, size_t len,
+                        NodeArena *arena, Node **node, char **err) {
     size_t _off = 0, _len = len;
     char *_buf = (char *)buf;
     int is_scalar = 0;
@@ -178,25 +291,20 @@ int CreateNodeFromJSON(const char *buf, size_t len, Node **node, char **err) {
     */
     if ((is_scalar = ('{' != _buf[_off]) && ('[' != _buf[_off]) && _off < _len)) {
         _len = _len - _off + 2;
-        _buf = malloc(_len * sizeof(char));
+        _buf = arena ? NodeArena_Alloc(arena, _len, 1) : malloc(_len * sizeof(char));
         _buf[0] = '[';
         _buf[_len - 1] = ']';
         memcpy(&_buf[1], &buf[_off], len - _off);
+    } else if (arena) {
+        /* A document in an arena keeps a copy of the text, which strings and keys are unescaped into
+         * in place, so their nodes reference it instead of allocating copies of their own.
+        */
+        _buf = NodeArena_Alloc(arena, _len, 1);
+        memcpy(_buf, buf, _len);
     }
 
-    /* The lexer. */
-    jsonsl_t jsn = jsonsl_new(levels);
-    jsn->error_callback = errorCallback;
-    jsn->action_callback_POP = popCallback;
-    jsn->action_callback_PUSH = pushCallback;
-    jsonsl_enable_all_callbacks(jsn);
-
-    /* Set up our custom context. */
-    JsonObjectContext *joctx = calloc(1, sizeof(JsonObjectContext));
-    joctx->nodes = calloc(levels, sizeof(Node *));
-    jsn->data = joctx;
-
     /* Feed the lexer. */
+    joctx->arena = arena;
     jsonsl_feed(jsn, _buf, _len);
 
     /* Check for lexer errors. */
@@ -220,21 +328,20 @@ int CreateNodeFromJSON(const char *buf, size_t len, Node **node, char **err) {
         goto error;
     }
 
-    /* Finalize. */
+    /* Finalize, the root is the only value that's left staged. */
+    Node *root = _JSONStaged_Node(&joctx->stage->items[0], arena);
+    joctx->stage->len = 0;
     if (is_scalar) {
         // extract the scalar and discard the wrapper array
-        Node_ArrayItem(joctx->nodes[0], 0, node);
-        Node_ArraySet(joctx->nodes[0], 0, NULL);
-        Node_Free(_popNode(joctx));
-        free(_buf);
+        Node_ArrayItem(root, 0, node);
+        Node_ArraySet(root, 0, NULL);
+        Node_Free(root);
     } else {
-        *node = _popNode(joctx);
+        *node = root;
     }
 
+    if (is_scalar && !arena) free(_buf);
     sdsfree(serr);
-    free(joctx->nodes);
-    free(joctx);
-    jsonsl_destroy(jsn);
 
     return JSONOBJECT_OK;
 
@@ -244,17 +351,627 @@ error:
         *err = strdup(serr);
     }
 
-    // free any nodes that are in the stack
-    while (joctx->nlen) Node_Free(_popNode(joctx));
+    // free any nodes that are staged
+    _JSONStage_Free(joctx->stage);
 
+    if (is_scalar && !arena) free(_buf);
     sdsfree(serr);
-    free(joctx->nodes);
-    free(joctx);
-    jsonsl_destroy(jsn);
 
     return JSONOBJECT_ERROR;
 }
 
+/* === Indexed parser === */
+
+JSONObjectParser jsonObjectParser = JSONOBJECT_PARSER_JSONSL;
+
+/* The deepest nesting of containers that the indexed parser builds, jsonsl's limit is higher. */
+#define _JSONINDEX_MAX_DEPTH (JSONSL_MAX_LEVELS - 8)
+
+/* Bitmasks that classify a block of 64 bytes of text, a bit per byte. */
+typedef struct {
+    uint64_t quote;      // quotation marks
+    uint64_t backslash;  // reverse solidi
+    uint64_t op;         // structural characters: {}[]:,
+    uint64_t ws;         // whitespace: space, tab, line feed and carriage return
+    uint64_t ctrl;       // control characters, which strings can't have
+} _JSONBlock;
+
+/* The positions of the structural characters and of the first characters of other values. */
+typedef struct {
+    uint32_t *pos;
+    size_t len;
+    size_t cap;
+    int escapes;  // whether the text has any backslashes, without which no string has escapes
+} _JSONIndex;
+
+static inline void _JSONBlock_Classify(const char *p, _JSONBlock *b) {
+#if defined(__AVX2__)
+    for (int i = 0; i < 64; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));  // '[' and ']' to '{' and '}'
+        __m256i op = _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                                     _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}')));
+        op = _mm256_or_si256(op, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+        op = _mm256_or_si256(op, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        ws = _mm256_or_si256(ws, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        ws = _mm256_or_si256(ws, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        __m256i ctrl = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x1f)),
+                                         _mm256_set1_epi8(0x1f));
+        __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+        __m256i backslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+        b->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(quote) << i;
+        b->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(backslash) << i;
+        b->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << i;
+        b->ws |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << i;
+        b->ctrl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ctrl) << i;
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));  // '[' and ']' to '{' and '}'
+        __m128i op = _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                  _mm_cmpeq_epi8(folded, _mm_set1_epi8('}')));
+        op = _mm_or_si128(op, _mm_cmpeq_epi8(v, _mm_set1_epi8(':')));
+        op = _mm_or_si128(op, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        ws = _mm_or_si128(ws, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        ws = _mm_or_si128(ws, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+        b->quote |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        b->backslash |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        b->op |= (uint64_t)_mm_movemask_epi8(op) << i;
+        b->ws |= (uint64_t)_mm_movemask_epi8(ws) << i;
+        b->ctrl |= (uint64_t)_mm_movemask_epi8(ctrl) << i;
+    }
+#else
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = 1ULL << i;
+        unsigned char c = p[i];
+        switch (c) {
+            case '"':
+                b->quote |= bit;
+                break;
+            case '\\':
+                b->backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                b->op |= bit;
+                break;
+            case ' ':
+                b->ws |= bit;
+                break;
+            case '\t':
+            case '\n':
+            case '\r':
+                b->ws |= bit;
+                b->ctrl |= bit;
+                break;
+            default:
+                if (c < 0x20) b->ctrl |= bit;
+                break;
+        }
+    }
+#endif
+}
+
+/* Returns the mask with every bit set to the parity of the bits up to and including it. */
+static inline uint64_t _JSONBlock_PrefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/**
+* Returns the characters that are escaped, i.e. that follow an odd run of backslashes. `carry` is
+* set when the block ends with one, so the next block's first character is escaped.
+*/
+static inline uint64_t _JSONBlock_Escaped(uint64_t backslash, uint64_t *carry) {
+    const uint64_t even = 0x5555555555555555ULL;
+    if (!backslash && !*carry) return 0;
+
+    backslash &= ~*carry;  // an escaped backslash escapes nothing
+    uint64_t follows = backslash << 1 | *carry;
+    // adding a run's first bit to it carries past its end, which tells the run's length parity
+    uint64_t oddstarts = backslash & ~even & ~follows;
+    uint64_t evenruns = oddstarts + backslash;
+    *carry = evenruns < backslash;
+    return (even ^ (evenruns << 1)) & follows;
+}
+
+/**
+* Builds the index of the text's structural positions: the quotation marks around strings, the
+* structural characters outside of them and the first characters of numbers, true, false and null.
+* Returns OBJ_ERR for text that the indexed parser leaves to jsonsl: unterminated strings, strings
+* with control characters and texts longer than the positions can express.
+*/
+static int _JSONIndex_Build(const char *buf, size_t len, _JSONIndex *idx) {
+    uint64_t escaped = 0;   // whether the next block starts with an escaped character
+    uint64_t instring = 0;  // all set when the next block starts inside a string
+    uint64_t follows = 1;   // whether the next block's first character follows a separator
+
+    if (len > UINT32_MAX) return OBJ_ERR;
+    idx->len = 0;
+    idx->escapes = 0;
+    for (size_t off = 0; off < len; off += 64) {
+        _JSONBlock b = {0};
+        if (len - off >= 64) {
+            _JSONBlock_Classify(&buf[off], &b);
+        } else {
+            // the last block is padded with whitespace, which is never indexed
+            char tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, &buf[off], len - off);
+            _JSONBlock_Classify(tail, &b);
+        }
+
+        idx->escapes |= !!b.backslash;
+        uint64_t quote = b.quote & ~_JSONBlock_Escaped(b.backslash, &escaped);
+        uint64_t strings = _JSONBlock_PrefixXor(quote) ^ instring;  // opening quotes included
+        instring = (uint64_t)((int64_t)strings >> 63);
+        if (b.ctrl & strings) return OBJ_ERR;
+
+        uint64_t separators = b.op | b.ws | quote;
+        uint64_t starts = ~separators & (separators << 1 | follows);
+        follows = separators >> 63;
+
+        uint64_t structural = ((b.op | starts) & ~strings) | quote;
+        if (idx->cap - idx->len < 64) {
+            idx->cap = idx->cap ? idx->cap * 2 : 64 + len / 4;
+            idx->pos = realloc(idx->pos, idx->cap * sizeof(uint32_t));
+        }
+        while (structural) {
+            idx->pos[idx->len++] = (uint32_t)(off + __builtin_ctzll(structural));
+            structural &= structural - 1;
+        }
+    }
+
+    return instring ? OBJ_ERR : OBJ_OK;
+}
+
+/* The state of the indexed parser's second pass, which builds the nodes. */
+typedef struct {
+    char *buf;            // the text, or the arena's copy of it that strings are unescaped into
+    size_t len;           // the text's length
+    const uint32_t *pos;  // the text's structural positions
+    size_t npos;          // the number of structural positions
+    int escapes;          // whether the text has any backslashes
+    size_t i;             // the next structural position
+    NodeArena *arena;     // the arena to create nodes in, or NULL for the heap
+} _JSONIndexedParser;
+
+/* Returns whether the character can follow a number or a literal. */
+static inline int _JSONIsDelimiter(char c) {
+    switch (c) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+        case '"':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+#define _isdigit(c) ('0' <= (c) && (c) <= '9')
+
+/* Creates a string, or a key when `iskey` is set, from the text between two quotation marks. */
+static int _JSONIndexed_String(_JSONIndexedParser *p, size_t open, size_t close, int iskey,
+                               Node **n) {
+    char *s = &p->buf[open + 1];
+    size_t len = close - open - 1;
+    int escapes = p->escapes && NULL != memchr(s, '\\', len);
+    jsonsl_error_t err;
+
+    if (p->arena) {
+        // unescaping never lengthens the string
+        if (escapes && !(len = jsonsl_util_unescape(s, s, len, _AllowedEscapes, &err))) {
+            return OBJ_ERR;
+        }
+        s[len] = '\0';  // overwrites the closing quote mark
+        *n = iskey ? NewKeyValNodeEx(p->arena, s, len, NULL)
+                   : NewStringNodeFromArena(p->arena, s, len);
+        return OBJ_OK;
+    }
+
+    char *buffer = NULL;  // a temporary buffer for unescaped strings
+    if (escapes) {
+        buffer = calloc(len, sizeof(char));
+        if (!(len = jsonsl_util_unescape(s, buffer, len, _AllowedEscapes, &err))) {
+            free(buffer);
+            return OBJ_ERR;
+        }
+        s = buffer;
+    }
+    *n = iskey ? NewKeyValNode(s, len, NULL) : NewStringNode(s, len);
+    free(buffer);
+    return OBJ_OK;
+}
+
+/**
+* Converts the number at `s`, which must follow the JSON grammar and be followed by whitespace, a
+* structural character or `end`. Sets `isint`, and `i` or `d` by it, and returns the number's
+* length, or 0 if it isn't valid.
+*/
+static size_t _JSONParseNumber(const char *s, const char *end, int *isint, int64_t *i,
+                               double *d) {
+    const char *c = s;
+
+    *isint = 1;
+    if (c < end && '-' == *c) c++;
+    if (c < end && '0' == *c) {
+        c++;
+    } else {
+        if (c == end || !_isdigit(*c)) return 0;
+        while (c < end && _isdigit(*c)) c++;
+    }
+    if (c < end && '.' == *c) {
+        *isint = 0;
+        if (++c == end || !_isdigit(*c)) return 0;
+        while (c < end && _isdigit(*c)) c++;
+    }
+    if (c < end && ('e' == *c || 'E' == *c)) {
+        *isint = 0;
+        if (++c < end && ('+' == *c || '-' == *c)) c++;
+        if (c == end || !_isdigit(*c)) return 0;
+        while (c < end && _isdigit(*c)) c++;
+    }
+    if (c < end && !_JSONIsDelimiter(*c)) return 0;
+
+    size_t len = c - s;
+    if (*isint) return JSONNUMBER_OK == JSONNumber_ToInt(s, len, i) ? len : 0;
+    return JSONNUMBER_OK == JSONNumber_ToDouble(s, len, d) ? len : 0;
+}
+
+/* Matches the literal at `s`, which must be followed like a number. */
+static int _JSONMatchLiteral(const char *s, const char *end, const char *lit) {
+    size_t len = strlen(lit);
+    if ((size_t)(end - s) < len || memcmp(s, lit, len)) return 0;
+    return (size_t)(end - s) == len || _JSONIsDelimiter(s[len]);
+}
+
+/**
+* Parses the text with its structural index, returning JSONOBJECT_ERROR for anything that isn't
+* valid JSON. The parser is strict and may also reject some of what jsonsl accepts.
+*/
+static int _JSONIndexedParse(_JSONIndex *idx, _JSONStage *st, const char *buf, size_t len,
+                             NodeArena *arena, Node **node) {
+    _JSONIndexedParser p = {.buf = (char *)buf, .len = len, .arena = arena};
+    // where the values of each open container start on the stage, shifted left of whether it's a
+    // dictionary
+    size_t frames[_JSONINDEX_MAX_DEPTH];
+    int depth = 0, isdict;
+    Node *v = NULL;
+    size_t begin;
+    const char *end = NULL;  // the end of the text that the nodes are built from
+    NodeArenaMark mark;
+
+    // text that's rejected is parsed again by jsonsl, so what was allocated for it is released
+    if (arena) NodeArena_Mark(arena, &mark);
+    if (OBJ_OK != _JSONIndex_Build(buf, len, idx) || !idx->len) goto error;
+    p.pos = idx->pos;
+    p.npos = idx->len;
+    p.escapes = idx->escapes;
+    if (arena) {
+        // strings are unescaped into the arena's copy of the text and their nodes reference it
+        p.buf = NodeArena_Alloc(arena, len, 1);
+        memcpy(p.buf, buf, len);
+    }
+    end = &p.buf[len];
+
+value:
+    if (p.i == p.npos) goto error;
+    begin = p.pos[p.i++];
+    switch (p.buf[begin]) {
+        case '{':
+        case '[':
+            isdict = '{' == p.buf[begin];
+            if (depth == _JSONINDEX_MAX_DEPTH) goto error;
+            frames[depth++] = st->len << 1 | isdict;
+            if (p.i < p.npos && p.buf[p.pos[p.i]] == (isdict ? '}' : ']')) {
+                p.i++;
+                goto close;
+            }
+            if (isdict) goto key;
+            goto value;
+        case '"':
+            if (p.i == p.npos || OBJ_OK != _JSONIndexed_String(&p, begin, p.pos[p.i++], 0, &v)) {
+                goto error;
+            }
+            goto complete;
+        case 't':
+        case 'f':
+            if (!_JSONMatchLiteral(&p.buf[begin], end, 't' == p.buf[begin] ? "true" : "false")) {
+                goto error;
+            }
+            v = NewBoolNodeEx(arena, 't' == p.buf[begin]);
+            goto complete;
+        case 'n':
+            if (!_JSONMatchLiteral(&p.buf[begin], end, "null")) goto error;
+            v = NULL;
+            goto complete;
+        default: {
+            int isint;
+            int64_t i;
+            double d;
+            if (!_JSONParseNumber(&p.buf[begin], end, &isint, &i, &d)) goto error;
+            // numbers in containers are staged as values, so that numeric arrays are packed
+            if (depth) {
+                if (isint) _JSONStage_Int(st, i);
+                else _JSONStage_Double(st, d);
+                goto next;
+            }
+            v = isint ? NewIntNodeEx(arena, i) : NewDoubleNodeEx(arena, d);
+            goto complete;
+        }
+    }
+
+complete:
+    // the value is staged in its container, or is the root
+    if (!depth) {
+        if (p.i != p.npos) {
+            Node_Free(v);
+            goto error;
+        }
+        *node = v;
+        return JSONOBJECT_OK;
+    }
+    _JSONStage_Node(st, v);
+
+next:
+    // a value in a container is followed by a comma or the container's end
+    if (p.i == p.npos) goto error;
+    begin = p.pos[p.i++];
+    isdict = frames[depth - 1] & 1;
+    if (',' == p.buf[begin]) {
+        if (isdict) goto key;
+        goto value;
+    }
+    if (p.buf[begin] != (isdict ? '}' : ']')) goto error;
+
+close:
+    // the container is created from the values that were staged since it started
+    depth--;
+    v = frames[depth] & 1 ? _JSONStage_Dict(st, frames[depth] >> 1, arena)
+                          : _JSONStage_Array(st, frames[depth] >> 1, arena);
+    goto complete;
+
+key:
+    if (p.i + 2 >= p.npos) goto error;
+    begin = p.pos[p.i++];
+    if ('"' != p.buf[begin] || OBJ_OK != _JSONIndexed_String(&p, begin, p.pos[p.i++], 1, &v)) {
+        goto error;
+    }
+    _JSONStage_Node(st, v);
+    if (':' != p.buf[p.pos[p.i++]]) goto error;
+    goto value;
+
+error:
+    _JSONStage_Free(st);
+    if (arena) NodeArena_Rewind(arena, &mark);
+    return JSONOBJECT_ERROR;
+}
+
+/* === Scalars === */
+
+#define _isjsonspace(c) (' ' == (c) || '\t' == (c) || '\n' == (c) || '\r' == (c))
+
+/**
+* Creates a string from the text between the quotation marks at `s` and `end - 1`, unescaping it
+* straight into the arena when there is one.
+*/
+static int _JSONScalar_String(const char *s, const char *end, int escapes, NodeArena *arena,
+                              Node **node) {
+    const char *str = s + 1;
+    size_t len = end - s - 2;
+    jsonsl_error_t err;
+
+    if (!escapes) {
+        *node = NewStringNodeEx(arena, str, len);
+        return JSONOBJECT_OK;
+    }
+
+    // unescaping never lengthens the string
+    char small[256];
+    char *buffer = arena ? NodeArena_Alloc(arena, len + 1, 1)
+                         : len <= sizeof(small) ? small : malloc(len);
+    size_t newlen = jsonsl_util_unescape(str, buffer, len, _AllowedEscapes, &err);
+    if (newlen) {
+        if (arena) {
+            buffer[newlen] = '\0';
+            *node = NewStringNodeFromArena(arena, buffer, newlen);
+        } else {
+            *node = NewStringNode(buffer, newlen);
+        }
+    }
+    if (!arena && buffer != small) free(buffer);
+    return newlen ? JSONOBJECT_OK : JSONOBJECT_ERROR;
+}
+
+/**
+* Parses a text that's a single number, string, true, false or null in one pass, without the copy
+* of it in a list that jsonsl needs. Returns JSONOBJECT_ERROR for any other text, including
+* invalid scalars, which are left to the engines to report.
+*/
+static int _JSONParseScalar(const char *buf, size_t len, NodeArena *arena, Node **node) {
+    const char *s = buf, *end = buf + len;
+    while (s < end && _isjsonspace(*s)) s++;
+    while (end > s && _isjsonspace(end[-1])) end--;
+    if (s == end) return JSONOBJECT_ERROR;
+
+    switch (*s) {
+        case '{':
+        case '[':
+            return JSONOBJECT_ERROR;
+        case '"': {
+            // the closing quotation mark ends the text, and strings can't have control characters
+            int escapes = 0;
+            const char *c = s + 1;
+            while (c < end && '"' != *c) {
+                if ((unsigned char)*c < 0x20) return JSONOBJECT_ERROR;
+                if ('\\' == *c) {
+                    escapes = 1;
+                    c++;
+                }
+                c++;
+            }
+            if (c != end - 1) return JSONOBJECT_ERROR;
+            return _JSONScalar_String(s, end, escapes, arena, node);
+        }
+        case 't':
+        case 'f':
+        case 'n': {
+            const char *lit = 't' == *s ? "true" : 'f' == *s ? "false" : "null";
+            if ((size_t)(end - s) != strlen(lit) || memcmp(s, lit, end - s)) {
+                return JSONOBJECT_ERROR;
+            }
+            *node = 'n' == *s ? NULL : NewBoolNodeEx(arena, 't' == *s);
+            return JSONOBJECT_OK;
+        }
+        default: {
+            int isint;
+            int64_t i;
+            double d;
+            if (_JSONParseNumber(s, end, &isint, &i, &d) != (size_t)(end - s)) {
+                return JSONOBJECT_ERROR;
+            }
+            *node = isint ? NewIntNodeEx(arena, i) : NewDoubleNodeEx(arena, d);
+            return JSONOBJECT_OK;
+        }
+    }
+}
+
+/* === Parser contexts === */
+
+/* The state of the parsers, which is pooled so that parsing small values doesn't allocate it. */
+typedef struct t_jsonParser {
+    struct t_jsonParser *next;  // the next context in the pool
+    jsonsl_t jsn;               // jsonsl's lexer, created when it's first needed
+    JsonObjectContext joctx;    // the lexer's context
+    _JSONIndex idx;             // the indexed parser's positions
+    _JSONStage stage;           // the values that both parsers stage
+} _JSONParser;
+
+// the number of contexts that are kept for reuse, enough for the threads that parse concurrently
+#define _JSONPARSER_POOL_SIZE 8
+// the most positions that a pooled context keeps, so the index of a huge text isn't kept around
+#define _JSONPARSER_MAX_POOLED_POSITIONS (64 * 1024)
+// the most staged values that a pooled context keeps room for, for the same reason
+#define _JSONPARSER_MAX_POOLED_STAGED (16 * 1024)
+
+static struct {
+    pthread_mutex_t lock;
+    _JSONParser *head;
+    int len;
+} _parserPool = {PTHREAD_MUTEX_INITIALIZER};
+
+static _JSONParser *_JSONParser_Acquire() {
+    pthread_mutex_lock(&_parserPool.lock);
+    _JSONParser *p = _parserPool.head;
+    if (p) {
+        _parserPool.head = p->next;
+        _parserPool.len--;
+    }
+    pthread_mutex_unlock(&_parserPool.lock);
+    return p ? p : calloc(1, sizeof(_JSONParser));
+}
+
+static jsonsl_t _JSONParser_Lexer(_JSONParser *p) {
+    if (!p->jsn) {
+        p->jsn = jsonsl_new(JSONSL_MAX_LEVELS);
+        p->jsn->error_callback = errorCallback;
+        p->jsn->action_callback_POP = popCallback;
+        p->jsn->action_callback_PUSH = pushCallback;
+        jsonsl_enable_all_callbacks(p->jsn);
+        p->jsn->data = &p->joctx;
+        p->joctx.stage = &p->stage;
+    }
+    return p->jsn;
+}
+
+/* Resets the context for the next parse and returns it to the pool, or frees it if it's full. */
+static void _JSONParser_Release(_JSONParser *p) {
+    jsonsl_t jsn = p->jsn;
+    if (jsn) {
+        // the states are cleared like a new lexer's, since errors report positions from them
+        for (unsigned int i = 0; i <= p->joctx.maxlevel; i++) {
+            memset(&jsn->stack[i], 0, sizeof(jsn->stack[i]));
+            jsn->stack[i].level = i;
+        }
+        jsonsl_reset(jsn);
+    }
+    p->joctx.err = JSONSL_ERROR_SUCCESS;
+    p->joctx.errpos = 0;
+    p->joctx.maxlevel = 0;
+    p->joctx.arena = NULL;
+    if (p->idx.cap > _JSONPARSER_MAX_POOLED_POSITIONS) {
+        free(p->idx.pos);
+        p->idx.pos = NULL;
+        p->idx.cap = 0;
+    }
+    if (p->stage.cap > _JSONPARSER_MAX_POOLED_STAGED) {
+        free(p->stage.items);
+        p->stage.items = NULL;
+        p->stage.cap = 0;
+    }
+
+    pthread_mutex_lock(&_parserPool.lock);
+    if (_parserPool.len < _JSONPARSER_POOL_SIZE) {
+        p->next = _parserPool.head;
+        _parserPool.head = p;
+        _parserPool.len++;
+        p = NULL;
+    }
+    pthread_mutex_unlock(&_parserPool.lock);
+
+    if (p) {
+        if (p->jsn) jsonsl_destroy(p->jsn);
+        free(p->stage.items);
+        free(p->idx.pos);
+        free(p);
+    }
+}
+
+int CreateNodeFromJSON(const char *buf, size_t len, Node **node, char **err) {
+    return CreateNodeFromJSONEx(buf, len, NULL, node, err);
+}
+
+int CreateNodeFromJSONEx(const char *buf, size_t len, NodeArena *arena, Node **node, char **err) {
+    if (JSONOBJECT_OK == _JSONParseScalar(buf, len, arena, node)) return JSONOBJECT_OK;
+
+    _JSONParser *p = _JSONParser_Acquire();
+    int rc = JSONOBJECT_ERROR;
+
+    // jsonsl parses anything that the indexed parser rejects, and reports the error if it's invalid
+    if (JSONOBJECT_PARSER_INDEXED == jsonObjectParser) {
+        rc = _JSONIndexedParse(&p->idx, &p->stage, buf, len, arena, node);
+    }
+    if (JSONOBJECT_OK != rc) {
+        rc = _JSONSLParse(_JSONParser_Lexer(p), &p->joctx, buf, len, arena, node, err);
+    }
+
+    _JSONParser_Release(p);
+    return rc;
+}
+
 /* === JSON serializer === */
 
 typedef struct {
@@ -271,44 +988,143 @@ typedef struct {
     if (b->indent)               \
         for (int i = 0; i < b->depth; i++) b->buf = sdscatsds(b->buf, b->indentstr);
 
-inline static void _JSONSerialize_StringValue(Node *n, void *ctx) {
-    _JSONBuilderContext *b = (_JSONBuilderContext *)ctx;
-    size_t len = n->value.strval.len;
-    const char *p = n->value.strval.data;
+/* The length of a character once escaped by _JSONSerialize_String: printable ASCII is kept as is,
+ * except for the quotation mark, reverse solidus and solidus that are escaped with a reverse solidus
+ * like the common control characters are, and everything else is escaped as a unicode codepoint.
+ * Keys are written like the parser read them, so only the quotation mark, the reverse solidus and
+ * control characters are escaped in them and everything else, UTF-8 included, is kept as is.
+ */
+static inline size_t _JSONSerialize_EscapedLength(char c, int key) {
+    switch (c) {
+        case '"':
+        case '\\':
+        case '\b':
+        case '\f':
+        case '\n':
+        case '\r':
+        case '\t':
+            return 2;
+        case '/':
+            return key ? 1 : 2;
+        default:
+            if (key) return (unsigned char)c > 31 ? 1 : 6;
+            return (unsigned char)c > 31 && (unsigned char)c < 127 ? 1 : 6;
+    }
+}
+
+/* Returns the length of the prefix of `p` that has no characters that need escaping. */
+static inline size_t _JSONSerialize_CleanLength(const char *p, size_t len, int key) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i del = _mm256_set1_epi8(127);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i rsolidus = _mm256_set1_epi8('\\');
+    const __m256i solidus = _mm256_set1_epi8('/');
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        // signed comparison catches both control characters and non-ASCII bytes
+        __m256i m = _mm256_cmpgt_epi8(space, v);
+        if (key) {
+            // keys keep their non-ASCII bytes, which are the negative ones
+            m = _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), v), m);
+        } else {
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, del));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, solidus));
+        }
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, quote));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, rsolidus));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i space16 = _mm_set1_epi8(' ');
+    const __m128i del16 = _mm_set1_epi8(127);
+    const __m128i quote16 = _mm_set1_epi8('"');
+    const __m128i rsolidus16 = _mm_set1_epi8('\\');
+    const __m128i solidus16 = _mm_set1_epi8('/');
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        // signed comparison catches both control characters and non-ASCII bytes
+        __m128i m = _mm_cmplt_epi8(v, space16);
+        if (key) {
+            // keys keep their non-ASCII bytes, which are the negative ones
+            m = _mm_andnot_si128(_mm_cmplt_epi8(v, _mm_setzero_si128()), m);
+        } else {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, del16));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, solidus16));
+        }
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote16));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, rsolidus16));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+
+    // whatever is left, or everything on platforms without SIMD
+    while (i < len && 1 == _JSONSerialize_EscapedLength(p[i], key)) i++;
+    return i;
+}
+
+/* Writes the escape sequence of a character that needs escaping to `esc`, which must have room for
+ * 6 characters. Returns the sequence's length.
+ */
+static inline size_t _JSONSerialize_Escape(char *esc, char c) {
+    static const char hex[] = "0123456789abcdef";
+
+    esc[0] = '\\';
+    esc[1] = c;
+    switch (c) {
+        case '"':   // quotation mark
+        case '\\':  // reverse solidus
+        case '/':   // the standard is clear wrt solidus so we're zealous
+            break;
+        case '\b':  // backspace
+            esc[1] = 'b';
+            break;
+        case '\f':  // formfeed
+            esc[1] = 'f';
+            break;
+        case '\n':  // newline
+            esc[1] = 'n';
+            break;
+        case '\r':  // carriage return
+            esc[1] = 'r';
+            break;
+        case '\t':  // horizontal tab
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[(unsigned char)c >> 4];
+            esc[5] = hex[c & 0xf];
+            break;
+    }
+    return _JSONSerialize_EscapedLength(c, 0);
+}
+
+
+inline static void _JSONSerialize_String(_JSONBuilderContext *b, const char *p, size_t len,
+                                         int key) {
+    const char *end = p + len;
 
     b->buf = sdsMakeRoomFor(b->buf, len + 2);  // we'll need at least as much room as the original
     b->buf = sdscatlen(b->buf, "\"", 1);
-    while (len--) {
-        switch (*p) {
-            case '"':   // quotation mark
-            case '\\':  // reverse solidus
-                b->buf = sdscatprintf(b->buf, "\\%c", *p);
-                break;
-            case '/':  // the standard is clear wrt solidus so we're zealous
-                b->buf = sdscatlen(b->buf, "\\/", 2);
-                break;
-            case '\b':  // backspace
-                b->buf = sdscatlen(b->buf, "\\b", 2);
-                break;
-            case '\f':  // formfeed
-                b->buf = sdscatlen(b->buf, "\\f", 2);
-                break;
-            case '\n':  // newline
-                b->buf = sdscatlen(b->buf, "\\n", 2);
-                break;
-            case '\r':  // carriage return
-                b->buf = sdscatlen(b->buf, "\\r", 2);
-                break;
-            case '\t':  // horizontal tab
-                b->buf = sdscatlen(b->buf, "\\t", 2);
-                break;
-            default:
-                if ((unsigned char)*p > 31 && isprint(*p))
-                    b->buf = sdscatprintf(b->buf, "%c", *p);
-                else
-                    b->buf = sdscatprintf(b->buf, "\\u%04x", (unsigned char)*p);
-                break;
+    while (p < end) {
+        // copy runs of characters that don't need escaping in bulk
+        size_t clean = _JSONSerialize_CleanLength(p, end - p, key);
+        if (clean) {
+            b->buf = sdscatlen(b->buf, p, clean);
+            p += clean;
+            if (p == end) break;
         }
+
+        char esc[6];
+        b->buf = sdscatlen(b->buf, esc, _JSONSerialize_Escape(esc, *p));
         p++;
     }
 
@@ -329,23 +1145,22 @@ inline static void _JSONSerialize_BeginValue(Node *n, void *ctx) {
                     b->buf = sdscatlen(b->buf, "false", 5);
                 }
                 break;
-            case N_INTEGER:
-                b->buf = sdscatfmt(b->buf, "%I", n->value.intval);
+            case N_INTEGER: {
+                char num[JSONNUMBER_MAX_LENGTH];
+                b->buf = sdscatlen(b->buf, num, JSONNumber_FormatInt(num, n->value.intval));
                 break;
-            case N_NUMBER:
-                if (fabs(floor(n->value.numval) - n->value.numval) <= DBL_EPSILON &&
-                    fabs(n->value.numval) < 1.0e60)
-                    b->buf = sdscatprintf(b->buf, "%.0f", n->value.numval);
-                else if (fabs(n->value.numval) < 1.0e-6 || fabs(n->value.numval) > 1.0e9)
-                    b->buf = sdscatprintf(b->buf, "%e", n->value.numval);
-                else
-                    b->buf = sdscatprintf(b->buf, "%g", n->value.numval);
+            }
+            case N_NUMBER: {
+                char num[JSONNUMBER_MAX_LENGTH];
+                b->buf = sdscatlen(b->buf, num, JSONNumber_FormatDouble(num, n->value.numval));
                 break;
+            }
             case N_STRING:
-                _JSONSerialize_StringValue(n, b);
+                _JSONSerialize_String(b, NODE_STRING_DATA(n), NODE_STRING_LEN(n), 0);
                 break;
             case N_KEYVAL:
-                b->buf = sdscatfmt(b->buf, "\"%s\":%s", n->value.kvval.key, b->spacestr);
+                _JSONSerialize_String(b, n->value.kvval.key, strlen(n->value.kvval.key), 1);
+                b->buf = sdscatfmt(b->buf, ":%s", b->spacestr);
                 break;
             case N_DICT:
                 b->buf = sdscatlen(b->buf, "{", 1);
@@ -420,6 +1235,10 @@ void SerializeNodeToJSON(const Node *node, const JSONSerializeOpt *opt, sds *jso
                              .fDelim = _JSONSerialize_ContainerDelimiter,
                              .xDelim = (N_DICT | N_ARRAY)};
 
+    // the compact length of big containers is known, and formatting only adds to it
+    NodeStats stats;
+    if (OBJ_OK == Node_GetCachedStats(node, &stats)) *json = sdsMakeRoomFor(*json, stats.bytes);
+
     // the real work
     b->buf = *json;
     Node_Serializer(node, &nso, b);
@@ -432,6 +1251,184 @@ void SerializeNodeToJSON(const Node *node, const JSONSerializeOpt *opt, sds *jso
     free(b);
 }
 
+static size_t _JSONSerializedStringLength(const char *p, size_t plen, int key, size_t limit,
+                                          size_t len) {
+    size_t i = 0;
+    len += 2;
+    while (i < plen && len <= limit) {
+        size_t clean = _JSONSerialize_CleanLength(p + i, plen - i, key);
+        len += clean;
+        i += clean;
+        if (i < plen) len += _JSONSerialize_EscapedLength(p[i++], key);
+    }
+    return len;
+}
+
+/* The formatting strings, and their lengths, that a serialization is sized and written with. */
+typedef struct {
+    size_t limit;  // sizing stops once the length exceeds it
+    const char *indentstr;
+    const char *newlinestr;
+    const char *spacestr;
+    size_t indent;
+    size_t newline;
+    size_t space;
+} _JSONSizedContext;
+
+/* Adds the length of the node's serialization at `depth` to `len`, stopping once it exceeds the
+ * limit. */
+static size_t _JSONSerializedLength(const Node *n, const _JSONSizedContext *c, int depth,
+                                    size_t len) {
+    if (!n) return len + 4;  // null
+
+    switch (n->type) {
+        case N_BOOLEAN:
+            return len + (n->value.boolval ? 4 : 5);
+        case N_INTEGER: {
+            char num[JSONNUMBER_MAX_LENGTH];
+            return len + JSONNumber_FormatInt(num, n->value.intval);
+        }
+        case N_NUMBER: {
+            char num[JSONNUMBER_MAX_LENGTH];
+            return len + JSONNumber_FormatDouble(num, n->value.numval);
+        }
+        case N_STRING:
+            return _JSONSerializedStringLength(NODE_STRING_DATA(n), NODE_STRING_LEN(n), 0,
+                                               c->limit, len);
+        case N_KEYVAL:
+            len = _JSONSerializedStringLength(n->value.kvval.key, strlen(n->value.kvval.key), 1,
+                                              c->limit, len + 1 + c->space);
+            return _JSONSerializedLength(n->value.kvval.val, c, depth, len);
+        case N_DICT:
+        case N_ARRAY: {
+            uint32_t count = N_DICT == n->type ? n->value.dictval.len : n->value.arrval.len;
+            Node item;
+            len += 2 + (count ? count - 1 : 0);
+
+            // every item is on a line of its own that's indented one level deeper than the brackets
+            if (count) len += (count + 1) * c->newline + count * (depth + 1) * c->indent;
+            len += depth * c->indent;
+
+            for (uint32_t i = 0; i < count && len <= c->limit; i++) {
+                const Node *child = N_DICT == n->type ? n->value.dictval.entries[i]
+                                                      : Node_ArrayItemPeek(n, i, &item);
+                len = _JSONSerializedLength(child, c, depth + 1, len);
+            }
+            return len;
+        }
+        case N_NULL:  // keeps the compiler from complaining
+            break;
+    }
+    return len;
+}
+
+size_t JSONSerializedLength(const Node *node, size_t limit) {
+    _JSONSizedContext c = {.limit = limit};
+    NodeStats stats;
+
+    // big containers may know their length already
+    if (OBJ_OK == Node_GetCachedStats(node, &stats)) return stats.bytes;
+    return _JSONSerializedLength(node, &c, 0, 0);
+}
+
+static void _JSONSizedContext_Init(_JSONSizedContext *c, const JSONSerializeOpt *opt, size_t limit) {
+    c->limit = limit;
+    c->indentstr = opt->indentstr ? opt->indentstr : "";
+    c->newlinestr = opt->newlinestr ? opt->newlinestr : "";
+    c->spacestr = opt->spacestr ? opt->spacestr : "";
+    c->indent = strlen(c->indentstr);
+    c->newline = strlen(c->newlinestr);
+    c->space = strlen(c->spacestr);
+}
+
+size_t JSONSerializedLengthEx(const Node *node, const JSONSerializeOpt *opt, size_t limit) {
+    _JSONSizedContext c;
+    _JSONSizedContext_Init(&c, opt, limit);
+    return _JSONSerializedLength(node, &c, 0, 0);
+}
+
+/* Copies `len` bytes to `p`, returning the end of what was copied. */
+static inline char *_JSONWrite_Bytes(char *p, const char *s, size_t len) {
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static char *_JSONWrite_String(char *p, const char *s, size_t len, int key) {
+    const char *end = s + len;
+
+    *p++ = '"';
+    while (s < end) {
+        size_t clean = _JSONSerialize_CleanLength(s, end - s, key);
+        p = _JSONWrite_Bytes(p, s, clean);
+        s += clean;
+        if (s < end) p += _JSONSerialize_Escape(p, *s++);
+    }
+    *p++ = '"';
+    return p;
+}
+
+static inline char *_JSONWrite_Indent(const _JSONSizedContext *c, int depth, char *p) {
+    for (int i = 0; c->indent && i < depth; i++) p = _JSONWrite_Bytes(p, c->indentstr, c->indent);
+    return p;
+}
+
+/* Writes the node's serialization at `depth` to `p`, which has room for it, just like
+ * SerializeNodeToJSON does. Returns the end of what was written.
+ */
+static char *_JSONWrite(const Node *n, const _JSONSizedContext *c, int depth, char *p) {
+    if (!n) return _JSONWrite_Bytes(p, "null", 4);
+
+    switch (n->type) {
+        case N_BOOLEAN:
+            return n->value.boolval ? _JSONWrite_Bytes(p, "true", 4) : _JSONWrite_Bytes(p, "false", 5);
+        case N_INTEGER:
+            return p + JSONNumber_FormatInt(p, n->value.intval);
+        case N_NUMBER: {
+            char num[JSONNUMBER_MAX_LENGTH];
+            return _JSONWrite_Bytes(p, num, JSONNumber_FormatDouble(num, n->value.numval));
+        }
+        case N_STRING:
+            return _JSONWrite_String(p, NODE_STRING_DATA(n), NODE_STRING_LEN(n), 0);
+        case N_KEYVAL:
+            p = _JSONWrite_String(p, n->value.kvval.key, strlen(n->value.kvval.key), 1);
+            *p++ = ':';
+            p = _JSONWrite_Bytes(p, c->spacestr, c->space);
+            return _JSONWrite(n->value.kvval.val, c, depth, p);
+        case N_DICT:
+        case N_ARRAY: {
+            uint32_t count = N_DICT == n->type ? n->value.dictval.len : n->value.arrval.len;
+            Node item;
+
+            *p++ = N_DICT == n->type ? '{' : '[';
+            for (uint32_t i = 0; i < count; i++) {
+                const Node *child = N_DICT == n->type ? n->value.dictval.entries[i]
+                                                      : Node_ArrayItemPeek(n, i, &item);
+                if (i) *p++ = ',';
+                p = _JSONWrite_Bytes(p, c->newlinestr, c->newline);
+                p = _JSONWrite_Indent(c, depth + 1, p);
+                p = _JSONWrite(child, c, depth + 1, p);
+            }
+            if (count) p = _JSONWrite_Bytes(p, c->newlinestr, c->newline);
+            p = _JSONWrite_Indent(c, depth, p);
+            *p++ = N_DICT == n->type ? '}' : ']';
+            return p;
+        }
+        case N_NULL:  // keeps the compiler from complaining
+            break;
+    }
+    return p;
+}
+
+sds SerializeNodeToJSONSized(const Node *node, const JSONSerializeOpt *opt) {
+    _JSONSizedContext c;
+    _JSONSizedContext_Init(&c, opt, SIZE_MAX);
+
+    size_t len = _JSONSerializedLength(node, &c, 0, 0);
+    sds json = sdsnewlen(NULL, len);
+    _JSONWrite(node, &c, 0, json);
+    return json;
+}
+
 // clang-format off
 // from jsonsl.c
 
@@ -26,6 +26,7 @@
 #include <sds.h>
 #include <stdlib.h>
 #include "object.h"
+#include "json_number.h"
 
 #ifdef REDIS_MODULE_TARGET
 #include <alloc.h>
@@ -36,6 +37,21 @@
 
 #define JSONOBJECT_MAX_ERROR_STRING_LENGTH 256
 
+/* The engines that parse JSON text. */
+typedef enum {
+    JSONOBJECT_PARSER_JSONSL,   // jsonsl's streaming lexer
+    JSONOBJECT_PARSER_INDEXED,  // a structural index of the text, built with SIMD instructions
+} JSONObjectParser;
+
+/**
+* The engine that CreateNodeFromJSON parses with, JSONOBJECT_PARSER_JSONSL unless it's set
+* otherwise. The indexed parser classifies the text 64 bytes at a time to find the positions of its
+* strings, structural characters and other values, then builds the nodes from these positions
+* without looking at the bytes between them. Anything that it rejects is parsed again by jsonsl, so
+* both engines accept the same texts, create the same objects and report the same errors.
+*/
+extern JSONObjectParser jsonObjectParser;
+
 /**
 * Parses a JSON stored in `buf` of size `len` and creates an object.
 * The resulting object tree is stored in `node` and in case of error the optional `err` is set with
@@ -46,6 +62,13 @@
 */
 int CreateNodeFromJSON(const char *buf, size_t len, Node **node, char **err);
 
+/**
+* Like CreateNodeFromJSON, but the nodes are created in `arena` (which can be NULL for the heap).
+* With an arena, the JSON text is copied to it once and the strings reference that copy.
+* Upon error the arena may be left with garbage, it is up to the caller to free it.
+*/
+int CreateNodeFromJSONEx(const char *buf, size_t len, NodeArena *arena, Node **node, char **err);
+
 typedef struct {
     char *indentstr;   // indentation string
     char *newlinestr;  // linebreak string
@@ -57,4 +80,23 @@ typedef struct {
 */
 void SerializeNodeToJSON(const Node *node, const JSONSerializeOpt *opt, sds *json);
 
+/**
+* Like SerializeNodeToJSON, but returns a new serialization that's written to a buffer that is
+* allocated once, at the exact length that a sizing pass over the node finds.
+*/
+sds SerializeNodeToJSONSized(const Node *node, const JSONSerializeOpt *opt);
+
+/**
+* Returns the length of the node's JSON serialization without any indentation, newlines or spaces.
+* Counting stops once the length exceeds `limit`, so the returned value is only exact up to it. The
+* length of a container with cached statistics is known without counting (see Node_GetStats).
+*/
+size_t JSONSerializedLength(const Node *node, size_t limit);
+
+/**
+* Like JSONSerializedLength, but for a serialization that's formatted with the options in `opt`, so
+* that a buffer can be sized for it exactly before serializing.
+*/
+size_t JSONSerializedLengthEx(const Node *node, const JSONSerializeOpt *opt, size_t limit);
+
 #endif
\ No newline at end of file
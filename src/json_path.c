@@ -17,6 +17,273 @@
 
 #include "json_path.h"
 
+/* Scans a subscript's contents, which start after its opening bracket, for the closing bracket.
+ * Returns the contents' length, or -1 if the subscript isn't closed, and sets `type` to T_SLICE or
+ * T_UNION if the contents are a slice or a union, or to T_KEY otherwise. */
+static int _scanSubscript(const char *s, size_t len, tokenType *type) {
+    char quote = 0;
+    *type = T_KEY;
+    for (size_t i = 0; i < len; i++) {
+        if (quote) {
+            if (s[i] == quote) quote = 0;
+        } else if ('"' == s[i] || '\'' == s[i]) {
+            quote = s[i];
+        } else if (':' == s[i]) {
+            *type = T_SLICE;
+        } else if (',' == s[i] && T_SLICE != *type) {
+            *type = T_UNION;
+        } else if (']' == s[i]) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Parses an optionally negative integer that takes all of the string. Returns PARSE_OK if it's
+ * one. */
+static int _parseInt(const char *s, size_t len, int *num) {
+    int64_t n = 0;
+    size_t i = len && '-' == s[0];
+    if (i == len) return PARSE_ERR;
+    for (; i < len; i++) {
+        if (!isdigit((unsigned char)s[i])) return PARSE_ERR;
+        n = n * 10 + s[i] - '0';
+        if (n > INT_MAX) return PARSE_ERR;
+    }
+    *num = '-' == s[0] ? (int)-n : (int)n;
+    return PARSE_OK;
+}
+
+/* Parses a slice's contents, i.e. [start]:[end][:step], and appends it to the path. */
+static int _appendSlice(const char *s, size_t len, SearchPath *path) {
+    int bounds[3] = {0, 0, 1}, flags = 0, n = 0;
+    const char *end = s + len;
+    while (1) {
+        const char *colon = memchr(s, ':', end - s);
+        size_t partlen = (colon ? colon : end) - s;
+        if (n == 3) return PARSE_ERR;
+        if (partlen) {
+            if (PARSE_OK != _parseInt(s, partlen, &bounds[n])) return PARSE_ERR;
+            flags |= n == 0 ? PATH_SLICE_START : n == 1 ? PATH_SLICE_END : 0;
+        }
+        n++;
+        if (!colon) break;
+        s = colon + 1;
+    }
+    if (!bounds[2]) return PARSE_ERR;
+    SearchPath_AppendSlice(path, bounds[0], bounds[1], bounds[2], flags);
+    return PARSE_OK;
+}
+
+/* Parses a union's contents, i.e. a comma separated list of indices or quoted keys, and appends it
+ * to the path. */
+static int _appendUnion(const char *s, size_t len, SearchPath *path) {
+    PathNode *pn = SearchPath_AppendUnion(path);
+    const char *end = s + len;
+    while (s <= end) {
+        // a quoted key, which may contain commas
+        if ('"' == *s || '\'' == *s) {
+            const char *close = memchr(s + 1, *s, end - s - 1);
+            if (!close || (close + 1 < end && ',' != close[1])) return PARSE_ERR;
+            PathNode_UnionAppendKey(pn, s + 1, close - s - 1);
+            s = close + 2;
+            continue;
+        }
+
+        const char *comma = memchr(s, ',', end - s);
+        size_t partlen = (comma ? comma : end) - s;
+        int index;
+        if (PARSE_OK != _parseInt(s, partlen, &index)) return PARSE_ERR;
+        PathNode_UnionAppendIndex(pn, index);
+        s += partlen + 1;
+    }
+    return PARSE_OK;
+}
+
+/* A filter expression's compiler, which is a recursive descent parser of:
+ *   or         := and ('||' and)*
+ *   and        := comparison ('&&' comparison)*
+ *   comparison := unary [('==' | '!=' | '<' | '<=' | '>' | '>=') unary]
+ *   unary      := '!' unary | '(' or ')' | '@' [relative path] | literal
+ * where literals are numbers, quoted strings, true, false and null. */
+typedef struct {
+    const char *s;
+    const char *end;
+    PathFilter *f;
+    int nesting;  // of parentheses and negations
+} _FilterCompiler;
+
+static int _compileOr(_FilterCompiler *fc);
+
+static inline void _skipSpaces(_FilterCompiler *fc) {
+    while (fc->s < fc->end && isspace((unsigned char)*fc->s)) fc->s++;
+}
+
+/* Skips spaces, and consumes the token if it's next. Returns 1 if it was. */
+static int _accept(_FilterCompiler *fc, const char *tok) {
+    size_t len = strlen(tok);
+    _skipSpaces(fc);
+    if ((size_t)(fc->end - fc->s) < len || strncmp(fc->s, tok, len)) return 0;
+    fc->s += len;
+    return 1;
+}
+
+/* Like _accept, for a word that mustn't be followed by an identifier's characters. */
+static int _acceptWord(_FilterCompiler *fc, const char *word) {
+    const char *s = fc->s;
+    if (!_accept(fc, word)) return 0;
+    if (fc->s < fc->end && (isalnum((unsigned char)*fc->s) || '$' == *fc->s || '_' == *fc->s)) {
+        fc->s = s;
+        return 0;
+    }
+    return 1;
+}
+
+/* Compiles the path that follows `@`, which may only have keys and indices. */
+static int _compileRelativePath(_FilterCompiler *fc) {
+    const char *s = fc->s;
+    if (s < fc->end && ('.' == *s || '[' == *s)) {
+        while (s < fc->end) {
+            if ('[' == *s) {
+                tokenType type;
+                int sublen = _scanSubscript(s + 1, fc->end - s - 1, &type);
+                if (sublen < 0 || '?' == s[1]) return PARSE_ERR;
+                s += sublen + 2;
+            } else if ('.' == *s || isalnum((unsigned char)*s) || '$' == *s || '_' == *s) {
+                s++;
+            } else {
+                break;
+            }
+        }
+    }
+
+    SearchPath p = NewSearchPath(0);
+    if (s == fc->s) {  // the filtered value itself
+        SearchPath_AppendRoot(&p);
+    } else if (PARSE_OK != _tokenizePath(fc->s, s - fc->s, &p) || SearchPath_IsMulti(&p)) {
+        SearchPath_Free(&p);
+        return PARSE_ERR;
+    }
+    fc->s = s;
+    PathFilter_Emit(fc->f, FOP_PATH, PathFilter_AddPath(fc->f, p));
+    return PARSE_OK;
+}
+
+/* Parses a number literal, which is an integer unless it has a fraction or an exponent. */
+static int _parseNumber(_FilterCompiler *fc, Node **n) {
+    char buf[64], *end;
+    size_t len = 0;
+    int isdouble = 0;
+    while (fc->s + len < fc->end && len < sizeof(buf) - 1 &&
+           (isdigit((unsigned char)fc->s[len]) || memchr("-+.eE", fc->s[len], 5))) {
+        isdouble |= '.' == fc->s[len] || 'e' == fc->s[len] || 'E' == fc->s[len];
+        len++;
+    }
+    memcpy(buf, fc->s, len);
+    buf[len] = '\0';
+
+    errno = 0;
+    long long ll = strtoll(buf, &end, 10);
+    if (isdouble || ERANGE == errno) {
+        double d = strtod(buf, &end);
+        *n = NewDoubleNode(d);
+    } else {
+        *n = NewIntNode(ll);
+    }
+    if (!len || end != buf + len) {
+        Node_Free(*n);
+        return PARSE_ERR;
+    }
+    fc->s += len;
+    return PARSE_OK;
+}
+
+static int _compileUnary(_FilterCompiler *fc) {
+    Node *literal = NULL;
+    int b;
+    if (++fc->nesting > PATH_FILTER_MAX_DEPTH) return PARSE_ERR;
+
+    _skipSpaces(fc);
+    if (fc->end - fc->s > 1 && '!' == fc->s[0] && '=' != fc->s[1]) {
+        fc->s++;
+        if (PARSE_OK != _compileUnary(fc)) return PARSE_ERR;
+        PathFilter_Emit(fc->f, FOP_NOT, 0);
+    } else if (_accept(fc, "(")) {
+        if (PARSE_OK != _compileOr(fc) || !_accept(fc, ")")) return PARSE_ERR;
+    } else if (_accept(fc, "@")) {
+        if (PARSE_OK != _compileRelativePath(fc)) return PARSE_ERR;
+    } else if (fc->s < fc->end && ('"' == *fc->s || '\'' == *fc->s)) {
+        const char *close = memchr(fc->s + 1, *fc->s, fc->end - fc->s - 1);
+        if (!close) return PARSE_ERR;
+        literal = NewStringNode(fc->s + 1, close - fc->s - 1);
+        fc->s = close + 1;
+        PathFilter_Emit(fc->f, FOP_CONST, PathFilter_AddConst(fc->f, literal));
+    } else if (fc->s < fc->end && ('-' == *fc->s || isdigit((unsigned char)*fc->s))) {
+        if (PARSE_OK != _parseNumber(fc, &literal)) return PARSE_ERR;
+        PathFilter_Emit(fc->f, FOP_CONST, PathFilter_AddConst(fc->f, literal));
+    } else if ((b = _acceptWord(fc, "true")) || _acceptWord(fc, "false")) {
+        PathFilter_Emit(fc->f, FOP_CONST, PathFilter_AddConst(fc->f, NewBoolNode(b)));
+    } else if (_acceptWord(fc, "null")) {
+        PathFilter_Emit(fc->f, FOP_CONST, PathFilter_AddConst(fc->f, NULL));
+    } else {
+        return PARSE_ERR;
+    }
+
+    fc->nesting--;
+    return PARSE_OK;
+}
+
+static int _compileComparison(_FilterCompiler *fc) {
+    static const struct {
+        const char *tok;
+        PathFilterOp op;
+    } ops[] = {{"==", FOP_EQ}, {"!=", FOP_NE}, {"<=", FOP_LE},
+               {">=", FOP_GE}, {"<", FOP_LT},  {">", FOP_GT}};
+
+    if (PARSE_OK != _compileUnary(fc)) return PARSE_ERR;
+    for (int i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (!_accept(fc, ops[i].tok)) continue;
+        if (PARSE_OK != _compileUnary(fc)) return PARSE_ERR;
+        PathFilter_Emit(fc->f, ops[i].op, 0);
+        break;
+    }
+    return PARSE_OK;
+}
+
+/* Compiles the operands of a boolean operator, each of which but the last is followed by a jump to
+ * the end that's taken when it decides the result. */
+static int _compileBoolean(_FilterCompiler *fc, const char *tok, PathFilterOp op,
+                           int (*operand)(_FilterCompiler *)) {
+    if (PARSE_OK != operand(fc)) return PARSE_ERR;
+    while (_accept(fc, tok)) {
+        int jump = PathFilter_Emit(fc->f, op, 0);
+        if (PARSE_OK != operand(fc)) return PARSE_ERR;
+        fc->f->code[jump].arg = fc->f->len;
+    }
+    return PARSE_OK;
+}
+
+static int _compileAnd(_FilterCompiler *fc) {
+    return _compileBoolean(fc, "&&", FOP_AND, _compileComparison);
+}
+
+static int _compileOr(_FilterCompiler *fc) {
+    return _compileBoolean(fc, "||", FOP_OR, _compileAnd);
+}
+
+/* Compiles a filter subscript, which starts after its opening bracket with `?(`, and appends it to
+ * the path. Returns the subscript's length including its closing bracket, or -1 if it's invalid. */
+static int _appendFilter(const char *s, size_t len, SearchPath *path) {
+    _FilterCompiler fc = {.s = s, .end = s + len, .f = NewPathFilter()};
+    if (!_accept(&fc, "?(") || PARSE_OK != _compileOr(&fc) || !_accept(&fc, ")") ||
+        !_accept(&fc, "]") || fc.f->depth > PATH_FILTER_MAX_DEPTH) {
+        PathFilter_Free(fc.f);
+        return -1;
+    }
+    SearchPath_AppendFilter(path, fc.f);
+    return (int)(fc.s - s);
+}
+
 int _tokenizePath(const char *json, size_t len, SearchPath *path) {
     tokenizerState st = S_NULL;
     size_t offset = 0;
@@ -40,6 +307,10 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path) {
                         tok.s++;
                         st = S_BRACKET;
                         break;
+                    // a wildcard
+                    case '*':
+                        st = S_STAR;
+                        break;
                     default:
                         // only letters, dollar signs and underscores are allowed at the beginning
                         if (isalpha(c) || '$' == c || '_' == c) {
@@ -53,7 +324,28 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path) {
             } break;
 
             // we're after a square bracket opening
-            case S_BRACKET:  // [
+            case S_BRACKET: {  // [
+                // filters are compiled as a whole
+                if ('?' == c) {
+                    int filterlen = _appendFilter(pos, len - offset, path);
+                    if (filterlen < 0) goto syntaxerror;
+                    tok.type = T_FILTER;
+                    st = S_NULL;
+                    pos += filterlen;
+                    offset += filterlen;
+                    goto tokenend;
+                }
+
+                // slices and unions are parsed as a whole
+                int sublen = _scanSubscript(pos, len - offset, &tok.type);
+                if (sublen < 0) goto syntaxerror;
+                if (T_SLICE == tok.type || T_UNION == tok.type) {
+                    tok.len = sublen;
+                    st = S_NULL;
+                    pos += sublen + 1;
+                    offset += sublen + 1;
+                    goto tokenend;
+                }
                 // quotes after brackets means dict key
                 if (c == '"') {
                     // skip to the beginnning of the key
@@ -71,22 +363,71 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path) {
                     // this could be the beginning of a negative index
                     tok.len++;
                     st = S_MINUS;
+                } else if ('*' == c) {
+                    st = S_BSTAR;
                 } else {
                     goto syntaxerror;
                 }
-                break;
+            } break;
 
             // we're after a dot
             case S_DOT:
+                // another dot means a deep scan
+                if ('.' == c) {
+                    st = S_DSCAN;
+                    tok.type = T_DEEPSCAN;
+                    pos++;
+                    offset++;
+                    goto tokenend;
+                }
                 // start of ident token, can only be a letter, dollar sign or underscore
                 if (isalpha(c) || '$' == c || '_' == c) {
                     tok.len++;
                     st = S_IDENT;
+                } else if ('*' == c) {
+                    st = S_STAR;
+                } else {
+                    goto syntaxerror;
+                }
+                break;
+
+            // we're after a deep scan
+            case S_DSCAN:
+                if (isalpha(c) || '$' == c || '_' == c) {
+                    tok.len++;
+                    st = S_IDENT;
+                } else if ('*' == c) {
+                    st = S_STAR;
+                } else if ('[' == c) {
+                    tok.s++;
+                    st = S_BRACKET;
                 } else {
                     goto syntaxerror;
                 }
                 break;
 
+            // we're after a wildcard, which ends like an ident
+            case S_STAR:
+                if (c == '.' || c == '[') {
+                    st = c == '.' ? S_DOT : S_BRACKET;
+                    tok.type = T_WILDCARD;
+                    pos++;
+                    offset++;
+                    goto tokenend;
+                }
+                goto syntaxerror;
+
+            // we're after a wildcard in brackets
+            case S_BSTAR:
+                if (c == ']') {
+                    st = S_NULL;
+                    tok.type = T_WILDCARD;
+                    pos++;
+                    offset++;
+                    goto tokenend;
+                }
+                goto syntaxerror;
+
             // we're within a number (array index)
             case S_NUMBER:
                 if (isdigit(c)) {
@@ -104,6 +445,19 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path) {
 
             // we're within an ident string
             case S_IDENT:
+                // a dot right after the root's means a deep scan
+                if (c == '.' && !tok.len) {
+                    st = S_DSCAN;
+                    tok.type = T_DEEPSCAN;
+                    pos++;
+                    offset++;
+                    goto tokenend;
+                }
+                // a wildcard right after the root
+                if (c == '*' && !tok.len) {
+                    st = S_STAR;
+                    break;
+                }
                 // end of ident
                 if (c == '.' || c == '[') {
                     st = c == '.' ? S_DOT : S_BRACKET;
@@ -166,9 +520,9 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path) {
         pos++;
         
         // ident string must end if len reached
-        if (S_IDENT == st && len == offset) {
+        if ((S_IDENT == st || S_STAR == st) && len == offset) {
+            tok.type = S_STAR == st ? T_WILDCARD : T_KEY;
             st = S_NULL;
-            tok.type = T_KEY;
             goto tokenend;
         }
         continue;
@@ -184,6 +538,14 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path) {
             }
             if ('-' == tok.s[0]) num = -num;
             SearchPath_AppendIndex(path, num);
+        } else if (T_WILDCARD == tok.type) {
+            SearchPath_AppendWildcard(path);
+        } else if (T_DEEPSCAN == tok.type) {
+            SearchPath_AppendDeepScan(path);
+        } else if (T_SLICE == tok.type) {
+            if (PARSE_OK != _appendSlice(tok.s, tok.len, path)) goto syntaxerror;
+        } else if (T_UNION == tok.type) {
+            if (PARSE_OK != _appendUnion(tok.s, tok.len, path)) goto syntaxerror;
         } else if (T_KEY == tok.type) {
             if (1 == offset == len && '.' == c) {  // check for root
                 SearchPath_AppendRoot(path);
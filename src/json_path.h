@@ -19,7 +19,10 @@
 #define __JSON_PATH_H__
 
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "path.h"
 
@@ -34,6 +37,11 @@
 typedef enum {
     T_KEY,
     T_INDEX,
+    T_WILDCARD,
+    T_DEEPSCAN,
+    T_SLICE,
+    T_UNION,
+    T_FILTER,  // which is appended to the path as it's compiled
 } tokenType;
 
 // tokenizer state
@@ -46,6 +54,9 @@ typedef enum {
     S_BRACKET,      // subscript (could be a key or an index)
     S_DOT,          // child separator
     S_MINUS,        // a negative index
+    S_DSCAN,        // after a deep scan, followed by an identifier, a wildcard or a subscript
+    S_STAR,         // a wildcard
+    S_BSTAR,        // a wildcard subscript
 } tokenizerState;
 
 // the token we're now on
@@ -63,6 +74,11 @@ int _tokenizePath(const char *json, size_t len, SearchPath *path);
 *   foo.bar.baz[3]
 *   foo["bar"]["baz"][3]
 *   foo[3]
+*   foo.*.baz or foo[*].baz
+*   foo..baz
+*   foo[1:10:2] or foo[:-1]
+*   foo[1,3,5] or foo['bar','baz']
+*   foo[?(@.price < 10 && @.tags[0] == "new")]
 *
 *   Note: string keys right now need to be ascii, we do not support unicode keys
 */
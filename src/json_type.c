@@ -15,7 +15,133 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <pthread.h>
 #include "json_type.h"
+#include "rejson_config.h"
+
+// versions are taken from a global counter so that a version identifies a document's state
+static uint64_t JSONTypeLastVersion = 0;
+
+JSONType_t *NewJSONType(Node *root, NodeArena *arena) {
+    JSONType_t *jt = calloc(1, sizeof(JSONType_t));
+    jt->root = root;
+    jt->arena = arena;
+    JSONType_Touch(jt);
+    return jt;
+}
+
+void JSONType_Touch(JSONType_t *jt) { jt->version = ++JSONTypeLastVersion; }
+
+/* === Loading threads === */
+
+// the states of a document's `loading`, which is only changed under the loader's lock
+#define JSONTYPE_LOADED 0
+#define JSONTYPE_LOADING 1
+
+// smaller documents are unpacked by the main thread, as that's about as fast as queueing them
+#define JSONTYPE_LOAD_THREAD_MIN_SIZE 1024
+
+/* A packed document that's waiting to be unpacked. */
+typedef struct t_loadJob {
+    struct t_loadJob *next;
+    JSONType_t *jt;
+    char *buf;
+    size_t len;
+} _LoadJob;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;  // signaled when jobs are queued
+    pthread_cond_t done;  // broadcast when jobs are done
+    _LoadJob *head;       // the next job
+    _LoadJob *tail;       // the last job
+    size_t pending;       // number of queued and running jobs
+    int threads;          // number of started threads, only accessed by the main thread
+} _loader = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static void *_LoaderThread(void *arg) {
+    pthread_mutex_lock(&_loader.lock);
+    while (1) {
+        while (!_loader.head) pthread_cond_wait(&_loader.work, &_loader.lock);
+        _LoadJob *job = _loader.head;
+        _loader.head = job->next;
+        if (!_loader.head) _loader.tail = NULL;
+        pthread_mutex_unlock(&_loader.lock);
+
+        // the buffer was checked before it was queued, so it unpacks
+        Node *root = NULL;
+        Node_Unpack(job->buf, job->len, job->jt->arena, &root);
+        free(job->buf);
+
+        pthread_mutex_lock(&_loader.lock);
+        job->jt->root = root;
+        job->jt->loading = JSONTYPE_LOADED;
+        _loader.pending--;
+        pthread_cond_broadcast(&_loader.done);
+        free(job);
+    }
+    return arg;
+}
+
+/* Waits for all the jobs to be done before forking, so the child doesn't wait for threads that it
+* doesn't have, and holds the lock across the fork so the child doesn't inherit it locked by one. */
+static void _LoaderDrain() {
+    pthread_mutex_lock(&_loader.lock);
+    while (_loader.pending) pthread_cond_wait(&_loader.done, &_loader.lock);
+}
+
+/* Releases the lock that was taken before forking, in both the parent and the child. */
+static void _LoaderRelease() { pthread_mutex_unlock(&_loader.lock); }
+
+/* Starts the loading threads, returns the number that were started. */
+static int _LoaderStart() {
+    if (!_loader.threads) {
+        pthread_atfork(_LoaderDrain, _LoaderRelease, _LoaderRelease);
+    }
+    while (_loader.threads < (int)rejsonConfig.loadThreads) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, _LoaderThread, NULL)) break;
+        pthread_detach(thread);
+        _loader.threads++;
+    }
+    return _loader.threads;
+}
+
+/* Queues the packed document to be unpacked into jt by a loading thread, which frees the buffer. */
+static void _LoaderQueue(JSONType_t *jt, char *buf, size_t len) {
+    _LoadJob *job = malloc(sizeof(_LoadJob));
+    job->next = NULL;
+    job->jt = jt;
+    job->buf = buf;
+    job->len = len;
+    jt->loading = JSONTYPE_LOADING;
+
+    pthread_mutex_lock(&_loader.lock);
+    if (_loader.tail) {
+        _loader.tail->next = job;
+    } else {
+        _loader.head = job;
+    }
+    _loader.tail = job;
+    _loader.pending++;
+    pthread_cond_signal(&_loader.work);
+    pthread_mutex_unlock(&_loader.lock);
+}
+
+void JSONType_Wait(JSONType_t *jt) {
+    // documents can only be loading once the threads are started
+    if (!_loader.threads) return;
+
+    pthread_mutex_lock(&_loader.lock);
+    while (JSONTYPE_LOADING == jt->loading) pthread_cond_wait(&_loader.done, &_loader.lock);
+    pthread_mutex_unlock(&_loader.lock);
+}
+
+JSONType_t *JSONType_GetValue(RedisModuleKey *key) {
+    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_Wait(jt);
+    return jt;
+}
 
 void *JSONTypeRdbLoad(RedisModuleIO *rdb, int encver) {
     if (encver < 0 || encver > JSONTYPE_ENCODING_VERSION) {
@@ -26,44 +152,236 @@ void *JSONTypeRdbLoad(RedisModuleIO *rdb, int encver) {
         return NULL;
     }
 
-    JSONType_t *jt = calloc(1, sizeof(JSONType_t));
-    jt->root = ObjectTypeRdbLoad(rdb);
+    JSONType_t *jt = NewJSONType(NULL, NewNodeArena());
+    if (JSONTYPE_ENCODING_VERSION_NODES == encver) {
+        jt->root = ObjectTypeRdbLoad(rdb, jt->arena);
+    } else {
+        size_t len;
+        char *buf = RedisModule_LoadStringBuffer(rdb, &len);
+
+        // big documents are unpacked by the loading threads while the rest of the RDB is read, once
+        // they're checked, so a malformed one fails the load just like it does when it's unpacked
+        int threaded = len >= JSONTYPE_LOAD_THREAD_MIN_SIZE && _LoaderStart();
+        int rc = threaded ? Node_UnpackCheck(buf, len) : Node_Unpack(buf, len, jt->arena, &jt->root);
+        if (threaded && OBJ_OK == rc) {
+            _LoaderQueue(jt, buf, len);
+            return jt;
+        }
+
+        free(buf);
+        if (OBJ_OK != rc) {
+            RedisModule_LogIOError(rdb, RM_LOGLEVEL_WARNING,
+                                   "Can't load JSON from RDB due to a malformed packed value");
+            JSONTypeFree(jt);
+            return NULL;
+        }
+    }
     return jt;
 }
 
 void JSONTypeRdbSave(RedisModuleIO *rdb, void *value) {
     JSONType_t *jt = (JSONType_t *)value;
-    ObjectTypeRdbSave(rdb, jt->root);    
+    char *buf;
+    size_t len;
+    JSONType_Wait(jt);
+
+    // the entire document is saved in one call to keep the per-call overhead of the RDB API low
+    Node_Pack(jt->root, &buf, &len);
+    RedisModule_SaveStringBuffer(rdb, buf, len);
+    free(buf);
 }
 
-void JSONTypeAofRewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
-    // two approaches:
-    // 1. For small documents it makes more sense to serialze the entire document in one go
-    // 2. Large documents need to be broken to smaller pieces in order to stay within 0.5GB, but
-    // we'll need some meta data to make sane-sized chunks so this gets lower priority atm
-    JSONType_t *jt = (JSONType_t *)value;
+/* Context for rewriting a single document to the AOF. */
+typedef struct {
+    RedisModuleIO *aof;
+    RedisModuleCtx *ctx;
+    RedisModuleString *key;
+    size_t budget;  // the maximal length of a serialized value in a command
+} _AofRewriteContext;
 
-    // serialize it
+/* Serializes a node in compact form and appends it to `json`. */
+static inline sds _AofSerialize(sds json, const Node *n) {
     JSONSerializeOpt jsopt = {.indentstr = "", .newlinestr = "", .spacestr = ""};
-    sds json = sdsnewlen("\"", 1);
-    SerializeNodeToJSON(jt->root, &jsopt, &json);
-    json = sdscatlen(json, "\"", 1);
-    RedisModule_EmitAOF(aof, "JSON.SET", "scb", key, OBJECT_ROOT_PATH, json, sdslen(json));
+    SerializeNodeToJSON(n, &jsopt, &json);
+    return json;
+}
+
+/* Returns the path to the child of `path` that's accessed with key, or NULL if there's no syntax
+ * for it. An empty `path` is the root.
+ */
+static sds _AofChildKeyPath(const sds path, const char *key) {
+    int ident = isalpha((unsigned char)*key) || '$' == *key || '_' == *key;
+    for (const char *p = key; ident && *p; p++) {
+        ident = isalnum((unsigned char)*p) || '$' == *p || '_' == *p;
+    }
+
+    // a bracketed key is quoted with a character that it doesn't contain, since there's no escaping
+    if (ident) return sdscatfmt(sdsdup(path), ".%s", key);
+    if (!strchr(key, '"')) return sdscatfmt(sdsdup(path), "[\"%s\"]", key);
+    if (!strchr(key, '\'')) return sdscatfmt(sdsdup(path), "['%s']", key);
+    return NULL;
+}
+
+static void _AofEmitSet(_AofRewriteContext *arc, const sds path, const sds json) {
+    RedisModule_EmitAOF(arc->aof, "JSON.SET", "scb", arc->key,
+                        sdslen(path) ? path : OBJECT_ROOT_PATH, json, sdslen(json));
+}
+
+/* Appends the values to the array at path with a single command. */
+static void _AofEmitArrAppend(_AofRewriteContext *arc, const sds path, Vector *values) {
+    int argc = Vector_Size(values) + 2;
+    RedisModuleString **argv = calloc(argc, sizeof(RedisModuleString *));
+
+    // the key may be allocated on the stack so it can't be retained by the vector
+    size_t keylen;
+    const char *key = RedisModule_StringPtrLen(arc->key, &keylen);
+    argv[0] = RedisModule_CreateString(arc->ctx, key, keylen);
+    argv[1] = RedisModule_CreateString(arc->ctx, sdslen(path) ? path : OBJECT_ROOT_PATH,
+                                       sdslen(path) ? sdslen(path) : strlen(OBJECT_ROOT_PATH));
+    for (int i = 2; i < argc; i++) {
+        sds json;
+        Vector_Get(values, i - 2, &json);
+        argv[i] = RedisModule_CreateString(arc->ctx, json, sdslen(json));
+        sdsfree(json);
+    }
+    RedisModule_EmitAOF(arc->aof, "JSON.ARRAPPEND", "v", argv, (size_t)argc);
+
+    for (int i = 0; i < argc; i++) RedisModule_FreeString(arc->ctx, argv[i]);
+    free(argv);
+    values->top = 0;  // empties the vector
+}
+
+/* Rewrites a node at `path` with commands that have values no longer than the budget, except for
+ * scalars and containers that can't be broken up because some of their keys can't be addressed.
+ */
+static void _AofRewriteNode(_AofRewriteContext *arc, const sds path, const Node *n) {
+    size_t budget = arc->budget;
+    int isDict = n && N_DICT == n->type;
+
+    if (!n || !(n->type & (N_DICT | N_ARRAY)) || JSONSerializedLength(n, budget) <= budget) {
+        sds json = _AofSerialize(sdsempty(), n);
+        _AofEmitSet(arc, path, json);
+        sdsfree(json);
+        return;
+    }
+
+    uint32_t count = isDict ? n->value.dictval.len : n->value.arrval.len;
+    Node **entries = isDict ? n->value.dictval.entries : n->value.arrval.entries;
+
+    // a dictionary's keys must all be addressable for it to be broken up, whereas an array item's
+    // path is only made for the item that's too big to be appended
+    sds *paths = isDict ? calloc(count, sizeof(sds)) : NULL;
+    for (uint32_t i = 0; isDict && i < count; i++) {
+        paths[i] = _AofChildKeyPath(path, entries[i]->value.kvval.key);
+        if (!paths[i]) {
+            sds json = _AofSerialize(sdsempty(), n);
+            _AofEmitSet(arc, path, json);
+            sdsfree(json);
+            goto cleanup;
+        }
+    }
+
+    // the container is set with as many of its leading entries as the budget allows
+    uint32_t i = 0;
+    size_t len = 2;
+    Node item;
+    sds json = sdsnewlen(isDict ? "{" : "[", 1);
+    for (; i < count; i++) {
+        const Node *entry = isDict ? entries[i] : Node_ArrayItemPeek(n, i, &item);
+        size_t elen = JSONSerializedLength(entry, budget) + (i ? 1 : 0);
+        if (len + elen > budget) break;
+        if (i) json = sdscatlen(json, ",", 1);
+        json = _AofSerialize(json, entry);
+        len += elen;
+    }
+    json = sdscatlen(json, isDict ? "}" : "]", 1);
+    _AofEmitSet(arc, path, json);
     sdsfree(json);
+
+    // the rest are set one by one, except for array items that are appended in batches
+    Vector *batch = NewVector(sds, 16);
+    len = 0;
+    for (; i < count; i++) {
+        const Node *val = isDict ? entries[i]->value.kvval.val : Node_ArrayItemPeek(n, i, &item);
+        size_t elen = JSONSerializedLength(val, budget);
+        if (isDict) {
+            _AofRewriteNode(arc, paths[i], val);
+        } else if (elen <= budget) {
+            if (len + elen > budget) {
+                _AofEmitArrAppend(arc, path, batch);
+                len = 0;
+            }
+            sds item = _AofSerialize(sdsempty(), val);
+            Vector_Push(batch, item);
+            len += elen;
+        } else {
+            // a big item is appended as a placeholder and then rewritten in place
+            sds placeholder = sdsnew("null");
+            Vector_Push(batch, placeholder);
+            _AofEmitArrAppend(arc, path, batch);
+            len = 0;
+            sds ipath = sdscatfmt(sdsdup(path), "[%u]", i);
+            _AofRewriteNode(arc, ipath, val);
+            sdsfree(ipath);
+        }
+    }
+    if (Vector_Size(batch)) _AofEmitArrAppend(arc, path, batch);
+    Vector_Free(batch);
+
+cleanup:
+    for (uint32_t j = 0; isDict && j < count; j++) sdsfree(paths[j]);
+    free(paths);
+}
+
+void JSONTypeAofRewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
+    /* Small documents are serialized entirely in one go, whereas large documents are broken to
+     * smaller pieces so that the serialization buffer's size stays bounded by the configured chunk
+     * size, and the commands stay well within the 512MB bulk string limit.
+     */
+    JSONType_t *jt = (JSONType_t *)value;
+    JSONType_Wait(jt);
+    _AofRewriteContext arc = {.aof = aof,
+                              .ctx = RedisModule_GetContextFromIO(aof),
+                              .key = key,
+                              .budget = rejsonConfig.aofChunkSize};
+    sds path = sdsempty();
+    _AofRewriteNode(&arc, path, jt->root);
+    sdsfree(path);
 }
 
 void JSONTypeFree(void *value) {
     JSONType_t *jt = (JSONType_t *)value;
     if (jt) {
-        Node_Free(jt->root);
+        JSONType_Wait(jt);
+
+        // big documents are freed on a background thread, so deleting them doesn't block the server
+        size_t threshold = rejsonConfig.lazyFreeThreshold;
+        if (threshold && LazyFree_Effort(jt->root, threshold) > threshold) {
+            LazyFree_Node(jt->root, jt->arena);
+        } else {
+            Node_Free(jt->root);
+            if (jt->arena) NodeArena_Free(jt->arena);
+        }
         free(jt);
     }
 }
 
 size_t JSONTypeMemoryUsage(const void *value) {
-    const JSONType_t *jt = (JSONType_t *)value;
+    JSONType_t *jt = (JSONType_t *)value;
     size_t memory = sizeof(JSONType_t);
+    NodeStats stats;
+    JSONType_Wait(jt);
+
+    // the statistics of big containers are cached, so big documents don't have to be walked
+    Node_GetStats(jt->root, &stats);
+
+    // nodes in the arena are accounted for by the arena's size
+    if (jt->arena) {
+        memory += sizeof(NodeArena) + jt->arena->size + stats.heap;
+    } else {
+        memory += stats.memory;
+    }
 
-    memory += ObjectTypeMemoryUsage(jt->root);
-    return memory;
+    // interned keys are shared with other documents, so only their share is charged
+    return memory + Key_SharedSizeOf(stats.keys);
 }
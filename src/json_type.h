@@ -20,10 +20,15 @@
 
 #include "object.h"
 #include "object_type.h"
+#include "object_pack.h"
+#include "lazy_free.h"
 #include "json_object.h"
 #include "redismodule.h"
 
-#define JSONTYPE_ENCODING_VERSION 0
+/* Encoding versions: 0 saves a node per RDB call, 1 saves the document as one packed buffer */
+#define JSONTYPE_ENCODING_VERSION_NODES 0
+#define JSONTYPE_ENCODING_VERSION_PACKED 1
+#define JSONTYPE_ENCODING_VERSION JSONTYPE_ENCODING_VERSION_PACKED
 #define JSONTYPE_NAME "ReJSON-RL"
 
 #define RM_LOGLEVEL_WARNING "warning"
@@ -33,8 +38,26 @@
 /* A wrapper for a JSON value. */
 typedef struct {
     Node *root;
+    NodeArena *arena;  // where the document's initial nodes were allocated, may be NULL
+    uint64_t version;  // changes on every write, and is never shared by two documents
+    int loading;       // whether the root is being unpacked by a loading thread
 } JSONType_t;
 
+/* Creates a new document with the root and its optional arena. */
+JSONType_t *NewJSONType(Node *root, NodeArena *arena);
+
+/* Gives the document a new version, must be called by every command that modifies it. */
+void JSONType_Touch(JSONType_t *jt);
+
+/**
+* Waits until the document's root is unpacked. Documents in RDB files are unpacked by a pool of
+* loading threads, so this must be called before a document that may have been loaded is accessed.
+*/
+void JSONType_Wait(JSONType_t *jt);
+
+/* Returns the document that's the value of a key, waiting until it is unpacked. */
+JSONType_t *JSONType_GetValue(RedisModuleKey *key);
+
 void *JSONTypeRdbLoad(RedisModuleIO *rdb, int encver);
 void JSONTypeRdbSave(RedisModuleIO *rdb, void *value);
 void JSONTypeAofRewrite(RedisModuleIO *aof, RedisModuleString *key, void *value);
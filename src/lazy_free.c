@@ -0,0 +1,126 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include "lazy_free.h"
+
+typedef struct t_lazyFreeJob {
+    struct t_lazyFreeJob *next;
+    Node *n;
+    NodeArena *a;
+} LazyFreeJob;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;  // signaled when jobs are queued
+    pthread_cond_t done;  // signaled when the queue is drained
+    LazyFreeJob *head;    // the next job
+    LazyFreeJob *tail;    // the last job
+    int started;          // whether the thread was started
+    LazyFreeStats stats;
+} __lazy = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static size_t __lazyFree_count(const Node *n, size_t limit, size_t count) {
+    NodeStats stats;
+    if (!n) return count;
+
+    count++;
+    switch (n->type) {
+        case N_DICT:
+            if (OBJ_OK == Node_GetCachedStats(n, &stats)) return count + stats.values;
+            for (uint32_t i = 0; i < n->value.dictval.len && count <= limit; i++) {
+                count = __lazyFree_count(n->value.dictval.entries[i], limit, count);
+            }
+            return count;
+        case N_ARRAY:
+            // a packed array's values are freed along with it
+            if (NODE_IS_PACKED_ARRAY(n)) return count;
+            if (OBJ_OK == Node_GetCachedStats(n, &stats)) return count + stats.values;
+            for (uint32_t i = 0; i < n->value.arrval.len && count <= limit; i++) {
+                count = __lazyFree_count(n->value.arrval.entries[i], limit, count);
+            }
+            return count;
+        case N_KEYVAL:
+            return __lazyFree_count(n->value.kvval.val, limit, count);
+        default:
+            return count;
+    }
+}
+
+size_t LazyFree_Effort(const Node *n, size_t limit) { return __lazyFree_count(n, limit, 0); }
+
+static void *__lazyFree_thread(void *arg) {
+    pthread_mutex_lock(&__lazy.lock);
+    while (1) {
+        while (!__lazy.head) pthread_cond_wait(&__lazy.work, &__lazy.lock);
+        LazyFreeJob *job = __lazy.head;
+        __lazy.head = job->next;
+        if (!__lazy.head) __lazy.tail = NULL;
+        pthread_mutex_unlock(&__lazy.lock);
+
+        Node_Free(job->n);
+        if (job->a) NodeArena_Free(job->a);
+        free(job);
+
+        pthread_mutex_lock(&__lazy.lock);
+        __lazy.stats.pending--;
+        __lazy.stats.freed++;
+        if (!__lazy.stats.pending) pthread_cond_broadcast(&__lazy.done);
+    }
+    return arg;
+}
+
+void LazyFree_Node(Node *n, NodeArena *a) {
+    pthread_mutex_lock(&__lazy.lock);
+    if (!__lazy.started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, __lazyFree_thread, NULL)) {
+            pthread_mutex_unlock(&__lazy.lock);
+            Node_Free(n);
+            if (a) NodeArena_Free(a);
+            return;
+        }
+        pthread_detach(thread);
+        __lazy.started = 1;
+    }
+
+    LazyFreeJob *job = malloc(sizeof(LazyFreeJob));
+    job->next = NULL;
+    job->n = n;
+    job->a = a;
+    if (__lazy.tail) {
+        __lazy.tail->next = job;
+    } else {
+        __lazy.head = job;
+    }
+    __lazy.tail = job;
+    __lazy.stats.pending++;
+    pthread_cond_signal(&__lazy.work);
+    pthread_mutex_unlock(&__lazy.lock);
+}
+
+void LazyFree_Wait() {
+    pthread_mutex_lock(&__lazy.lock);
+    while (__lazy.stats.pending) pthread_cond_wait(&__lazy.done, &__lazy.lock);
+    pthread_mutex_unlock(&__lazy.lock);
+}
+
+void LazyFree_GetStats(LazyFreeStats *stats) {
+    pthread_mutex_lock(&__lazy.lock);
+    *stats = __lazy.stats;
+    pthread_mutex_unlock(&__lazy.lock);
+}
@@ -0,0 +1,52 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LAZY_FREE_H__
+#define __LAZY_FREE_H__
+
+#include "object.h"
+
+#ifdef REDIS_MODULE_TARGET
+#include <alloc.h>
+#endif
+
+/**
+* Big trees are freed on a background thread, so deleting them doesn't block the caller. The
+* effort of freeing a tree is about its number of nodes, and is what callers compare with their
+* threshold for freeing lazily.
+*/
+typedef struct {
+    size_t pending;  // number of trees that are waiting to be freed, or being freed
+    size_t freed;    // number of trees that were freed on the background thread
+} LazyFreeStats;
+
+/** Returns the effort of freeing the node, counting no further than just over `limit` */
+size_t LazyFree_Effort(const Node *n, size_t limit);
+
+/**
+* Frees the node and the arena it was allocated from on the background thread, either may be NULL.
+* The tree is freed immediately if the thread can't be started.
+*/
+void LazyFree_Node(Node *n, NodeArena *a);
+
+/** Waits until all the pending trees are freed */
+void LazyFree_Wait();
+
+/** Reports the statistics of the lazily freed trees */
+void LazyFree_GetStats(LazyFreeStats *stats);
+
+#endif
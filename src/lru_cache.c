@@ -0,0 +1,160 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lru_cache.h"
+
+#define LRU_CACHE_MIN_BUCKETS 64
+
+struct t_lruCacheEntry {
+    struct t_lruCacheEntry *hnext;  // next entry in the bucket
+    struct t_lruCacheEntry *prev;   // more recently used entry
+    struct t_lruCacheEntry *next;   // less recently used entry
+    void *value;
+    size_t size;  // the entry's total size
+    uint32_t hash;
+    uint32_t len;
+    char key[];
+};
+
+static inline uint32_t __lru_hash(const char *key, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Unlinks an entry from the recency list. */
+static inline void __lru_unlink(LRUCache *c, LRUCacheEntry *e) {
+    if (e->prev) e->prev->next = e->next;
+    else c->head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else c->tail = e->prev;
+}
+
+/* Links an entry as the most recently used. */
+static inline void __lru_pushHead(LRUCache *c, LRUCacheEntry *e) {
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head) c->head->prev = e;
+    c->head = e;
+    if (!c->tail) c->tail = e;
+}
+
+/* Returns the address of the pointer to the entry with key, or to the end of its bucket. */
+static LRUCacheEntry **__lru_find(LRUCache *c, const char *key, size_t len, uint32_t hash) {
+    LRUCacheEntry **pe = &c->buckets[hash & (c->nbuckets - 1)];
+    while (*pe && !((*pe)->hash == hash && (*pe)->len == len && !memcmp((*pe)->key, key, len))) {
+        pe = &(*pe)->hnext;
+    }
+    return pe;
+}
+
+/* Removes an entry from the cache and frees it. */
+static void __lru_remove(LRUCache *c, LRUCacheEntry *e) {
+    LRUCacheEntry **pe = __lru_find(c, e->key, e->len, e->hash);
+    *pe = e->hnext;
+    __lru_unlink(c, e);
+    c->size -= e->size;
+    c->entries--;
+    if (c->freefn) c->freefn(e->value);
+    free(e);
+}
+
+static void __lru_rehash(LRUCache *c, uint32_t nbuckets) {
+    LRUCacheEntry **buckets = calloc(nbuckets, sizeof(LRUCacheEntry *));
+    for (uint32_t i = 0; i < c->nbuckets; i++) {
+        LRUCacheEntry *e = c->buckets[i];
+        while (e) {
+            LRUCacheEntry *next = e->hnext;
+            e->hnext = buckets[e->hash & (nbuckets - 1)];
+            buckets[e->hash & (nbuckets - 1)] = e;
+            e = next;
+        }
+    }
+    free(c->buckets);
+    c->buckets = buckets;
+    c->nbuckets = nbuckets;
+}
+
+LRUCache *NewLRUCache(size_t maxsize, LRUCacheFreeFunc freefn) {
+    LRUCache *c = calloc(1, sizeof(LRUCache));
+    c->maxsize = maxsize;
+    c->freefn = freefn;
+    c->nbuckets = LRU_CACHE_MIN_BUCKETS;
+    c->buckets = calloc(c->nbuckets, sizeof(LRUCacheEntry *));
+    return c;
+}
+
+void LRUCache_Clear(LRUCache *c) {
+    while (c->tail) __lru_remove(c, c->tail);
+}
+
+void LRUCache_Free(LRUCache *c) {
+    if (!c) return;
+    LRUCache_Clear(c);
+    free(c->buckets);
+    free(c);
+}
+
+void *LRUCache_Get(LRUCache *c, const char *key, size_t len) {
+    LRUCacheEntry *e = *__lru_find(c, key, len, __lru_hash(key, len));
+    if (!e) {
+        c->misses++;
+        return NULL;
+    }
+
+    c->hits++;
+    __lru_unlink(c, e);
+    __lru_pushHead(c, e);
+    return e->value;
+}
+
+void LRUCache_Put(LRUCache *c, const char *key, size_t len, void *value, size_t size) {
+    uint32_t hash = __lru_hash(key, len);
+    size += sizeof(LRUCacheEntry) + len;
+
+    // replace an existing value
+    LRUCacheEntry *e = *__lru_find(c, key, len, hash);
+    if (e) __lru_remove(c, e);
+
+    if (size > c->maxsize) {
+        if (c->freefn) c->freefn(value);
+        return;
+    }
+
+    // make room for it
+    while (c->size + size > c->maxsize) {
+        __lru_remove(c, c->tail);
+        c->evictions++;
+    }
+
+    e = malloc(sizeof(LRUCacheEntry) + len);
+    e->value = value;
+    e->size = size;
+    e->hash = hash;
+    e->len = len;
+    memcpy(e->key, key, len);
+
+    if (c->entries >= c->nbuckets) __lru_rehash(c, c->nbuckets * 2);
+    e->hnext = c->buckets[hash & (c->nbuckets - 1)];
+    c->buckets[hash & (c->nbuckets - 1)] = e;
+    __lru_pushHead(c, e);
+    c->size += size;
+    c->entries++;
+}
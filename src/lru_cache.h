@@ -0,0 +1,70 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LRU_CACHE_H__
+#define __LRU_CACHE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef REDIS_MODULE_TARGET
+#include <alloc.h>
+#endif
+
+/* Frees a value when it is evicted or replaced */
+typedef void (*LRUCacheFreeFunc)(void *value);
+
+typedef struct t_lruCacheEntry LRUCacheEntry;
+
+/**
+* A cache of values keyed by binary strings, bounded by the total size of its entries. The least
+* recently used entries are evicted to make room for new ones.
+*/
+typedef struct {
+    LRUCacheEntry **buckets;  // hash table of entries
+    uint32_t nbuckets;        // always a power of 2
+    LRUCacheEntry *head;      // most recently used entry
+    LRUCacheEntry *tail;      // least recently used entry
+    LRUCacheFreeFunc freefn;  // frees values, may be NULL
+    size_t maxsize;           // maximal total size of the entries
+    size_t size;              // total size of the entries
+    size_t entries;           // number of entries
+    uint64_t hits;            // number of lookups that found a value
+    uint64_t misses;          // number of lookups that didn't
+    uint64_t evictions;       // number of entries that were evicted to make room
+} LRUCache;
+
+/** Create a new cache with a maximal size in bytes, values are freed with the optional freefn */
+LRUCache *NewLRUCache(size_t maxsize, LRUCacheFreeFunc freefn);
+
+/** Free the cache and its values */
+void LRUCache_Free(LRUCache *c);
+
+/** Returns the value of key, or NULL if it isn't cached, and marks it as recently used */
+void *LRUCache_Get(LRUCache *c, const char *key, size_t len);
+
+/**
+* Caches a value of a given size (which should include whatever the value references) under key,
+* replacing any existing value. The value is freed immediately if it can't fit in the cache.
+*/
+void LRUCache_Put(LRUCache *c, const char *key, size_t len, void *value, size_t size);
+
+/** Removes all the entries from the cache, keeping its statistics */
+void LRUCache_Clear(LRUCache *c);
+
+#endif
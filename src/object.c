@@ -15,94 +15,421 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <pthread.h>
 #include "object.h"
+#include "json_number.h"
+
+/* === Node arena === */
+
+// the arena's chunks start small for small documents, and grow up to a limit for big ones
+#define ARENA_MIN_CHUNK_SIZE 256
+#define ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+
+struct t_arenaChunk {
+    struct t_arenaChunk *next;  // the previous chunk actually, chunks are kept as a stack
+    size_t size;                // chunk's usable size
+    size_t used;                // bytes used
+    char data[];
+};
+
+NodeArena *NewNodeArena() { return calloc(1, sizeof(NodeArena)); }
+
+void *NodeArena_Alloc(NodeArena *a, size_t size, size_t align) {
+    NodeArenaChunk *c = a->head;
+    size_t off = c ? (c->used + align - 1) & ~(align - 1) : 0;
+
+    if (!c || off + size > c->size) {
+        // each chunk is twice the size of its predecessor, and big enough for the allocation
+        size_t csize = c ? MIN(c->size * 2, ARENA_MAX_CHUNK_SIZE) : ARENA_MIN_CHUNK_SIZE;
+        if (csize < size) csize = size;
+        c = malloc(sizeof(NodeArenaChunk) + csize);
+        c->next = a->head;
+        c->size = csize;
+        c->used = 0;
+        a->head = c;
+        a->size += sizeof(NodeArenaChunk) + csize;
+        off = 0;
+    }
+
+    c->used = off + size;
+    return &c->data[off];
+}
+
+void NodeArena_Free(NodeArena *a) {
+    if (!a) return;
+
+    NodeArenaChunk *c = a->head;
+    while (c) {
+        NodeArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(a);
+}
+
+void NodeArena_Mark(NodeArena *a, NodeArenaMark *m) {
+    m->chunk = a->head;
+    m->used = a->head ? a->head->used : 0;
+}
+
+void NodeArena_Rewind(NodeArena *a, const NodeArenaMark *m) {
+    while (a->head != m->chunk) {
+        NodeArenaChunk *c = a->head;
+        a->head = c->next;
+        a->size -= sizeof(NodeArenaChunk) + c->size;
+        free(c);
+    }
+    if (a->head) a->head->used = m->used;
+}
+
+/* === Interned keys === */
+
+#define KEY_INTERN_MIN_BUCKETS 16
+
+typedef struct t_internedKey {
+    struct t_internedKey *next;  // the next key in the bucket
+    uint32_t hash;
+    uint32_t len;
+    uint32_t refcount;
+    char key[];
+} InternedKey;
+
+#define KEY_INTERN_SHARD_BITS 4
+#define KEY_INTERN_SHARDS (1 << KEY_INTERN_SHARD_BITS)
+
+/*
+* Documents are freed and loaded on background threads, so the table is sharded by the keys' hashes
+* and every shard is only accessed under its lock.
+*/
+typedef struct {
+    pthread_mutex_t lock;
+    InternedKey **buckets;  // hash table of keys
+    uint32_t nbuckets;      // always a power of 2
+    KeyInternStats stats;
+} KeyInternShard;
+
+static KeyInternShard __keys[KEY_INTERN_SHARDS] = {
+    [0 ... KEY_INTERN_SHARDS - 1] = {.lock = PTHREAD_MUTEX_INITIALIZER}};
+
+/* Returns the interned key that holds the NULL terminated string `key`. */
+#define __key_entry(key) ((InternedKey *)((char *)(key)-offsetof(InternedKey, key)))
+
+#define __key_size(len) (sizeof(InternedKey) + (len) + 1)
+
+/* The shard is picked by the hash's top bits, and the bucket in it by the bottom bits. */
+#define __key_shard(hash) (&__keys[(hash) >> (32 - KEY_INTERN_SHARD_BITS)])
+
+/* FNV-1a hash of a key of a given length. */
+static inline uint32_t __key_hash(const char *key, uint32_t len) {
+    uint32_t h = 2166136261u;
+    while (len--) {
+        h ^= (unsigned char)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void __key_rehash(KeyInternShard *ks, uint32_t nbuckets) {
+    InternedKey **buckets = calloc(nbuckets, sizeof(InternedKey *));
+    for (uint32_t i = 0; i < ks->nbuckets; i++) {
+        InternedKey *e = ks->buckets[i];
+        while (e) {
+            InternedKey *next = e->next;
+            e->next = buckets[e->hash & (nbuckets - 1)];
+            buckets[e->hash & (nbuckets - 1)] = e;
+            e = next;
+        }
+    }
+    free(ks->buckets);
+    ks->buckets = buckets;
+    ks->nbuckets = nbuckets;
+}
+
+const char *Key_Intern(const char *key, uint32_t len) {
+    uint32_t hash = __key_hash(key, len);
+    KeyInternShard *ks = __key_shard(hash);
+
+    pthread_mutex_lock(&ks->lock);
+    if (ks->nbuckets) {
+        InternedKey *e = ks->buckets[hash & (ks->nbuckets - 1)];
+        for (; e; e = e->next) {
+            if (e->hash == hash && e->len == len && !memcmp(e->key, key, len)) {
+                e->refcount++;
+                ks->stats.refs++;
+                ks->stats.refsize += len + 1;
+                pthread_mutex_unlock(&ks->lock);
+                return e->key;
+            }
+        }
+    }
+
+    if (ks->stats.keys >= ks->nbuckets) {
+        __key_rehash(ks, ks->nbuckets ? ks->nbuckets * 2 : KEY_INTERN_MIN_BUCKETS);
+    }
+
+    InternedKey *e = malloc(__key_size(len));
+    e->hash = hash;
+    e->len = len;
+    e->refcount = 1;
+    memcpy(e->key, key, len);
+    e->key[len] = '\0';
+    e->next = ks->buckets[hash & (ks->nbuckets - 1)];
+    ks->buckets[hash & (ks->nbuckets - 1)] = e;
+
+    ks->stats.keys++;
+    ks->stats.refs++;
+    ks->stats.size += __key_size(len);
+    ks->stats.refsize += len + 1;
+    pthread_mutex_unlock(&ks->lock);
+    return e->key;
+}
+
+void Key_Release(const char *key) {
+    InternedKey *e = __key_entry(key);
+    KeyInternShard *ks = __key_shard(e->hash);
+    pthread_mutex_lock(&ks->lock);
+    ks->stats.refs--;
+    ks->stats.refsize -= e->len + 1;
+    if (--e->refcount) {
+        pthread_mutex_unlock(&ks->lock);
+        return;
+    }
+
+    InternedKey **pe = &ks->buckets[e->hash & (ks->nbuckets - 1)];
+    while (*pe != e) pe = &(*pe)->next;
+    *pe = e->next;
+    ks->stats.keys--;
+    ks->stats.size -= __key_size(e->len);
+    pthread_mutex_unlock(&ks->lock);
+    free(e);
+}
+
+size_t Key_SharedSize(const char *key) {
+    InternedKey *e = __key_entry(key);
+    KeyInternShard *ks = __key_shard(e->hash);
+    pthread_mutex_lock(&ks->lock);
+    size_t size = __key_size(e->len) / e->refcount;
+    pthread_mutex_unlock(&ks->lock);
+    return size;
+}
+
+void Key_GetInternStats(KeyInternStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < KEY_INTERN_SHARDS; i++) {
+        pthread_mutex_lock(&__keys[i].lock);
+        stats->keys += __keys[i].stats.keys;
+        stats->refs += __keys[i].stats.refs;
+        stats->size += __keys[i].stats.size;
+        stats->refsize += __keys[i].stats.refsize;
+        pthread_mutex_unlock(&__keys[i].lock);
+    }
+}
+
+size_t Key_SharedSizeOf(size_t refsize) {
+    KeyInternStats stats;
+    Key_GetInternStats(&stats);
+    if (!stats.refsize) return 0;
+    return (size_t)((double)refsize * stats.size / stats.refsize);
+}
+
+/* === Nodes === */
 
-Node *__newNode(NodeType t) {
-    Node *ret = malloc(sizeof(Node));
+Node *__newNode(NodeArena *a, NodeType t) {
+    Node *ret;
+    if (a) {
+        ret = NodeArena_Alloc(a, sizeof(Node), sizeof(void *));
+        ret->flags = NODE_F_ARENA;
+    } else {
+        ret = malloc(sizeof(Node));
+        ret->flags = 0;
+    }
     ret->type = t;
     return ret;
 }
 
-Node *NewBoolNode(int val) {
-    Node *ret = __newNode(N_BOOLEAN);
+/* Allocates a NULL terminated copy of a string in the arena, or on the heap. */
+static char *__newString(NodeArena *a, const char *s, uint32_t len) {
+    if (!a) return strndup(s, len);
+
+    char *ret = NodeArena_Alloc(a, len + 1, 1);
+    memcpy(ret, s, len);
+    ret[len] = '\0';
+    return ret;
+}
+
+/* The size of an array's entries, which are values rather than nodes when it is packed. */
+static inline size_t __arrayItemSize(const Node *arr) {
+    return NODE_IS_PACKED_ARRAY(arr) ? sizeof(int64_t) : sizeof(Node *);
+}
+
+/* The size of a container's entries with a given capacity and item size, followed by a dictionary's
+ * index and the cached statistics of a big container. */
+static size_t __entriesSize(NodeType t, uint32_t cap, size_t itemsize) {
+    size_t size = cap * itemsize;
+    if (N_DICT == t) size += __dictIndexCap(cap) * sizeof(uint32_t);
+    if (cap >= OBJ_STATS_MIN_CAP) size += sizeof(NodeStats);
+    return size;
+}
+
+/* Allocates zeroed entries, and the dictionary's index, in the arena or on the heap. */
+static void *__newEntries(NodeArena *a, size_t size) {
+    if (!a) return calloc(1, size);
+
+    return memset(NodeArena_Alloc(a, size, sizeof(void *)), 0, size);
+}
+
+/* Resizes a container's entries, moving them to the heap if they are in an arena. */
+static void *__resizeEntries(Node *n, void *entries, size_t oldsize, size_t newsize) {
+    if (!(n->flags & NODE_F_ARENA_ENTRIES)) return realloc(entries, newsize);
+
+    void *ret = malloc(newsize);
+    memcpy(ret, entries, MIN(oldsize, newsize));
+    n->flags &= ~NODE_F_ARENA_ENTRIES;
+    return ret;
+}
+
+Node *NewBoolNodeEx(NodeArena *a, int val) {
+    Node *ret = __newNode(a, N_BOOLEAN);
     ret->value.boolval = val != 0;
     return ret;
 }
 
-Node *NewDoubleNode(double val) {
-    Node *ret = __newNode(N_NUMBER);
+Node *NewDoubleNodeEx(NodeArena *a, double val) {
+    Node *ret = __newNode(a, N_NUMBER);
     ret->value.numval = val;
     return ret;
 }
 
-Node *NewIntNode(int64_t val) {
-    Node *ret = __newNode(N_INTEGER);
+Node *NewIntNodeEx(NodeArena *a, int64_t val) {
+    Node *ret = __newNode(a, N_INTEGER);
     ret->value.intval = val;
     return ret;
 }
 
-Node *NewStringNode(const char *s, uint32_t len) {
-    Node *ret = __newNode(N_STRING);
-    ret->value.strval.data = strndup(s, len);
+/* Frees a string node's data unless it is in an arena or in the node. */
+#define __node_FreeStringData(n) \
+    if (!(n->flags & (NODE_F_ARENA_DATA | NODE_F_INLINE))) free((char *)n->value.strval.data);
+
+/* Stores a short string in the node itself. */
+static inline void __setInlineString(Node *n, const char *s, uint32_t len) {
+    memcpy(n->value.istrval.data, s, len);
+    n->value.istrval.len = (uint8_t)len;
+    n->flags |= NODE_F_INLINE;
+}
+
+Node *NewStringNodeEx(NodeArena *a, const char *s, uint32_t len) {
+    Node *ret = __newNode(a, N_STRING);
+    if (len <= NODE_INLINE_STRING_MAX) {
+        __setInlineString(ret, s, len);
+        return ret;
+    }
+    ret->value.strval.data = __newString(a, s, len);
     ret->value.strval.len = len;
+    if (a) ret->flags |= NODE_F_ARENA_DATA;
     return ret;
 }
 
-Node *NewCStringNode(const char *s) { return NewStringNode(s, strlen(s)); }
-
-Node *NewKeyValNode(const char *key, uint32_t len, Node *n) {
-    Node *ret = __newNode(N_KEYVAL);
-    ret->value.kvval.key = strndup(key, len);
+Node *NewKeyValNodeEx(NodeArena *a, const char *key, uint32_t len, Node *n) {
+    Node *ret = __newNode(a, N_KEYVAL);
+    ret->value.kvval.key = Key_Intern(key, len);
     ret->value.kvval.val = n;
     return ret;
 }
 
-Node *NewArrayNode(uint32_t cap) {
-    Node *ret = __newNode(N_ARRAY);
+Node *NewStringNodeFromArena(NodeArena *a, const char *s, uint32_t len) {
+    Node *ret = __newNode(a, N_STRING);
+    if (len <= NODE_INLINE_STRING_MAX) {
+        __setInlineString(ret, s, len);
+        return ret;
+    }
+    ret->value.strval.data = s;
+    ret->value.strval.len = len;
+    ret->flags |= NODE_F_ARENA_DATA;
+    return ret;
+}
+
+Node *NewArrayNodeEx(NodeArena *a, uint32_t cap) {
+    Node *ret = __newNode(a, N_ARRAY);
     ret->value.arrval.cap = cap;
     ret->value.arrval.len = 0;
-    ret->value.arrval.entries = calloc(cap, sizeof(Node *));
+    ret->value.arrval.entries = __newEntries(a, __entriesSize(N_ARRAY, cap, sizeof(Node *)));
+    if (a) ret->flags |= NODE_F_ARENA_ENTRIES;
     return ret;
 }
 
-Node *NewDictNode(uint32_t cap) {
-    Node *ret = __newNode(N_DICT);
+Node *NewDictNodeEx(NodeArena *a, uint32_t cap) {
+    Node *ret = __newNode(a, N_DICT);
     ret->value.dictval.cap = cap;
     ret->value.dictval.len = 0;
-    ret->value.dictval.entries = calloc(cap, sizeof(Node *));
+    // the zeroed index slots are all empty
+    ret->value.dictval.entries = __newEntries(a, __entriesSize(N_DICT, cap, sizeof(Node *)));
+    if (a) ret->flags |= NODE_F_ARENA_ENTRIES;
     return ret;
 }
 
+Node *NewPackedArrayNodeEx(NodeArena *a, uint8_t packing, uint32_t len) {
+    Node *ret = __newNode(a, N_ARRAY);
+    ret->flags |= packing;
+    ret->value.arrval.cap = len;
+    ret->value.arrval.len = len;
+    ret->value.arrval.entries = __newEntries(a, __entriesSize(N_ARRAY, len, sizeof(int64_t)));
+    if (a) ret->flags |= NODE_F_ARENA_ENTRIES;
+    return ret;
+}
+
+Node *NewBoolNode(int val) { return NewBoolNodeEx(NULL, val); }
+
+Node *NewDoubleNode(double val) { return NewDoubleNodeEx(NULL, val); }
+
+Node *NewIntNode(int64_t val) { return NewIntNodeEx(NULL, val); }
+
+Node *NewStringNode(const char *s, uint32_t len) { return NewStringNodeEx(NULL, s, len); }
+
+Node *NewCStringNode(const char *s) { return NewStringNode(s, strlen(s)); }
+
+Node *NewKeyValNode(const char *key, uint32_t len, Node *n) {
+    return NewKeyValNodeEx(NULL, key, len, n);
+}
+
+Node *NewArrayNode(uint32_t cap) { return NewArrayNodeEx(NULL, cap); }
+
+Node *NewDictNode(uint32_t cap) { return NewDictNodeEx(NULL, cap); }
+
+/* Frees the node's struct unless it is in an arena. */
+#define __node_FreeSelf(n) \
+    if (!(n->flags & NODE_F_ARENA)) free(n);
+
 void __node_FreeKV(Node *n) {
     Node_Free(n->value.kvval.val);
-    free((char *)n->value.kvval.key);
-    free(n);
+    Key_Release(n->value.kvval.key);
+    __node_FreeSelf(n);
 }
 
 void __node_FreeObj(Node *n) {
     for (int i = 0; i < n->value.dictval.len; i++) {
         Node_Free(n->value.dictval.entries[i]);
     }
-    if (n->value.dictval.entries) free(n->value.dictval.entries);
-    free(n);
+    if (!(n->flags & NODE_F_ARENA_ENTRIES)) free(n->value.dictval.entries);
+    __node_FreeSelf(n);
 }
 
 void __node_FreeArr(Node *n) {
-    for (int i = 0; i < n->value.arrval.len; i++) {
+    // a packed array's values aren't nodes
+    for (int i = 0; !NODE_IS_PACKED_ARRAY(n) && i < n->value.arrval.len; i++) {
         Node_Free(n->value.arrval.entries[i]);
     }
-    free(n->value.arrval.entries);
-    free(n);
+    if (!(n->flags & NODE_F_ARENA_ENTRIES)) free(n->value.arrval.entries);
+    __node_FreeSelf(n);
 }
 
 void __node_FreeString(Node *n) {
-    free((char *)n->value.strval.data);
-    free(n);
+    __node_FreeStringData(n);
+    __node_FreeSelf(n);
 }
 
 void Node_Free(Node *n) {
-    // ignore NULL nodes
-    if (!n) return;
+    // ignore NULL nodes, and the copies of packed arrays' items that own nothing
+    if (!n || n->flags & NODE_F_PACKED_ITEM) return;
 
     switch (n->type) {
         case N_ARRAY:
@@ -118,7 +445,7 @@ void Node_Free(Node *n) {
             __node_FreeKV(n);
             break;
         default:
-            free(n);
+            __node_FreeSelf(n);
     }
 }
 
@@ -133,7 +460,7 @@ int Node_Length(const Node *n) {
                 return n->value.dictval.len;
                 break;
             case N_STRING:
-                return n->value.strval.len;
+                return NODE_STRING_LEN(n);
                 break;
             default:
                 break;
@@ -144,34 +471,358 @@ int Node_Length(const Node *n) {
 }
 
 int Node_StringAppend(Node *dst, Node *src) {
-    t_string *d = &dst->value.strval;
-    t_string *s = &src->value.strval;
+    uint32_t dlen = NODE_STRING_LEN(dst), slen = NODE_STRING_LEN(src);
+
+    // short results stay in the node
+    if (dlen + slen <= NODE_INLINE_STRING_MAX) {
+        char buf[NODE_INLINE_STRING_MAX];
+        memcpy(buf, NODE_STRING_DATA(dst), dlen);
+        memcpy(&buf[dlen], NODE_STRING_DATA(src), slen);
+        __node_FreeStringData(dst);
+        dst->flags &= ~NODE_F_ARENA_DATA;
+        __setInlineString(dst, buf, dlen + slen);
+        return OBJ_OK;
+    }
+
+    char *newval = malloc(dlen + slen + 1);
+    memcpy(newval, NODE_STRING_DATA(dst), dlen);
+    memcpy(&newval[dlen], NODE_STRING_DATA(src), slen);
+    newval[dlen + slen] = '\0';
+
+    __node_FreeStringData(dst);
+    dst->flags &= ~(NODE_F_ARENA_DATA | NODE_F_INLINE);
+    dst->value.strval.data = newval;
+    dst->value.strval.len = dlen + slen;
+
+    return OBJ_OK;
+}
+
+/* === Statistics === */
+
+size_t __nodeEntriesSize(const Node *n) {
+    if (N_DICT == n->type) return __entriesSize(N_DICT, n->value.dictval.cap, sizeof(Node *));
+    return __entriesSize(N_ARRAY, n->value.arrval.cap, __arrayItemSize(n));
+}
+
+/* The cached statistics of a big container follow everything else in its entries. */
+#define __node_stats(n) \
+    ((NodeStats *)((char *)(n)->value.arrval.entries + __nodeEntriesSize(n) - sizeof(NodeStats)))
+
+/* Adds the statistics `a` to `s`, or subtracts them when `sign` is -1. */
+static inline void __stats_add(NodeStats *s, const NodeStats *a, int sign) {
+    s->values += sign * a->values;
+    s->bytes += sign * a->bytes;
+    s->memory += sign * a->memory;
+    s->heap += sign * a->heap;
+    s->keys += sign * a->keys;
+}
+
+/* The length of a string's serialization, escaped like the JSON serializer in json_object.c does:
+ * printable ASCII is kept as is, except for the quotation mark and the (reverse) solidus that are
+ * escaped with a reverse solidus like the common control characters, and everything else is escaped
+ * as a unicode codepoint. Keys only have the quotation mark, the reverse solidus and control
+ * characters escaped. */
+static uint64_t __stats_stringBytes(const char *s, size_t len, int key) {
+    uint64_t bytes = 2;
+    for (size_t i = 0; i < len; i++) {
+        switch (s[i]) {
+            case '"':
+            case '\\':
+            case '\b':
+            case '\f':
+            case '\n':
+            case '\r':
+            case '\t':
+                bytes += 2;
+                break;
+            case '/':
+                bytes += key ? 1 : 2;
+                break;
+            default:
+                if (key)
+                    bytes += (unsigned char)s[i] > 31 ? 1 : 6;
+                else
+                    bytes += (unsigned char)s[i] > 31 && (unsigned char)s[i] < 127 ? 1 : 6;
+                break;
+        }
+    }
+    return bytes;
+}
+
+/* The length of an integer's serialization. */
+static uint64_t __stats_intBytes(int64_t v) {
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    uint64_t bytes = v < 0 ? 2 : 1;
+    while (u >= 10) {
+        u /= 10;
+        bytes++;
+    }
+    return bytes;
+}
+
+/* The length of a number's serialization, which is formatted like the JSON serializer does. */
+static uint64_t __stats_doubleBytes(double d) {
+    char num[JSONNUMBER_MAX_LENGTH];
+    return JSONNumber_FormatDouble(num, d);
+}
+
+/* Reports a node's own statistics, i.e. without its children's or a keyval's value's. */
+static void __node_OwnStats(const Node *n, NodeStats *s) {
+    *s = (NodeStats){.values = 1};
+    if (!n) {
+        s->bytes = 4;  // null
+        return;
+    }
+
+    // a packed array's values are accounted for in its entries
+    if (!(n->flags & NODE_F_PACKED_ITEM)) {
+        s->memory = sizeof(Node);
+        if (!(n->flags & NODE_F_ARENA)) s->heap = sizeof(Node);
+    }
 
-    char *newval = calloc(d->len + s->len, sizeof(char));
-    strncpy(newval, d->data, d->len);
-    strncpy(&newval[d->len], s->data, s->len);
+    switch (n->type) {
+        case N_BOOLEAN:
+            s->bytes = n->value.boolval ? 4 : 5;
+            break;
+        case N_INTEGER:
+            s->bytes = __stats_intBytes(n->value.intval);
+            break;
+        case N_NUMBER:
+            s->bytes = __stats_doubleBytes(n->value.numval);
+            break;
+        case N_STRING:
+            s->bytes = __stats_stringBytes(NODE_STRING_DATA(n), NODE_STRING_LEN(n), 0);
+            if (n->flags & NODE_F_INLINE) break;
+            s->memory += n->value.strval.len;
+            if (!(n->flags & NODE_F_ARENA_DATA)) s->heap += n->value.strval.len;
+            break;
+        case N_KEYVAL: {
+            size_t len = strlen(n->value.kvval.key);
+            s->values = 0;  // the value is counted on its own
+            s->bytes = __stats_stringBytes(n->value.kvval.key, len, 1) + 1;
+            s->keys = len + 1;
+            break;
+        }
+        case N_DICT:
+        case N_ARRAY: {
+            uint32_t len = N_DICT == n->type ? n->value.dictval.len : n->value.arrval.len;
+            size_t size = __nodeEntriesSize(n);
+            s->bytes = 2 + (len ? len - 1 : 0);
+            s->memory += size;
+            if (!(n->flags & NODE_F_ARENA_ENTRIES)) s->heap += size;
+            break;
+        }
+        case N_NULL:  // keeps the compiler from complaining
+            break;
+    }
+}
+
+/* Reports the sum of the statistics of a container's keyvals, or of an array's items or values. */
+static void __node_ChildrenStats(Node *n, NodeStats *s) {
+    NodeStats child;
+    *s = (NodeStats){0};
+
+    if (N_DICT == n->type) {
+        for (uint32_t i = 0; i < n->value.dictval.len; i++) {
+            Node_GetStats(n->value.dictval.entries[i], &child);
+            __stats_add(s, &child, 1);
+        }
+    } else if (NODE_IS_PACKED_ARRAY(n)) {
+        Node item;
+        for (uint32_t i = 0; i < n->value.arrval.len; i++) {
+            __node_OwnStats(Node_ArrayItemPeek(n, i, &item), &child);
+            __stats_add(s, &child, 1);
+        }
+    } else {
+        for (uint32_t i = 0; i < n->value.arrval.len; i++) {
+            Node_GetStats(n->value.arrval.entries[i], &child);
+            __stats_add(s, &child, 1);
+        }
+    }
+}
+
+void Node_GetStats(Node *n, NodeStats *stats) {
+    NodeStats children;
+
+    __node_OwnStats(n, stats);
+    if (!n) return;
+
+    if (N_KEYVAL == n->type) {
+        Node_GetStats(n->value.kvval.val, &children);
+        __stats_add(stats, &children, 1);
+    } else if (n->type & (N_DICT | N_ARRAY)) {
+        if (!(n->flags & NODE_F_STATS)) {
+            __node_ChildrenStats(n, &children);
+            if ((N_DICT == n->type ? n->value.dictval.cap : n->value.arrval.cap) >=
+                OBJ_STATS_MIN_CAP) {
+                *__node_stats(n) = children;
+                n->flags |= NODE_F_STATS;
+            }
+        } else {
+            children = *__node_stats(n);
+        }
+        __stats_add(stats, &children, 1);
+    }
+}
 
-    free((char *)d->data);
-    d->data = newval;
-    d->len += s->len;
+int Node_GetCachedStats(const Node *n, NodeStats *stats) {
+    if (!n || !(n->type & (N_DICT | N_ARRAY)) || !(n->flags & NODE_F_STATS)) return OBJ_ERR;
 
+    __node_OwnStats(n, stats);
+    __stats_add(stats, __node_stats(n), 1);
     return OBJ_OK;
 }
 
+void Node_UpdateStats(Node *n, const NodeStats *before, const NodeStats *after) {
+    if (!n || !(n->type & (N_DICT | N_ARRAY)) || !(n->flags & NODE_F_STATS)) return;
+
+    __stats_add(__node_stats(n), before, -1);
+    __stats_add(__node_stats(n), after, 1);
+}
+
+/* Adds a child's statistics to its container's cached sums, or subtracts them when `sign` is -1. */
+static void __node_StatsAddChild(Node *n, Node *child, int sign) {
+    NodeStats stats;
+    if (!(n->flags & NODE_F_STATS)) return;
+
+    Node_GetStats(child, &stats);
+    __stats_add(__node_stats(n), &stats, sign);
+}
+
+/* Like __node_StatsAddChild, for the value at index of a packed array. */
+static void __node_StatsAddValue(Node *arr, uint32_t index, int sign) {
+    NodeStats stats;
+    Node item;
+    if (!(arr->flags & NODE_F_STATS)) return;
+
+    __node_OwnStats(Node_ArrayItemPeek(arr, index, &item), &stats);
+    __stats_add(__node_stats(arr), &stats, sign);
+}
+
+/* Keeps a copy of a container's cached statistics while its entries are reallocated. */
+#define __node_SaveStats(n, saved) \
+    if ((n)->flags & NODE_F_STATS) saved = *__node_stats(n);
+#define __node_RestoreStats(n, saved) \
+    if ((n)->flags & NODE_F_STATS) *__node_stats(n) = saved;
+
+/* === Packed arrays === */
+
+void __node_ArrayMakeRoomFor(Node *arr, uint32_t addlen);
+
+/* Sets the packing of an empty array to `flag`, or to no packing when it is 0. */
+static void __node_ArraySetPacking(Node *arr, uint8_t flag) {
+    t_array *a = &arr->value.arrval;
+    size_t size = a->cap * __arrayItemSize(arr);
+    // the capacity may change, and the cached statistics with it, which are all zeros anyway
+    arr->flags = (arr->flags & ~(NODE_F_INT_ARRAY | NODE_F_NUM_ARRAY | NODE_F_STATS)) | flag;
+    a->cap = size / __arrayItemSize(arr);
+}
+
+/* Returns 1 if the array can store values of the packing `flag`, packing it if it is empty. */
+static int __node_ArrayPackable(Node *arr, uint8_t flag) {
+    if (arr->flags & flag) return 1;
+    if (arr->value.arrval.len) return 0;
+    __node_ArraySetPacking(arr, flag);
+    return 1;
+}
+
+/* Returns the packing flag for a node that can be stored as a value, or 0. */
+static inline uint8_t __packingOf(const Node *n) {
+    if (!n || (n->type != N_INTEGER && n->type != N_NUMBER)) return 0;
+    return N_INTEGER == n->type ? NODE_F_INT_ARRAY : NODE_F_NUM_ARRAY;
+}
+
+/* Stores a node's number as the value at index of a packed array. */
+static inline void __node_ArraySetValue(Node *arr, uint32_t index, const Node *n) {
+    if (arr->flags & NODE_F_INT_ARRAY) {
+        NODE_ARRAY_INTS(arr)[index] = n->value.intval;
+    } else {
+        NODE_ARRAY_NUMS(arr)[index] = n->value.numval;
+    }
+}
+
+/* Unpacks a packed array's values to nodes on the heap, so it can hold anything. */
+static void __node_ArrayDemote(Node *arr) {
+    t_array *a = &arr->value.arrval;
+    NodeStats stats = {0};
+    if (!NODE_IS_PACKED_ARRAY(arr)) return;
+
+    // every value becomes a node on the heap
+    __node_SaveStats(arr, stats);
+    stats.memory += a->len * sizeof(Node);
+    stats.heap += a->len * sizeof(Node);
+
+    Node **entries = malloc(__entriesSize(N_ARRAY, MAX(a->cap, 1), sizeof(Node *)));
+    for (uint32_t i = 0; i < a->len; i++) {
+        entries[i] = arr->flags & NODE_F_INT_ARRAY ? NewIntNode(NODE_ARRAY_INTS(arr)[i])
+                                                   : NewDoubleNode(NODE_ARRAY_NUMS(arr)[i]);
+    }
+    if (!(arr->flags & NODE_F_ARENA_ENTRIES)) free(a->entries);
+    arr->flags &= ~(NODE_F_INT_ARRAY | NODE_F_NUM_ARRAY | NODE_F_ARENA_ENTRIES);
+    a->entries = entries;
+    a->cap = MAX(a->cap, 1);
+    __node_RestoreStats(arr, stats);
+}
+
+const Node *Node_ArrayItemPeek(const Node *arr, uint32_t index, Node *scratch) {
+    if (!NODE_IS_PACKED_ARRAY(arr)) return arr->value.arrval.entries[index];
+
+    scratch->flags = NODE_F_PACKED_ITEM;
+    if (arr->flags & NODE_F_INT_ARRAY) {
+        scratch->type = N_INTEGER;
+        scratch->value.intval = NODE_ARRAY_INTS(arr)[index];
+    } else {
+        scratch->type = N_NUMBER;
+        scratch->value.numval = NODE_ARRAY_NUMS(arr)[index];
+    }
+    return scratch;
+}
+
+int Node_ArrayAppendInt(NodeArena *a, Node *arr, int64_t val) {
+    if (!__node_ArrayPackable(arr, NODE_F_INT_ARRAY)) {
+        return Node_ArrayAppend(arr, NewIntNodeEx(a, val));
+    }
+    __node_ArrayMakeRoomFor(arr, 1);
+    NODE_ARRAY_INTS(arr)[arr->value.arrval.len++] = val;
+    __node_StatsAddValue(arr, arr->value.arrval.len - 1, 1);
+    return OBJ_OK;
+}
+
+int Node_ArrayAppendDouble(NodeArena *a, Node *arr, double val) {
+    if (!__node_ArrayPackable(arr, NODE_F_NUM_ARRAY)) {
+        return Node_ArrayAppend(arr, NewDoubleNodeEx(a, val));
+    }
+    __node_ArrayMakeRoomFor(arr, 1);
+    NODE_ARRAY_NUMS(arr)[arr->value.arrval.len++] = val;
+    __node_StatsAddValue(arr, arr->value.arrval.len - 1, 1);
+    return OBJ_OK;
+}
+
+/* === Arrays === */
+
 int Node_ArrayDelRange(Node *arr, const int index, const int count) {
     t_array *a = &arr->value.arrval;
+    size_t size = __arrayItemSize(arr);
+    char *entries = (char *)a->entries;
 
     if (count <= 0 || !a->len) return OBJ_OK;
 
     int start = index < 0 ? MAX(a->len + index, 0) : MIN(index, a->len - 1);
     int stop = MIN(start + count, a->len);  // stop is exclusive
 
-    // free range
-    for (int i = start; i < stop; i++) Node_Free(a->entries[i]);
+    // account for the range, and free it
+    for (int i = start; arr->flags & NODE_F_STATS && i < stop; i++) {
+        if (NODE_IS_PACKED_ARRAY(arr)) {
+            __node_StatsAddValue(arr, i, -1);
+        } else {
+            __node_StatsAddChild(arr, a->entries[i], -1);
+        }
+    }
+    for (int i = start; !NODE_IS_PACKED_ARRAY(arr) && i < stop; i++) Node_Free(a->entries[i]);
 
     // move whatever remains on the left side
     if (stop < a->len)
-        memmove(&a->entries[start], &a->entries[stop], (a->len - stop) * sizeof(Node *));
+        memmove(&entries[start * size], &entries[stop * size], (a->len - stop) * size);
 
     // adjust length
     a->len -= stop - start;
@@ -206,8 +857,26 @@ void __node_ArrayMakeRoomFor(Node *arr, uint32_t addlen) {
         nextcap = ((newcap / CHUNK_SIZE) + 1) * CHUNK_SIZE;
     }
 
+    size_t size = __arrayItemSize(arr);
+    NodeStats stats;
+    __node_SaveStats(arr, stats);
+    a->entries = __resizeEntries(arr, a->entries, __nodeEntriesSize(arr),
+                                 __entriesSize(N_ARRAY, nextcap, size));
     a->cap = nextcap;
-    a->entries = realloc(a->entries, a->cap * sizeof(Node *));
+    __node_RestoreStats(arr, stats);
+}
+
+/* Returns the packing of the array's items if they are all numbers of the same type, or 0. */
+static uint8_t __node_ArrayItemsPacking(const Node *arr) {
+    const t_array *a = &arr->value.arrval;
+    if (NODE_IS_PACKED_ARRAY(arr)) return arr->flags & (NODE_F_INT_ARRAY | NODE_F_NUM_ARRAY);
+    if (!a->len) return 0;
+
+    uint8_t flag = __packingOf(a->entries[0]);
+    for (uint32_t i = 1; flag && i < a->len; i++) {
+        if (__packingOf(a->entries[i]) != flag) return 0;
+    }
+    return flag;
 }
 
 int Node_ArrayInsert(Node *arr, int index, Node *sub) {
@@ -218,17 +887,40 @@ int Node_ArrayInsert(Node *arr, int index, Node *sub) {
     if (index < 0) index = 0;                       // not in range always start at the beginning
     if (index > (int)a->len) index = (int)a->len;   // or appended at the end
 
+    // numbers go into a packed array as values, anything else unpacks it
+    uint8_t packing = __node_ArrayItemsPacking(sub);
+    if (!packing || !__node_ArrayPackable(arr, packing)) {
+        __node_ArrayDemote(arr);
+        __node_ArrayDemote(sub);
+        packing = 0;
+    }
+
+    size_t size = __arrayItemSize(arr);
+    char *entries;
     __node_ArrayMakeRoomFor(arr, s->len);
+    entries = (char *)a->entries;
     if (index < (int) a->len) {                     //  shift contents to the right
-        memmove(&a->entries[index + s->len], &a->entries[index], (a->len - index) * sizeof(Node *));
+        memmove(&entries[(index + s->len) * size], &entries[index * size], (a->len - index) * size);
     }
 
-    // copy the references
-    memcpy(&a->entries[index], s->entries, s->len * sizeof(Node *));
+    if (!packing || NODE_IS_PACKED_ARRAY(sub)) {
+        // copy the references, or the values
+        memcpy(&entries[index * size], s->entries, s->len * size);
+    } else {
+        // copy the nodes' values, the nodes are freed with sub
+        for (uint32_t i = 0; i < s->len; i++) __node_ArraySetValue(arr, index + i, s->entries[i]);
+    }
     a->len += s->len;
+    for (uint32_t i = index; arr->flags & NODE_F_STATS && i < index + s->len; i++) {
+        if (packing) {
+            __node_StatsAddValue(arr, i, 1);
+        } else {
+            __node_StatsAddChild(arr, a->entries[i], 1);
+        }
+    }
 
-    // destroy all traces
-    s->len = 0;
+    // destroy all traces, except for the nodes that were moved
+    if (!packing) s->len = 0;
     Node_Free(sub);
 
     return OBJ_OK;
@@ -236,8 +928,22 @@ int Node_ArrayInsert(Node *arr, int index, Node *sub) {
 
 int Node_ArrayAppend(Node *arr, Node *n) {
     t_array *a = &arr->value.arrval;
+
+    // a packed array keeps a matching number as a value and frees its node
+    if (NODE_IS_PACKED_ARRAY(arr)) {
+        if (__packingOf(n) && __node_ArrayPackable(arr, __packingOf(n))) {
+            __node_ArrayMakeRoomFor(arr, 1);
+            __node_ArraySetValue(arr, a->len++, n);
+            __node_StatsAddValue(arr, a->len - 1, 1);
+            Node_Free(n);
+            return OBJ_OK;
+        }
+        __node_ArrayDemote(arr);
+    }
+
     __node_ArrayMakeRoomFor(arr, 1);
     a->entries[a->len++] = n;
+    __node_StatsAddChild(arr, n, 1);
 
     return OBJ_OK;
 }
@@ -255,7 +961,25 @@ int Node_ArraySet(Node *arr, int index, Node *n) {
     if (index < 0 || index >= a->len) {
         return OBJ_ERR;
     }
+
+    // a packed array keeps a matching number as a value and frees its node
+    if (NODE_IS_PACKED_ARRAY(arr)) {
+        if (__packingOf(n) && arr->flags & __packingOf(n)) {
+            __node_StatsAddValue(arr, index, -1);
+            __node_ArraySetValue(arr, index, n);
+            __node_StatsAddValue(arr, index, 1);
+            Node_Free(n);
+            return OBJ_OK;
+        }
+        // the caller only had a copy of the replaced value, so its node is freed here
+        __node_ArrayDemote(arr);
+        __node_StatsAddChild(arr, a->entries[index], -1);
+        Node_Free(a->entries[index]);
+    } else {
+        __node_StatsAddChild(arr, a->entries[index], -1);
+    }
     a->entries[index] = n;
+    __node_StatsAddChild(arr, n, 1);
 
     return OBJ_OK;
 }
@@ -268,6 +992,8 @@ int Node_ArrayItem(Node *arr, int index, Node **n) {
         *n = NULL;
         return OBJ_ERR;
     }
+    // the caller may keep or change the item, so it has to be a node of its own
+    __node_ArrayDemote(arr);
     *n = a->entries[index];
     return OBJ_OK;
 }
@@ -291,6 +1017,18 @@ int Node_ArrayIndex(Node *arr, Node *n, int start, int stop) {
     if (stop == 0) stop = a->len;                           // stop after the end
     if (stop < start) stop = start;                         // don't search at all
 
+    // a packed array can only contain numbers of its own type
+    if (NODE_IS_PACKED_ARRAY(arr)) {
+        if (__packingOf(n) != (arr->flags & (NODE_F_INT_ARRAY | NODE_F_NUM_ARRAY))) return -1;
+        for (int i = start; i < stop; i++) {
+            if (N_INTEGER == n->type ? NODE_ARRAY_INTS(arr)[i] == n->value.intval
+                                     : NODE_ARRAY_NUMS(arr)[i] == n->value.numval) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
     // search for the value
     for (int i = start; i < stop; i++) {
         if (!n && !a->entries[i]) return i;             // both are nulls
@@ -300,9 +1038,9 @@ int Node_ArrayIndex(Node *arr, Node *n, int start, int stop) {
         // Check equality per scalar type
         switch (n->type) {
             case N_STRING:
-                if ((n->value.strval.len == a->entries[i]->value.strval.len) &&
-                    !strncmp(n->value.strval.data, a->entries[i]->value.strval.data,
-                             n->value.strval.len)) {
+                if ((NODE_STRING_LEN(n) == NODE_STRING_LEN(a->entries[i])) &&
+                    !strncmp(NODE_STRING_DATA(n), NODE_STRING_DATA(a->entries[i]),
+                             NODE_STRING_LEN(n))) {
                     return i;
                 }
                 break;
@@ -323,7 +1061,82 @@ int Node_ArrayIndex(Node *arr, Node *n, int start, int stop) {
     return -1;  // unfound
 }
 
+uint32_t __dictIndexCap(uint32_t cap) {
+    if (cap < OBJ_DICT_INDEX_MIN_CAP) return 0;
+
+    // keep the load factor at or below 0.5, with a power of 2 number of slots for masking
+    uint32_t icap = OBJ_DICT_INDEX_MIN_CAP * 2;
+    while (icap < cap * 2) icap <<= 1;
+    return icap;
+}
+
+/* The index slots follow the entries in the same allocation. */
+#define __dict_index(o) ((uint32_t *)&(o)->entries[(o)->cap])
+
+/* FNV-1a hash of a NULL terminated key. */
+static inline uint32_t __dict_hash(const char *key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Returns the index slot that holds the entry at position pos. */
+static uint32_t __dict_slotOf(t_dict *o, uint32_t pos) {
+    uint32_t *index = __dict_index(o);
+    uint32_t mask = __dictIndexCap(o->cap) - 1;
+    uint32_t slot = __dict_hash(o->entries[pos]->value.kvval.key) & mask;
+    while (index[slot] != pos + 1) slot = (slot + 1) & mask;
+    return slot;
+}
+
+/* Adds the entry at position pos to the index. */
+static void __dict_indexAdd(t_dict *o, uint32_t pos) {
+    uint32_t *index = __dict_index(o);
+    uint32_t mask = __dictIndexCap(o->cap) - 1;
+    uint32_t slot = __dict_hash(o->entries[pos]->value.kvval.key) & mask;
+    while (index[slot]) slot = (slot + 1) & mask;
+    index[slot] = pos + 1;
+}
+
+/* Empties a slot in the index, shifting back the entries that follow it so no tombstones are
+ * needed by the linear probing. */
+static void __dict_indexDel(t_dict *o, uint32_t slot) {
+    uint32_t *index = __dict_index(o);
+    uint32_t mask = __dictIndexCap(o->cap) - 1;
+    uint32_t next = slot;
+
+    index[slot] = 0;
+    while (index[next = (next + 1) & mask]) {
+        uint32_t home = __dict_hash(o->entries[index[next] - 1]->value.kvval.key) & mask;
+        // move the entry back if its home slot isn't (cyclically) between the hole and it
+        if ((next > slot && (home <= slot || home > next)) ||
+            (next < slot && (home <= slot && home > next))) {
+            index[slot] = index[next];
+            index[next] = 0;
+            slot = next;
+        }
+    }
+}
+
 Node *__obj_find(t_dict *o, const char *key, int *idx) {
+    if (__dictIndexCap(o->cap)) {
+        uint32_t *index = __dict_index(o);
+        uint32_t mask = __dictIndexCap(o->cap) - 1;
+        for (uint32_t slot = __dict_hash(key) & mask; index[slot]; slot = (slot + 1) & mask) {
+            Node *kv = o->entries[index[slot] - 1];
+            if (!strcmp(key, kv->value.kvval.key)) {
+                if (idx) *idx = index[slot] - 1;
+
+                return kv;
+            }
+        }
+
+        return NULL;
+    }
+
     for (int i = 0; i < o->len; i++) {
         if (!strcmp(key, o->entries[i]->value.kvval.key)) {
             if (idx) *idx = i;
@@ -335,12 +1148,27 @@ Node *__obj_find(t_dict *o, const char *key, int *idx) {
     return NULL;
 }
 
-#define __obj_insert(o, n)                                             \
-    if (o->len >= o->cap) {                                            \
-        o->cap += o->cap ? MIN(o->cap, 1024 * 1024) : 1;               \
-        o->entries = realloc(o->entries, o->cap * sizeof(t_keyval *)); \
-    }                                                                  \
+/* Appends a new entry to the dictionary, growing it (and rebuilding its index) when needed. */
+static void __obj_insert(Node *obj, Node *n) {
+    t_dict *o = &obj->value.dictval;
+    if (o->len >= o->cap) {
+        NodeStats stats;
+        size_t oldsize = __nodeEntriesSize(obj);
+        __node_SaveStats(obj, stats);
+        o->cap += o->cap ? MIN(o->cap, 1024 * 1024) : 1;
+        uint32_t icap = __dictIndexCap(o->cap);
+        o->entries = __resizeEntries(obj, o->entries, oldsize, __nodeEntriesSize(obj));
+        __node_RestoreStats(obj, stats);
+        if (icap) {
+            memset(__dict_index(o), 0, icap * sizeof(uint32_t));
+            for (uint32_t i = 0; i < o->len; i++) __dict_indexAdd(o, i);
+        }
+    }
+
     o->entries[o->len++] = n;
+    if (__dictIndexCap(o->cap)) __dict_indexAdd(o, o->len - 1);
+    __node_StatsAddChild(obj, n, 1);
+}
 
 int Node_DictSet(Node *obj, const char *key, Node *n) {
     t_dict *o = &obj->value.dictval;
@@ -351,15 +1179,17 @@ int Node_DictSet(Node *obj, const char *key, Node *n) {
     Node *kv = __obj_find(o, key, &idx);
     // first find a replacement possiblity
     if (kv) {
+        __node_StatsAddChild(obj, kv, -1);
         if (kv->value.kvval.val) {
             Node_Free(kv->value.kvval.val);
         }
         kv->value.kvval.val = n;
+        __node_StatsAddChild(obj, kv, 1);
         return OBJ_OK;
     }
 
     // append another entry
-    __obj_insert(o, NewKeyValNode(key, strlen(key), n));
+    __obj_insert(obj, NewKeyValNode(key, strlen(key), n));
 
     return OBJ_OK;
 }
@@ -371,15 +1201,17 @@ int Node_DictSetKeyVal(Node *obj, Node *kv) {
 
     int idx;
     Node *_kv = __obj_find(o, kv->value.kvval.key, &idx);
-    // first find a replacement possiblity
+    // first find a replacement possiblity, the index is unaffected as the key is the same
     if (_kv) {
+        __node_StatsAddChild(obj, _kv, -1);
         o->entries[idx] = kv;
+        __node_StatsAddChild(obj, kv, 1);
         Node_Free(_kv);
         return OBJ_OK;
     }
 
     // append another entry
-    __obj_insert(o, kv);
+    __obj_insert(obj, kv);
 
     return OBJ_OK;
 }
@@ -394,19 +1226,25 @@ int Node_DictDel(Node *obj, const char *key) {
 
     // tried to delete a non existing node
     if (!kv) return OBJ_ERR;
+    __node_StatsAddChild(obj, kv, -1);
 
-    // let's delete the node's memory
-    if (kv->value.kvval.val) {
-        Node_Free(kv->value.kvval.val);
+    // remove the entry, and the top entry that replaces it, from the index
+    int indexed = __dictIndexCap(o->cap) != 0;
+    if (indexed) {
+        __dict_indexDel(o, __dict_slotOf(o, idx));
+        if (idx < o->len - 1) __dict_indexDel(o, __dict_slotOf(o, o->len - 1));
     }
-    free((char *)kv->value.kvval.key);
 
     // replace the deleted entry and the top entry to avoid holes
     if (idx < o->len - 1) {
         o->entries[idx] = o->entries[o->len - 1];
+        if (indexed) __dict_indexAdd(o, idx);
     }
     o->len--;
 
+    // let's delete the node's memory
+    Node_Free(kv);
+
     return OBJ_OK;
 }
 
@@ -435,10 +1273,11 @@ void __objTraverse(Node *n, NodeVisitor f, void *ctx) {
 }
 void __arrTraverse(Node *n, NodeVisitor f, void *ctx) {
     t_array *a = &n->value.arrval;
+    Node item;
     f(n, ctx);
 
     for (int i = 0; i < a->len; i++) {
-        Node_Traverse(a->entries[i], f, ctx);
+        Node_Traverse((Node *)Node_ArrayItemPeek(n, i, &item), f, ctx);
     }
 }
 
@@ -476,10 +1315,11 @@ void Node_Print(Node *n, int depth) {
         case N_NULL:    // stop the compiler from complaining
             break;
         case N_ARRAY: {
+            Node item;
             printf("[\n");
             for (int i = 0; i < n->value.arrval.len; i++) {
                 __node_indent(depth + 1);
-                Node_Print(n->value.arrval.entries[i], depth + 1);
+                Node_Print((Node *)Node_ArrayItemPeek(n, i, &item), depth + 1);
                 if (i < n->value.arrval.len - 1) printf(",");
                 printf("\n");
             }
@@ -512,7 +1352,7 @@ void Node_Print(Node *n, int depth) {
             Node_Print(n->value.kvval.val, depth);
         } break;
         case N_STRING:
-            printf("\"%.*s\"", n->value.strval.len, n->value.strval.data);
+            printf("\"%.*s\"", NODE_STRING_LEN(n), NODE_STRING_DATA(n));
     }
 }
 
@@ -556,6 +1396,7 @@ void Node_Serializer(const Node *n, const NodeSerializerOpt *o, void *ctx) {
     int curr_len;
     int curr_index;
     Node **curr_entries;
+    Node item;  // a packed array's current item, which is always the top of the stack
     NodeSerializerStack stack = {0};
     NodeSerializerState state = S_INIT;
 
@@ -596,7 +1437,11 @@ void Node_Serializer(const Node *n, const NodeSerializerOpt *o, void *ctx) {
                 if (curr_index < curr_len) {
                     if (curr_index && _maskenabled(curr_node, o->xDelim)) o->fDelim(ctx);
                     Vector_Put(stack.indices, stack.level - 1, curr_index + 1);
-                    _serializerPush(&stack, curr_entries[curr_index]);
+                    if (N_ARRAY == curr_node->type) {
+                        _serializerPush(&stack, Node_ArrayItemPeek(curr_node, curr_index, &item));
+                    } else {
+                        _serializerPush(&stack, curr_entries[curr_index]);
+                    }
                     state = S_BEGIN_VALUE;
                 } else {
                     state = S_END_VALUE;
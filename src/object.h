@@ -18,6 +18,7 @@
 #ifndef __OBJECT_H__
 #define __OBJECT_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,8 +63,22 @@ typedef struct {
     uint32_t len;
 } t_string;
 
+// Strings of up to this many bytes are stored in the node itself
+#define NODE_INLINE_STRING_MAX 15
+
+/*
+* Internal representation of a short string that's stored in the node, its data isn't NULL
+* terminated. Use NODE_STRING_DATA and NODE_STRING_LEN to access a string node in either form.
+*/
+typedef struct {
+    char data[NODE_INLINE_STRING_MAX];
+    uint8_t len;
+} t_inlineString;
+
 /*
-* Internal representation of an array, that has a length and capacity
+* Internal representation of an array, that has a length and capacity. Arrays of numbers of a single
+* type can be packed (see NODE_F_INT_ARRAY and NODE_F_NUM_ARRAY), in which case the entries are a
+* buffer of int64_t or double values rather than of nodes.
 */
 typedef struct {
     struct t_node **entries;
@@ -73,7 +88,7 @@ typedef struct {
 
 /*
 * Internal representation of a key-value pair in an object.
-* The key is a NULL terminated C-string, the value is another node
+* The key is an interned NULL terminated C-string, the value is another node
 */
 typedef struct {
     const char *key;
@@ -82,8 +97,9 @@ typedef struct {
 
 /*
 * Internal representation of a dictionary node.
-* Currently implemented as a list of key-value pairs, will be converted
-* to a hash-table on big objects in the future
+* Implemented as a list of key-value pairs that preserves insertion order. Once the capacity reaches
+* OBJ_DICT_INDEX_MIN_CAP, an open-addressing hash index of entry positions is kept in the same
+* allocation right after the entries, so lookups in big objects don't need to scan the list.
 */
 typedef struct {
     struct t_node **entries;
@@ -91,6 +107,19 @@ typedef struct {
     uint32_t cap;
 } t_dict;
 
+// Dictionaries with at least this capacity are hash indexed
+#define OBJ_DICT_INDEX_MIN_CAP 32
+
+/* Node storage flags, set for the parts of a node that were allocated from a NodeArena */
+#define NODE_F_ARENA 0x1          // the node itself
+#define NODE_F_ARENA_DATA 0x2     // a string's data
+#define NODE_F_ARENA_ENTRIES 0x4  // an array's or a dictionary's entries
+#define NODE_F_INLINE 0x8         // a string that's stored in the node itself
+#define NODE_F_INT_ARRAY 0x10     // an array that's packed as a buffer of int64_t values
+#define NODE_F_NUM_ARRAY 0x20     // an array that's packed as a buffer of double values
+#define NODE_F_PACKED_ITEM 0x40   // a transient copy of a packed array's item
+#define NODE_F_STATS 0x80         // a container's cached statistics are up to date
+
 /*
 * A node in an object can be any one of the types we support.
 * Basically an object is just a treee of nodes that can have children
@@ -103,6 +132,7 @@ typedef struct t_node {
         double numval;
         int64_t intval;
         t_string strval;
+        t_inlineString istrval;
         t_array arrval;
         t_dict dictval;
         t_keyval kvval;
@@ -110,10 +140,109 @@ typedef struct t_node {
 
     // type specifier
     NodeType type;
+
+    // storage flags
+    uint8_t flags;
 } Node;
 
 typedef Node Object;
 
+/*
+* The aggregate statistics of a subtree: the number of JSON values in it, the length of its compact
+* JSON serialization, and the memory that its nodes take, in total and only on the heap (i.e. not in
+* an arena). Interned keys are shared with other documents, so their memory is kept apart as the size
+* of a copy of every key that's referenced, i.e. its length and a terminator. Key_SharedSizeOf turns
+* it into the keys' share of the interned table.
+*/
+typedef struct {
+    uint64_t values;
+    uint64_t bytes;
+    uint64_t memory;
+    uint64_t heap;
+    uint64_t keys;
+} NodeStats;
+
+/*
+* Containers with at least this capacity keep the sum of their children's statistics right after
+* their entries (and a dictionary's index), so the statistics of big subtrees are known without
+* walking them. The sums are computed on demand and then kept up to date as the container changes.
+*/
+#define OBJ_STATS_MIN_CAP 32
+
+/* A packed array's values */
+#define NODE_IS_PACKED_ARRAY(n) ((n)->flags & (NODE_F_INT_ARRAY | NODE_F_NUM_ARRAY))
+#define NODE_ARRAY_INTS(n) ((int64_t *)(n)->value.arrval.entries)
+#define NODE_ARRAY_NUMS(n) ((double *)(n)->value.arrval.entries)
+
+/* A string node's data and length, whether it is inline or not */
+#define NODE_STRING_DATA(n) \
+    ((n)->flags & NODE_F_INLINE ? (n)->value.istrval.data : (n)->value.strval.data)
+#define NODE_STRING_LEN(n) \
+    ((n)->flags & NODE_F_INLINE ? (uint32_t)(n)->value.istrval.len : (n)->value.strval.len)
+
+/*
+* A node arena is a list of big chunks that the nodes of a document, and their string and entry
+* buffers, are carved from. Nodes that are created in an arena can be freed as usual, but their
+* memory is only released when the arena itself is freed. Growing a container's entries that are in
+* an arena moves them to the heap.
+*/
+typedef struct t_arenaChunk NodeArenaChunk;
+typedef struct {
+    NodeArenaChunk *head;  // the chunk that's currently being allocated from
+    size_t size;           // total size of all chunks in bytes
+} NodeArena;
+
+/** Create a new empty node arena */
+NodeArena *NewNodeArena();
+
+/** Allocate size bytes, aligned to align (a power of 2), from the arena */
+void *NodeArena_Alloc(NodeArena *a, size_t size, size_t align);
+
+/** Free the arena and all the memory that was allocated from it */
+void NodeArena_Free(NodeArena *a);
+
+/* A point in an arena's allocations that it can be rewound to */
+typedef struct {
+    NodeArenaChunk *chunk;
+    size_t used;
+} NodeArenaMark;
+
+/** Mark the arena's current allocation point */
+void NodeArena_Mark(NodeArena *a, NodeArenaMark *m);
+
+/** Release everything that was allocated from the arena since the mark, which must be unused */
+void NodeArena_Rewind(NodeArena *a, const NodeArenaMark *m);
+
+/*
+* Dictionary keys are interned in a global table, so identical keys in any number of objects and
+* documents are stored once. Interned keys are reference counted, and are freed along with the last
+* keyval node that references them.
+*/
+typedef struct {
+    size_t keys;     // number of interned keys
+    size_t refs;     // number of references to them
+    size_t size;     // bytes allocated for the interned keys
+    size_t refsize;  // bytes that a copy of the key per reference would have taken
+} KeyInternStats;
+
+/** Returns the interned NULL terminated copy of a key, adding a reference to it */
+const char *Key_Intern(const char *key, uint32_t len);
+
+/** Releases a reference to an interned key, freeing it if it was the last one */
+void Key_Release(const char *key);
+
+/** Returns an interned key's share of its allocation, i.e. its size divided by its references */
+size_t Key_SharedSize(const char *key);
+
+/** Reports the statistics of the interned keys */
+void Key_GetInternStats(KeyInternStats *stats);
+
+/**
+* Returns the share of the interned keys' memory of references to keys that would take `refsize`
+* bytes as copies, at the table's average ratio of interned to copied size
+*/
+size_t Key_SharedSizeOf(size_t refsize);
+
 /** Create a new boolean node, with 0 as false 1 as true */
 Node *NewBoolNode(int val);
 
@@ -125,7 +254,7 @@ Node *NewIntNode(int64_t val);
 
 /**
 * Create a new string node with the given c-string and its length.
-* NOTE: The string's value will be copied to a newly allocated string
+* NOTE: The string's value will be copied to the node if it is short, or to a newly allocated string
 */
 Node *NewStringNode(const char *s, uint32_t len);
 
@@ -138,7 +267,7 @@ Node *NewCStringNode(const char *su);
 /**
 * Create a new keyval node from a C-string and its length as key and a pointer
 * to a Node as value.
-* NOTE: The string's value will be copied to a newly allocated string
+* NOTE: The key is interned, see Key_Intern
 */
 Node *NewKeyValNode(const char *key, uint32_t len, Node *n);
 
@@ -148,6 +277,28 @@ Node *NewArrayNode(uint32_t cap);
 /** Create a new dict node with the given capacity */
 Node *NewDictNode(uint32_t cap);
 
+/* The arena variants of the constructors above, a NULL arena means allocating from the heap. */
+Node *NewBoolNodeEx(NodeArena *a, int val);
+Node *NewDoubleNodeEx(NodeArena *a, double val);
+Node *NewIntNodeEx(NodeArena *a, int64_t val);
+Node *NewStringNodeEx(NodeArena *a, const char *s, uint32_t len);
+Node *NewKeyValNodeEx(NodeArena *a, const char *key, uint32_t len, Node *n);
+Node *NewArrayNodeEx(NodeArena *a, uint32_t cap);
+Node *NewDictNodeEx(NodeArena *a, uint32_t cap);
+
+/**
+* Like NewStringNodeEx, but unless it is short the string isn't copied and the node references it
+* instead. It must be NULL terminated and allocated from the arena `a`, which can't be NULL.
+*/
+Node *NewStringNodeFromArena(NodeArena *a, const char *s, uint32_t len);
+
+/**
+* Creates an array of `len` zeroed values that's packed by `packing`, either NODE_F_INT_ARRAY or
+* NODE_F_NUM_ARRAY, with no spare capacity. The caller sets the values with NODE_ARRAY_INTS or
+* NODE_ARRAY_NUMS, which is how a loader that knows the values up front creates the array.
+*/
+Node *NewPackedArrayNodeEx(NodeArena *a, uint8_t packing, uint32_t len);
+
 /** Free a node, and if needed free its allocated data and its children recursively */
 void Node_Free(Node *n);
 
@@ -173,15 +324,32 @@ int Node_ArrayInsert(Node *arr, int index, Node *sub);
 /** Append a node to an array node. */
 int Node_ArrayAppend(Node *arr, Node *n);
 
+/**
+* Append a number to an array node. An empty or a packed array of the same type stores the number as
+* a value, other arrays get a new node that's allocated from the arena `a` (or the heap if NULL).
+*/
+int Node_ArrayAppendInt(NodeArena *a, Node *arr, int64_t val);
+int Node_ArrayAppendDouble(NodeArena *a, Node *arr, double val);
+
 /** Prepend a node to an array node. */
 int Node_ArrayPrepend(Node *arr, Node *n);
 
 /**
 * Set an array's member at a given index to a new node.
 * If the index is out of range, we will return an error
+* The replaced item is left for the caller to free, unless the array is packed: a matching number is
+* then stored as a value and its node is freed, and anything else unpacks the array, with the
+* replaced value's node freed here since the caller could only have a copy of it (see
+* Node_ArrayItemPeek, whose copies Node_Free ignores).
 */
 int Node_ArraySet(Node *arr, int index, Node *n);
 
+/**
+* Returns an array's item at an index that's in range for reading. The item of a packed array is
+* copied to `scratch`, which is returned, so the array isn't unpacked to nodes.
+*/
+const Node *Node_ArrayItemPeek(const Node *arr, uint32_t index, Node *scratch);
+
 /**
 * Retrieve an array item into Node n's pointer by index
 * Returns OBJ_ERR if the index is out of range
@@ -220,6 +388,31 @@ int Node_DictDel(Node *objm, const char *key);
 */
 int Node_DictGet(Node *obj, const char *key, Node **val);
 
+/** Returns the number of hash index slots kept by a dictionary of the given capacity (0 if none) */
+uint32_t __dictIndexCap(uint32_t cap);
+
+/** Returns the size of a container's entries, including a dictionary's index and statistics */
+size_t __nodeEntriesSize(const Node *n);
+
+/**
+* Reports the statistics of a node and everything under it. Big containers' cached sums are used and
+* refreshed as needed, so only the rest of the subtree is walked.
+*/
+void Node_GetStats(Node *n, NodeStats *stats);
+
+/**
+* Like Node_GetStats, but only for containers that have up to date cached statistics. Returns
+* OBJ_ERR for anything that would need to be walked.
+*/
+int Node_GetCachedStats(const Node *n, NodeStats *stats);
+
+/**
+* Applies the change of one of a container's descendants, from the `before` statistics to `after`,
+* to its cached statistics. Changes to a container's own children are accounted for by the functions
+* that make them, this is for the containers above it. See SearchPath_UpdateStats.
+*/
+void Node_UpdateStats(Node *n, const NodeStats *before, const NodeStats *after);
+
 /* The type signature of visitor callbacks for node trees */
 typedef void (*NodeVisitor)(Node *, void *);
 void __objTraverse(Node *n, NodeVisitor f, void *ctx);
@@ -0,0 +1,370 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "object_pack.h"
+
+/* === Packing === */
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+} _PackBuffer;
+
+static inline void __pack_reserve(_PackBuffer *b, size_t len) {
+    if (b->len + len <= b->cap) return;
+    while (b->len + len > b->cap) b->cap = b->cap ? b->cap * 2 : 256;
+    b->buf = realloc(b->buf, b->cap);
+}
+
+static inline void __pack_byte(_PackBuffer *b, uint8_t c) {
+    __pack_reserve(b, 1);
+    b->buf[b->len++] = (char)c;
+}
+
+static inline void __pack_bytes(_PackBuffer *b, const char *s, size_t len) {
+    __pack_reserve(b, len);
+    memcpy(&b->buf[b->len], s, len);
+    b->len += len;
+}
+
+static inline void __pack_varint(_PackBuffer *b, uint64_t v) {
+    __pack_reserve(b, 10);
+    while (v >= 0x80) {
+        b->buf[b->len++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    b->buf[b->len++] = (char)v;
+}
+
+static inline uint64_t __zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+
+static inline int64_t __unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+static inline void __pack_double(_PackBuffer *b, double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    __pack_reserve(b, 8);
+    for (int i = 0; i < 8; i++) b->buf[b->len++] = (char)(bits >> (8 * i));
+}
+
+/* Returns the type shared by all of the array's items, or N_NULL if they are of different types. */
+static NodeType __pack_arrayType(const Node *arr) {
+    const t_array *a = &arr->value.arrval;
+    if (arr->flags & NODE_F_INT_ARRAY) return N_INTEGER;
+    if (arr->flags & NODE_F_NUM_ARRAY) return N_NUMBER;
+    if (!a->len || !a->entries[0]) return N_NULL;
+
+    NodeType t = a->entries[0]->type;
+    for (uint32_t i = 1; i < a->len; i++) {
+        if (!a->entries[i] || a->entries[i]->type != t) return N_NULL;
+    }
+    return t;
+}
+
+static void __pack_node(_PackBuffer *b, const Node *n) {
+    if (!n) {
+        __pack_byte(b, PACK_TAG_NULL);
+        return;
+    }
+
+    switch (n->type) {
+        case N_BOOLEAN:
+            __pack_byte(b, n->value.boolval ? PACK_TAG_TRUE : PACK_TAG_FALSE);
+            break;
+        case N_INTEGER: {
+            uint64_t z = __zigzag(n->value.intval);
+            if (z < PACK_TAG_INLINE_INTEGER) {
+                __pack_byte(b, PACK_TAG_INLINE_INTEGER | (uint8_t)z);
+            } else {
+                __pack_byte(b, PACK_TAG_INTEGER);
+                __pack_varint(b, z);
+            }
+            break;
+        }
+        case N_NUMBER:
+            __pack_byte(b, PACK_TAG_NUMBER);
+            __pack_double(b, n->value.numval);
+            break;
+        case N_STRING:
+            __pack_byte(b, PACK_TAG_STRING);
+            __pack_varint(b, NODE_STRING_LEN(n));
+            __pack_bytes(b, NODE_STRING_DATA(n), NODE_STRING_LEN(n));
+            break;
+        case N_DICT: {
+            const t_dict *d = &n->value.dictval;
+            __pack_byte(b, PACK_TAG_DICT);
+            __pack_varint(b, d->len);
+            for (uint32_t i = 0; i < d->len; i++) {
+                const t_keyval *kv = &d->entries[i]->value.kvval;
+                size_t klen = strlen(kv->key);
+                __pack_varint(b, klen);
+                __pack_bytes(b, kv->key, klen);
+                __pack_node(b, kv->val);
+            }
+            break;
+        }
+        case N_ARRAY: {
+            const t_array *a = &n->value.arrval;
+            // homogeneous numeric arrays are packed as runs of values without tags
+            switch (a->len > 1 || NODE_IS_PACKED_ARRAY(n) ? __pack_arrayType(n) : N_NULL) {
+                case N_INTEGER:
+                    __pack_byte(b, PACK_TAG_INTEGER_ARRAY);
+                    __pack_varint(b, a->len);
+                    for (uint32_t i = 0; i < a->len; i++) {
+                        __pack_varint(b, __zigzag(NODE_IS_PACKED_ARRAY(n)
+                                                      ? NODE_ARRAY_INTS(n)[i]
+                                                      : a->entries[i]->value.intval));
+                    }
+                    break;
+                case N_NUMBER:
+                    __pack_byte(b, PACK_TAG_NUMBER_ARRAY);
+                    __pack_varint(b, a->len);
+                    for (uint32_t i = 0; i < a->len; i++) {
+                        __pack_double(b, NODE_IS_PACKED_ARRAY(n) ? NODE_ARRAY_NUMS(n)[i]
+                                                                 : a->entries[i]->value.numval);
+                    }
+                    break;
+                default:
+                    __pack_byte(b, PACK_TAG_ARRAY);
+                    __pack_varint(b, a->len);
+                    for (uint32_t i = 0; i < a->len; i++) {
+                        __pack_node(b, a->entries[i]);
+                    }
+                    break;
+            }
+            break;
+        }
+        case N_NULL:  // keeps the compiler from complaining
+        case N_KEYVAL:
+            // keyvals are only found inside dictionaries
+            __pack_byte(b, PACK_TAG_NULL);
+            break;
+    }
+}
+
+void Node_Pack(const Node *n, char **buf, size_t *len) {
+    _PackBuffer b = {0};
+    __pack_node(&b, n);
+    *buf = b.buf;
+    *len = b.len;
+}
+
+/* === Unpacking === */
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    NodeArena *arena;
+} _UnpackContext;
+
+static inline int __unpack_varint(_UnpackContext *u, uint64_t *v) {
+    uint64_t ret = 0;
+    for (int shift = 0; shift < 64 && u->p < u->end; shift += 7) {
+        uint8_t c = *u->p++;
+        ret |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *v = ret;
+            return OBJ_OK;
+        }
+    }
+    return OBJ_ERR;
+}
+
+static inline int __unpack_double(_UnpackContext *u, double *d) {
+    uint64_t bits = 0;
+    if (u->end - u->p < 8) return OBJ_ERR;
+    for (int i = 0; i < 8; i++) bits |= (uint64_t)u->p[i] << (8 * i);
+    u->p += 8;
+    memcpy(d, &bits, sizeof(bits));
+    return OBJ_OK;
+}
+
+/* Reads a count of items that each take at least `minsize` bytes, and validates it. */
+static inline int __unpack_count(_UnpackContext *u, size_t minsize, uint32_t *count) {
+    uint64_t v;
+    if (OBJ_OK != __unpack_varint(u, &v) || v > UINT32_MAX ||
+        v * minsize > (uint64_t)(u->end - u->p)) {
+        return OBJ_ERR;
+    }
+    *count = (uint32_t)v;
+    return OBJ_OK;
+}
+
+static int __unpack_node(_UnpackContext *u, Node **n) {
+    uint64_t v;
+    uint32_t count;
+    Node *ret = NULL;
+
+    if (u->p >= u->end) return OBJ_ERR;
+    uint8_t tag = *u->p++;
+
+    if (tag & PACK_TAG_INLINE_INTEGER) {
+        *n = NewIntNodeEx(u->arena, __unzigzag(tag & ~PACK_TAG_INLINE_INTEGER));
+        return OBJ_OK;
+    }
+
+    switch (tag) {
+        case PACK_TAG_NULL:
+            break;
+        case PACK_TAG_FALSE:
+        case PACK_TAG_TRUE:
+            ret = NewBoolNodeEx(u->arena, PACK_TAG_TRUE == tag);
+            break;
+        case PACK_TAG_INTEGER:
+            if (OBJ_OK != __unpack_varint(u, &v)) return OBJ_ERR;
+            ret = NewIntNodeEx(u->arena, __unzigzag(v));
+            break;
+        case PACK_TAG_NUMBER: {
+            double d;
+            if (OBJ_OK != __unpack_double(u, &d)) return OBJ_ERR;
+            ret = NewDoubleNodeEx(u->arena, d);
+            break;
+        }
+        case PACK_TAG_STRING:
+            if (OBJ_OK != __unpack_count(u, 1, &count)) return OBJ_ERR;
+            ret = NewStringNodeEx(u->arena, (const char *)u->p, count);
+            u->p += count;
+            break;
+        case PACK_TAG_DICT:
+            // every entry takes at least two bytes: an empty key and a null value
+            if (OBJ_OK != __unpack_count(u, 2, &count)) return OBJ_ERR;
+            ret = NewDictNodeEx(u->arena, count);
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t klen;
+                Node *val;
+                if (OBJ_OK != __unpack_count(u, 1, &klen)) goto error;
+                Node *kv = NewKeyValNodeEx(u->arena, (const char *)u->p, klen, NULL);
+                u->p += klen;
+                Node_DictSetKeyVal(ret, kv);
+                if (OBJ_OK != __unpack_node(u, &val)) goto error;
+                kv->value.kvval.val = val;
+            }
+            break;
+        case PACK_TAG_ARRAY:
+            if (OBJ_OK != __unpack_count(u, 1, &count)) return OBJ_ERR;
+            ret = NewArrayNodeEx(u->arena, count);
+            for (uint32_t i = 0; i < count; i++) {
+                Node *item;
+                if (OBJ_OK != __unpack_node(u, &item)) goto error;
+                Node_ArrayAppend(ret, item);
+            }
+            break;
+        case PACK_TAG_INTEGER_ARRAY:
+            if (OBJ_OK != __unpack_count(u, 1, &count)) return OBJ_ERR;
+            // the values are read straight into the array, which is created at its length
+            ret = NewPackedArrayNodeEx(u->arena, NODE_F_INT_ARRAY, count);
+            for (uint32_t i = 0; i < count; i++) {
+                if (OBJ_OK != __unpack_varint(u, &v)) goto error;
+                NODE_ARRAY_INTS(ret)[i] = __unzigzag(v);
+            }
+            break;
+        case PACK_TAG_NUMBER_ARRAY:
+            if (OBJ_OK != __unpack_count(u, 8, &count)) return OBJ_ERR;
+            ret = NewPackedArrayNodeEx(u->arena, NODE_F_NUM_ARRAY, count);
+            for (uint32_t i = 0; i < count; i++) {
+                // the count was validated against the remaining length
+                __unpack_double(u, &NODE_ARRAY_NUMS(ret)[i]);
+            }
+            break;
+        default:
+            return OBJ_ERR;
+    }
+
+    *n = ret;
+    return OBJ_OK;
+
+error:
+    Node_Free(ret);
+    return OBJ_ERR;
+}
+
+/* Skips a packed node, failing just where __unpack_node would, but without creating anything. */
+static int __unpack_skip(_UnpackContext *u) {
+    uint64_t v;
+    uint32_t count;
+
+    if (u->p >= u->end) return OBJ_ERR;
+    uint8_t tag = *u->p++;
+    if (tag & PACK_TAG_INLINE_INTEGER) return OBJ_OK;
+
+    switch (tag) {
+        case PACK_TAG_NULL:
+        case PACK_TAG_FALSE:
+        case PACK_TAG_TRUE:
+            return OBJ_OK;
+        case PACK_TAG_INTEGER:
+            return __unpack_varint(u, &v);
+        case PACK_TAG_NUMBER:
+            if (u->end - u->p < 8) return OBJ_ERR;
+            u->p += 8;
+            return OBJ_OK;
+        case PACK_TAG_STRING:
+            if (OBJ_OK != __unpack_count(u, 1, &count)) return OBJ_ERR;
+            u->p += count;
+            return OBJ_OK;
+        case PACK_TAG_DICT:
+            if (OBJ_OK != __unpack_count(u, 2, &count)) return OBJ_ERR;
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t klen;
+                if (OBJ_OK != __unpack_count(u, 1, &klen)) return OBJ_ERR;
+                u->p += klen;
+                if (OBJ_OK != __unpack_skip(u)) return OBJ_ERR;
+            }
+            return OBJ_OK;
+        case PACK_TAG_ARRAY:
+            if (OBJ_OK != __unpack_count(u, 1, &count)) return OBJ_ERR;
+            for (uint32_t i = 0; i < count; i++) {
+                if (OBJ_OK != __unpack_skip(u)) return OBJ_ERR;
+            }
+            return OBJ_OK;
+        case PACK_TAG_INTEGER_ARRAY:
+            if (OBJ_OK != __unpack_count(u, 1, &count)) return OBJ_ERR;
+            for (uint32_t i = 0; i < count; i++) {
+                if (OBJ_OK != __unpack_varint(u, &v)) return OBJ_ERR;
+            }
+            return OBJ_OK;
+        case PACK_TAG_NUMBER_ARRAY:
+            if (OBJ_OK != __unpack_count(u, 8, &count)) return OBJ_ERR;
+            u->p += (size_t)count * 8;
+            return OBJ_OK;
+        default:
+            return OBJ_ERR;
+    }
+}
+
+int Node_UnpackCheck(const char *buf, size_t len) {
+    _UnpackContext u = {.p = (const uint8_t *)buf, .end = (const uint8_t *)buf + len};
+    if (OBJ_OK != __unpack_skip(&u) || u.p != u.end) return OBJ_ERR;
+    return OBJ_OK;
+}
+
+int Node_Unpack(const char *buf, size_t len, NodeArena *a, Node **n) {
+    _UnpackContext u = {.p = (const uint8_t *)buf, .end = (const uint8_t *)buf + len, .arena = a};
+    Node *ret;
+
+    if (OBJ_OK != __unpack_node(&u, &ret)) return OBJ_ERR;
+
+    // trailing garbage means the buffer isn't what we think it is
+    if (u.p != u.end) {
+        Node_Free(ret);
+        return OBJ_ERR;
+    }
+
+    *n = ret;
+    return OBJ_OK;
+}
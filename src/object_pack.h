@@ -0,0 +1,76 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OBJECT_PACK_H__
+#define __OBJECT_PACK_H__
+
+#include "object.h"
+
+#ifdef REDIS_MODULE_TARGET
+#include <alloc.h>
+#endif
+
+/**
+* The packed encoding is a compact binary representation of a node and its children, used for
+* storing values in RDB files. Every value starts with a tag byte followed by the tag's payload:
+*
+*   0x00        null
+*   0x01        false
+*   0x02        true
+*   0x03        integer: zigzag varint
+*   0x04        number: 8 bytes, IEEE 754 little endian
+*   0x05        string: varint length, bytes
+*   0x06        dictionary: varint count, count * (varint key length, key bytes, value)
+*   0x07        array: varint count, count * value
+*   0x08        array of integers: varint count, count * zigzag varint
+*   0x09        array of numbers: varint count, count * 8 bytes
+*   0x80 | z    integer with a zigzag encoding z that's less than 0x80
+*
+* Varints are unsigned LEB128, i.e. 7 bits per byte with the most significant bit set on all
+* bytes but the last.
+*/
+#define PACK_TAG_NULL 0x00
+#define PACK_TAG_FALSE 0x01
+#define PACK_TAG_TRUE 0x02
+#define PACK_TAG_INTEGER 0x03
+#define PACK_TAG_NUMBER 0x04
+#define PACK_TAG_STRING 0x05
+#define PACK_TAG_DICT 0x06
+#define PACK_TAG_ARRAY 0x07
+#define PACK_TAG_INTEGER_ARRAY 0x08
+#define PACK_TAG_NUMBER_ARRAY 0x09
+#define PACK_TAG_INLINE_INTEGER 0x80
+
+/**
+* Packs the node into a newly allocated buffer that's returned in `buf`, with its length in `len`.
+* The caller is responsible for freeing the buffer.
+*/
+void Node_Pack(const Node *n, char **buf, size_t *len);
+
+/**
+* Unpacks a node from a buffer created by Node_Pack. Nodes are allocated from the arena `a`, or from
+* the heap if it is NULL. Returns OBJ_OK, or OBJ_ERR if the buffer is malformed.
+*/
+int Node_Unpack(const char *buf, size_t len, NodeArena *a, Node **n);
+
+/**
+* Checks a buffer without unpacking it. Returns OBJ_OK if Node_Unpack would unpack it, or OBJ_ERR if
+* the buffer is malformed.
+*/
+int Node_UnpackCheck(const char *buf, size_t len);
+
+#endif
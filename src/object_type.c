@@ -23,7 +23,7 @@
 
 #define Vector_Last(v) Vector_Size(v) - 1
 
-void *ObjectTypeRdbLoad(RedisModuleIO *rdb) {
+void *ObjectTypeRdbLoad(RedisModuleIO *rdb, NodeArena *arena) {
     // IMPORTANT: no encoding version check here, this is up to the calller
     Vector *nodes;
     Vector *indices;
@@ -50,37 +50,40 @@ void *ObjectTypeRdbLoad(RedisModuleIO *rdb) {
                         break;
                     case N_BOOLEAN:
                         str = RedisModule_LoadStringBuffer(rdb, &strlen);
-                        node = NewBoolNode('1' == str[0]);
+                        node = NewBoolNodeEx(arena, '1' == str[0]);
+                        free(str);
                         state = S_END_VALUE;
                         break;
                     case N_INTEGER:
-                        node = NewIntNode(RedisModule_LoadSigned(rdb));
+                        node = NewIntNodeEx(arena, RedisModule_LoadSigned(rdb));
                         state = S_END_VALUE;
                         break;
                     case N_NUMBER:
-                        node = NewDoubleNode(RedisModule_LoadDouble(rdb));
+                        node = NewDoubleNodeEx(arena, RedisModule_LoadDouble(rdb));
                         state = S_END_VALUE;
                         break;
                     case N_STRING:
                         str = RedisModule_LoadStringBuffer(rdb, &strlen);
-                        node = NewStringNode(str, strlen);
+                        node = NewStringNodeEx(arena, str, strlen);
+                        free(str);
                         state = S_END_VALUE;
                         break;
                     case N_KEYVAL:
                         str = RedisModule_LoadStringBuffer(rdb, &strlen);
-                        Vector_Push(nodes, NewKeyValNode(str, strlen, NULL));
+                        Vector_Push(nodes, NewKeyValNodeEx(arena, str, strlen, NULL));
+                        free(str);
                         Vector_Push(indices, (uint64_t)1);
                         state = S_CONTAINER;
                         break;
                     case N_DICT:
                         len = RedisModule_LoadUnsigned(rdb);
-                        Vector_Push(nodes, NewDictNode(len));
+                        Vector_Push(nodes, NewDictNodeEx(arena, len));
                         Vector_Push(indices, len);
                         state = S_CONTAINER;
                         break;
                     case N_ARRAY:
                         len = RedisModule_LoadUnsigned(rdb);
-                        Vector_Push(nodes, NewArrayNode(len));
+                        Vector_Push(nodes, NewArrayNodeEx(arena, len));
                         Vector_Push(indices, len);
                         state = S_CONTAINER;
                         break;
@@ -148,7 +151,7 @@ void _ObjectTypeSave_Begin(Node *n, void *ctx) {
                 RedisModule_SaveDouble(rdb, n->value.numval);
                 break;
             case N_STRING:
-                RedisModule_SaveStringBuffer(rdb, n->value.strval.data, n->value.strval.len);
+                RedisModule_SaveStringBuffer(rdb, NODE_STRING_DATA(n), NODE_STRING_LEN(n));
                 break;
             case N_KEYVAL:
                 RedisModule_SaveStringBuffer(rdb, n->value.kvval.key, strlen(n->value.kvval.key));
@@ -195,7 +198,7 @@ void _ObjectTypeToResp_Begin(Node *n, void *ctx) {
                 RedisModule_ReplyWithDouble(ctx, n->value.numval);
                 break;
             case N_STRING:
-                RedisModule_ReplyWithStringBuffer(ctx, n->value.strval.data, n->value.strval.len);
+                RedisModule_ReplyWithStringBuffer(ctx, NODE_STRING_DATA(n), NODE_STRING_LEN(n));
                 break;
             case N_KEYVAL:
                 RedisModule_ReplyWithArray(ctx, 2);
@@ -223,15 +226,26 @@ void ObjectTypeToRespReply(RedisModuleCtx *ctx, const Node *node) {
     Node_Serializer(node, &nso, ctx);
 }
 
+/* The memory usage context, optionally accounting only for what isn't in an arena. */
+typedef struct {
+    size_t memory;
+    int heapOnly;
+} _MemoryUsageContext;
+
 void _ObjectTypeMemoryUsage(Node *n, void *ctx) {
-    size_t *memory = (size_t *)ctx;
+    _MemoryUsageContext *muc = (_MemoryUsageContext *)ctx;
+    size_t *memory = &muc->memory;
+    int flags = muc->heapOnly && n ? n->flags : 0;
 
-    if (!n) {
-        // the null node takes no memory
+    if (!n || n->flags & NODE_F_PACKED_ITEM) {
+        // the null node takes no memory, and a packed array's items are accounted for in its values
         return;
     } else {
         // account for the struct's size
-        *memory += sizeof(Node);
+        if (!(flags & NODE_F_ARENA)) *memory += sizeof(Node);
+        if (N_STRING == n->type && n->flags & NODE_F_INLINE) return;
+        if (N_STRING == n->type && flags & NODE_F_ARENA_DATA) return;
+        if (n->type & (N_DICT | N_ARRAY) && flags & NODE_F_ARENA_ENTRIES) return;
         switch (n->type) {
             case N_BOOLEAN:
             case N_INTEGER:
@@ -240,29 +254,31 @@ void _ObjectTypeMemoryUsage(Node *n, void *ctx) {
                 // these are stored in the node itself
                 return;
             case N_STRING:
-                *memory += n->value.strval.len;
+                *memory += n->value.strval.len;  // inline strings have returned already
                 return;
             case N_KEYVAL:
-                *memory += strlen(n->value.kvval.key);
+                // interned keys are shared by all of their references
+                *memory += Key_SharedSize(n->value.kvval.key);
                 return;
             case N_DICT:
-                *memory += n->value.dictval.cap * sizeof(Node *);
-                return;
             case N_ARRAY:
-                *memory += n->value.arrval.cap * sizeof(Node *);
+                *memory += __nodeEntriesSize(n);
                 return;
         }
     }
 }
 
-size_t ObjectTypeMemoryUsage(const void *value) {
-    const Node *node = value;
+static size_t _ObjectTypeMemoryUsageEx(const Node *node, int heapOnly) {
     NodeSerializerOpt nso = {0};
-    size_t memory = 0;
+    _MemoryUsageContext muc = {.memory = 0, .heapOnly = heapOnly};
 
     nso.fBegin = _ObjectTypeMemoryUsage;
     nso.xBegin = 0xff;  // mask for all basic types
-    Node_Serializer(node, &nso, &memory);
+    Node_Serializer(node, &nso, &muc);
+
+    return muc.memory;
+}
+
+size_t ObjectTypeMemoryUsage(const void *value) { return _ObjectTypeMemoryUsageEx(value, 0); }
 
-    return memory;
-}
\ No newline at end of file
+size_t ObjectTypeHeapMemoryUsage(const void *value) { return _ObjectTypeMemoryUsageEx(value, 1); }
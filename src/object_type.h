@@ -24,7 +24,7 @@
 #include "redismodule.h"
 
 /* Custom Redis data type API. */
-void *ObjectTypeRdbLoad(RedisModuleIO *rdb);
+void *ObjectTypeRdbLoad(RedisModuleIO *rdb, NodeArena *arena);
 void ObjectTypeRdbSave(RedisModuleIO *rdb, void *value);
 void ObjectTypeFree(void *value);
 
@@ -34,4 +34,7 @@ void ObjectTypeToRespReply(RedisModuleCtx *ctx, const Node *node);
 /* Reports the memory usage (in bytes) of the node. */
 size_t ObjectTypeMemoryUsage(const void *value);
 
+/* Like ObjectTypeMemoryUsage, but ignores whatever was allocated from an arena. */
+size_t ObjectTypeHeapMemoryUsage(const void *value);
+
 #endif
\ No newline at end of file
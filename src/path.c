@@ -17,8 +17,15 @@
 
 #include "path.h"
 
-Node *__pathNode_eval(PathNode *pn, Node *n, PathError *err) {
+/* Returns 1 if the path node can match more than one node */
+#define PATHNODE_IS_MULTI(pn) (NT_WILDCARD <= (pn)->type)
+
+Node *__pathNode_eval(PathNode *pn, Node *n, Node *scratch, PathError *err) {
     *err = E_OK;
+    if (PATHNODE_IS_MULTI(pn)) {
+        *err = E_MULTI;
+        return NULL;
+    }
     if (!n) {
         goto badtype;
     }
@@ -28,10 +35,12 @@ Node *__pathNode_eval(PathNode *pn, Node *n, PathError *err) {
         if (NT_INDEX == pn->type) {
             int index = pn->value.index;
             // translate negative values
-            if (index < 0) index = n->value.arrval.len + index;            
-            int rc = Node_ArrayItem(n, index, &rn);
-            if (rc != OBJ_OK) {
+            if (index < 0) index = n->value.arrval.len + index;
+            if (index < 0 || index >= n->value.arrval.len) {
                 *err = E_NOINDEX;
+            } else {
+                // a packed array's item is copied, so looking it up doesn't unpack the array
+                rn = (Node *)Node_ArrayItemPeek(n, index, scratch);
             }
         } else {
             goto badtype;
@@ -56,11 +65,31 @@ badtype:
     return NULL;
 }
 
-PathError SearchPath_Find(SearchPath *path, Node *root, Node **n) {
+int SearchPath_HasStats(SearchPath *path, Node *root, int level) {
+    Node *n = root, scratch;
+    PathError err;
+    for (int i = 0; i < level && n; i++) {
+        if (n->type & (N_DICT | N_ARRAY) && n->flags & NODE_F_STATS) return 1;
+        n = __pathNode_eval(&path->nodes[i], n, &scratch, &err);
+    }
+    return 0;
+}
+
+void SearchPath_UpdateStats(SearchPath *path, Node *root, int level, const NodeStats *before,
+                            const NodeStats *after) {
+    Node *n = root, scratch;
+    PathError err;
+    for (int i = 0; i < level && n; i++) {
+        Node_UpdateStats(n, before, after);
+        n = __pathNode_eval(&path->nodes[i], n, &scratch, &err);
+    }
+}
+
+PathError SearchPath_Find(SearchPath *path, Node *root, Node **n, Node *scratch) {
     Node *current = root;
     PathError ret;
     for (int i = 0; i < path->len; i++) {
-        current = __pathNode_eval(&path->nodes[i], current, &ret);
+        current = __pathNode_eval(&path->nodes[i], current, scratch, &ret);
         if (ret != E_OK) {
             *n = NULL;
             return ret;
@@ -70,7 +99,8 @@ PathError SearchPath_Find(SearchPath *path, Node *root, Node **n) {
     return E_OK;
 }
 
-PathError SearchPath_FindEx(SearchPath *path, Node *root, Node **n, Node **p, int *errnode) {
+PathError SearchPath_FindEx(SearchPath *path, Node *root, Node **n, Node **p, int *errnode,
+                            Node *scratch) {
     Node *current = root;
     Node *prev = NULL;
     Node *next;
@@ -78,7 +108,7 @@ PathError SearchPath_FindEx(SearchPath *path, Node *root, Node **n, Node **p, in
 
     for (int i = 0; i < path->len; i++) {
         prev = current;
-        current = __pathNode_eval(&path->nodes[i], current, &ret);
+        current = __pathNode_eval(&path->nodes[i], current, scratch, &ret);
         if (ret != E_OK) {
             *errnode = i;
             *p = prev;
@@ -122,14 +152,410 @@ void SearchPath_AppendRoot(SearchPath *p) {
     __searchPath_append(p, pn);
 }
 
+void SearchPath_AppendWildcard(SearchPath *p) {
+    PathNode pn;
+    pn.type = NT_WILDCARD;
+    __searchPath_append(p, pn);
+}
+
+void SearchPath_AppendDeepScan(SearchPath *p) {
+    PathNode pn;
+    pn.type = NT_DEEPSCAN;
+    __searchPath_append(p, pn);
+}
+
+void SearchPath_AppendSlice(SearchPath *p, int start, int end, int step, int flags) {
+    PathNode pn;
+    pn.type = NT_SLICE;
+    pn.value.slice.start = start;
+    pn.value.slice.end = end;
+    pn.value.slice.step = step;
+    pn.value.slice.flags = flags;
+    __searchPath_append(p, pn);
+}
+
+PathNode *SearchPath_AppendUnion(SearchPath *p) {
+    PathNode pn;
+    pn.type = NT_UNION;
+    pn.value.items.nodes = NULL;
+    pn.value.items.len = 0;
+    __searchPath_append(p, pn);
+    return &p->nodes[p->len - 1];
+}
+
+static void __pathNode_unionAppend(PathNode *pn, PathNode item) {
+    pn->value.items.nodes =
+        realloc(pn->value.items.nodes, (pn->value.items.len + 1) * sizeof(PathNode));
+    pn->value.items.nodes[pn->value.items.len++] = item;
+}
+
+void PathNode_UnionAppendIndex(PathNode *pn, int idx) {
+    PathNode item;
+    item.type = NT_INDEX;
+    item.value.index = idx;
+    __pathNode_unionAppend(pn, item);
+}
+
+void PathNode_UnionAppendKey(PathNode *pn, const char *key, const size_t len) {
+    PathNode item;
+    item.type = NT_KEY;
+    item.value.key = strndup(key, len);
+    __pathNode_unionAppend(pn, item);
+}
+
+void SearchPath_AppendFilter(SearchPath *p, PathFilter *f) {
+    PathNode pn;
+    pn.type = NT_FILTER;
+    pn.value.filter = f;
+    __searchPath_append(p, pn);
+}
+
+int SearchPath_IsMulti(const SearchPath *p) {
+    for (size_t i = 0; i < p->len; i++) {
+        if (PATHNODE_IS_MULTI(&p->nodes[i])) return 1;
+    }
+    return 0;
+}
+
+static void __pathNode_free(PathNode *pn) {
+    if (NT_KEY == pn->type) {
+        free((char *)pn->value.key);
+    } else if (NT_UNION == pn->type) {
+        for (int i = 0; i < pn->value.items.len; i++) __pathNode_free(&pn->value.items.nodes[i]);
+        free(pn->value.items.nodes);
+    } else if (NT_FILTER == pn->type) {
+        PathFilter_Free(pn->value.filter);
+    }
+}
+
 void SearchPath_Free(SearchPath *p) {
     if (p->nodes) {
         for (int i = 0; i < p->len; i++) {
-            if (p->nodes[i].type == NT_KEY) {
-                free((char *)p->nodes[i].value.key);
-            }
+            __pathNode_free(&p->nodes[i]);
         }
     }
 
     free(p->nodes);
 }
+
+PathFilter *NewPathFilter() { return calloc(1, sizeof(PathFilter)); }
+
+int PathFilter_Emit(PathFilter *f, PathFilterOp op, int arg) {
+    f->code = realloc(f->code, (f->len + 1) * sizeof(PathFilterInstr));
+    f->code[f->len] = (PathFilterInstr){op, arg};
+
+    // keep track of the stack's depth: comparisons pop two values and push one, and the jumps pop
+    // the value when they don't jump
+    if (FOP_CONST == op || FOP_PATH == op) {
+        f->sp++;
+    } else if (FOP_NOT != op) {
+        f->sp--;
+    }
+    f->depth = MAX(f->depth, f->sp);
+    return f->len++;
+}
+
+int PathFilter_AddConst(PathFilter *f, Node *n) {
+    f->consts = realloc(f->consts, (f->nconsts + 1) * sizeof(Node *));
+    f->consts[f->nconsts] = n;
+    return f->nconsts++;
+}
+
+int PathFilter_AddPath(PathFilter *f, SearchPath p) {
+    f->paths = realloc(f->paths, (f->npaths + 1) * sizeof(SearchPath));
+    f->paths[f->npaths] = p;
+    return f->npaths++;
+}
+
+void PathFilter_Free(PathFilter *f) {
+    if (!f) return;
+    for (int i = 0; i < f->nconsts; i++) Node_Free(f->consts[i]);
+    for (int i = 0; i < f->npaths; i++) SearchPath_Free(&f->paths[i]);
+    free(f->consts);
+    free(f->paths);
+    free(f->code);
+    free(f);
+}
+
+// the value of a relative path that doesn't lead anywhere, and the results of comparisons
+static const Node __filterMissing;
+static const Node __filterFalse = {.value = {.boolval = 0}, .type = N_BOOLEAN};
+static const Node __filterTrue = {.value = {.boolval = 1}, .type = N_BOOLEAN};
+
+static inline int __pathFilter_isTrue(const Node *n) {
+    return n && &__filterMissing != n && !(N_BOOLEAN == n->type && !n->value.boolval);
+}
+
+/* Returns the value at a relative path of n. A packed array's item is copied to scratch, so the
+ * array isn't unpacked. */
+static const Node *__pathFilter_lookup(SearchPath *p, const Node *n, Node *scratch) {
+    for (size_t i = 0; i < p->len; i++) {
+        PathNode *pn = &p->nodes[i];
+        if (NT_ROOT == pn->type) continue;
+        if (NT_KEY == pn->type && n && N_DICT == n->type) {
+            Node *val;
+            if (OBJ_OK != Node_DictGet((Node *)n, pn->value.key, &val)) return &__filterMissing;
+            n = val;
+        } else if (NT_INDEX == pn->type && n && N_ARRAY == n->type) {
+            int index = pn->value.index;
+            if (index < 0) index = n->value.arrval.len + index;
+            if (index < 0 || index >= n->value.arrval.len) return &__filterMissing;
+            n = Node_ArrayItemPeek(n, index, scratch);
+        } else {
+            return &__filterMissing;
+        }
+    }
+    return n;
+}
+
+/* Returns the result of a comparison, see PathFilter. */
+static int __pathFilter_compare(const Node *a, const Node *b, PathFilterOp op) {
+    int cmp = 0, ordered = 0, eq = 0;
+    if (&__filterMissing == a || &__filterMissing == b) {
+        eq = 0;
+    } else if (!a || !b) {
+        eq = !a && !b;
+    } else if (a->type & (N_INTEGER | N_NUMBER) && b->type & (N_INTEGER | N_NUMBER)) {
+        ordered = 1;
+        if (N_INTEGER == a->type && N_INTEGER == b->type) {
+            cmp = (a->value.intval > b->value.intval) - (a->value.intval < b->value.intval);
+        } else {
+            double x = N_INTEGER == a->type ? (double)a->value.intval : a->value.numval;
+            double y = N_INTEGER == b->type ? (double)b->value.intval : b->value.numval;
+            cmp = (x > y) - (x < y);
+        }
+    } else if (N_STRING == a->type && N_STRING == b->type) {
+        ordered = 1;
+        uint32_t alen = NODE_STRING_LEN(a), blen = NODE_STRING_LEN(b);
+        cmp = memcmp(NODE_STRING_DATA(a), NODE_STRING_DATA(b), MIN(alen, blen));
+        if (!cmp) cmp = (alen > blen) - (alen < blen);
+    } else if (N_BOOLEAN == a->type && N_BOOLEAN == b->type) {
+        eq = a->value.boolval == b->value.boolval;
+    }
+    if (ordered) eq = !cmp;
+
+    switch (op) {
+        case FOP_EQ:
+            return eq;
+        case FOP_NE:
+            return !eq;
+        case FOP_LT:
+            return ordered && cmp < 0;
+        case FOP_LE:
+            return ordered && cmp <= 0;
+        case FOP_GT:
+            return ordered && cmp > 0;
+        case FOP_GE:
+            return ordered && cmp >= 0;
+        default:
+            return 0;
+    }
+}
+
+int PathFilter_Match(PathFilter *f, const Node *n) {
+    struct {
+        const Node *n;
+        Node scratch;  // for the copy of a packed array's item
+    } stack[PATH_FILTER_MAX_DEPTH];
+    int sp = 0;
+
+    for (int pc = 0; pc < f->len; pc++) {
+        PathFilterInstr *in = &f->code[pc];
+        switch (in->op) {
+            case FOP_CONST:
+                stack[sp++].n = f->consts[in->arg];
+                break;
+            case FOP_PATH:
+                stack[sp].n = __pathFilter_lookup(&f->paths[in->arg], n, &stack[sp].scratch);
+                sp++;
+                break;
+            case FOP_NOT:
+                stack[sp - 1].n = __pathFilter_isTrue(stack[sp - 1].n) ? &__filterFalse
+                                                                       : &__filterTrue;
+                break;
+            case FOP_AND:
+            case FOP_OR:
+                // the jump skips the rest of the operator's operands
+                if (__pathFilter_isTrue(stack[sp - 1].n) == (FOP_OR == in->op)) {
+                    pc = in->arg - 1;
+                } else {
+                    sp--;
+                }
+                break;
+            default:
+                sp--;
+                stack[sp - 1].n = __pathFilter_compare(stack[sp - 1].n, stack[sp].n, in->op)
+                                      ? &__filterTrue
+                                      : &__filterFalse;
+                break;
+        }
+    }
+    return sp && __pathFilter_isTrue(stack[sp - 1].n);
+}
+
+typedef struct {
+    SearchPath *path;
+    SearchPathCallback cb;
+    void *ctx;
+    size_t count;
+    SearchPathMatch m;  // the node's ancestors, and where it is in its parent
+    int cap;            // of the ancestors
+} _FindAllContext;
+
+static int __searchPath_findAll(_FindAllContext *c, int level, Node *n);
+static int __searchPath_deepScan(_FindAllContext *c, int level, Node *n);
+
+/* Continues the search from the container's child, which is at `key` or at `index`, and from all
+ * of its descendants too if `deep` is set. Returns 1 if the search stopped. */
+static int __searchPath_child(_FindAllContext *c, int level, Node *n, Node *child, const char *key,
+                              int index, int deep) {
+    if (c->m.depth == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 8;
+        c->m.ancestors = realloc(c->m.ancestors, c->cap * sizeof(Node *));
+    }
+    c->m.ancestors[c->m.depth++] = n;
+
+    c->m.key = key;
+    c->m.index = index;
+    int ret = __searchPath_findAll(c, level, child);
+    if (!ret && deep) ret = __searchPath_deepScan(c, level, child);
+
+    c->m.depth--;
+    return ret;
+}
+
+/* Like __searchPath_child for the dictionary's entry at i. */
+static inline int __searchPath_entry(_FindAllContext *c, int level, Node *n, uint32_t i, int deep) {
+    t_keyval *kv = &n->value.dictval.entries[i]->value.kvval;
+    return __searchPath_child(c, level, n, kv->val, kv->key, -1, deep);
+}
+
+/* Like __searchPath_child for the array's item at i, which is peeked at so a packed array isn't
+ * unpacked. */
+static inline int __searchPath_item(_FindAllContext *c, int level, Node *n, uint32_t i, int deep) {
+    Node scratch;
+    Node *item = (Node *)Node_ArrayItemPeek(n, i, &scratch);
+    return __searchPath_child(c, level, n, item, NULL, (int)i, deep);
+}
+
+/* Applies the path from `level` on to every descendant of n. Returns 1 if the search stopped. */
+static int __searchPath_deepScan(_FindAllContext *c, int level, Node *n) {
+    if (!n) return 0;
+    if (N_DICT == n->type) {
+        for (uint32_t i = 0; i < n->value.dictval.len; i++) {
+            if (__searchPath_entry(c, level, n, i, 1)) return 1;
+        }
+    } else if (N_ARRAY == n->type && !NODE_IS_PACKED_ARRAY(n)) {
+        // a packed array's items are numbers, which have no descendants
+        for (uint32_t i = 0; i < n->value.arrval.len; i++) {
+            if (__searchPath_item(c, level, n, i, 1)) return 1;
+        }
+    }
+    return 0;
+}
+
+/* Applies a key or an index path node to n. Returns 1 if the search stopped. */
+static int __searchPath_lookup(_FindAllContext *c, int level, Node *n, PathNode *pn) {
+    if (NT_KEY == pn->type) {
+        Node *val;
+        if (N_DICT != n->type || OBJ_OK != Node_DictGet(n, pn->value.key, &val)) return 0;
+        return __searchPath_child(c, level, n, val, pn->value.key, -1, 0);
+    }
+
+    if (N_ARRAY != n->type) return 0;
+    int index = pn->value.index;
+    if (index < 0) index = n->value.arrval.len + index;
+    if (index < 0 || index >= n->value.arrval.len) return 0;
+    return __searchPath_item(c, level, n, index, 0);
+}
+
+/* Applies a slice path node to the array n. Returns 1 if the search stopped. */
+static int __searchPath_slice(_FindAllContext *c, int level, Node *n, PathNode *pn) {
+    int len = (int)n->value.arrval.len;
+    int step = pn->value.slice.step;
+    int start = pn->value.slice.start, end = pn->value.slice.end;
+
+    // bounds that weren't given cover the whole array in the step's direction
+    if (!(pn->value.slice.flags & PATH_SLICE_START)) start = step > 0 ? 0 : len - 1;
+    if (!(pn->value.slice.flags & PATH_SLICE_END)) end = step > 0 ? len : -len - 1;
+    if (start < 0) start += len;
+    if (end < 0) end += len;
+
+    if (step > 0) {
+        start = MAX(start, 0);
+        end = MIN(end, len);
+        for (long long i = start; i < end; i += step) {
+            if (__searchPath_item(c, level, n, i, 0)) return 1;
+        }
+    } else {
+        start = MIN(start, len - 1);
+        end = MAX(end, -1);
+        for (long long i = start; i > end; i += step) {
+            if (__searchPath_item(c, level, n, i, 0)) return 1;
+        }
+    }
+    return 0;
+}
+
+/* Applies the path from `level` on to the container n's values, or only to those for which the
+ * filter is true if there is one. Returns 1 if the search stopped. */
+static int __searchPath_values(_FindAllContext *c, int level, Node *n, PathFilter *f) {
+    if (N_DICT == n->type) {
+        for (uint32_t i = 0; i < n->value.dictval.len; i++) {
+            if (f && !PathFilter_Match(f, n->value.dictval.entries[i]->value.kvval.val)) continue;
+            if (__searchPath_entry(c, level, n, i, 0)) return 1;
+        }
+    } else {
+        for (uint32_t i = 0; i < n->value.arrval.len; i++) {
+            Node scratch;
+            if (f && !PathFilter_Match(f, Node_ArrayItemPeek(n, i, &scratch))) continue;
+            if (__searchPath_item(c, level, n, i, 0)) return 1;
+        }
+    }
+    return 0;
+}
+
+/* Applies the path from `level` on to n, which matched the path up to it. Returns 1 if the search
+ * stopped. */
+static int __searchPath_findAll(_FindAllContext *c, int level, Node *n) {
+    if (level == c->path->len) {
+        c->m.n = n;
+        c->count++;
+        return c->cb(&c->m, c->ctx) ? 1 : 0;
+    }
+
+    PathNode *pn = &c->path->nodes[level];
+    if (NT_ROOT == pn->type) return __searchPath_findAll(c, level + 1, n);
+    if (NT_DEEPSCAN == pn->type) {
+        return __searchPath_findAll(c, level + 1, n) || __searchPath_deepScan(c, level + 1, n);
+    }
+
+    // the other nodes select children
+    if (!n || !(n->type & (N_DICT | N_ARRAY))) return 0;
+    switch (pn->type) {
+        case NT_KEY:
+        case NT_INDEX:
+            return __searchPath_lookup(c, level + 1, n, pn);
+        case NT_UNION:
+            for (int i = 0; i < pn->value.items.len; i++) {
+                if (__searchPath_lookup(c, level + 1, n, &pn->value.items.nodes[i])) return 1;
+            }
+            return 0;
+        case NT_SLICE:
+            return N_ARRAY == n->type ? __searchPath_slice(c, level + 1, n, pn) : 0;
+        case NT_WILDCARD:
+            return __searchPath_values(c, level + 1, n, NULL);
+        case NT_FILTER:
+            return __searchPath_values(c, level + 1, n, pn->value.filter);
+        default:
+            return 0;
+    }
+}
+
+size_t SearchPath_FindAll(SearchPath *path, Node *root, SearchPathCallback cb, void *ctx) {
+    _FindAllContext c = {.path = path, .cb = cb, .ctx = ctx, .count = 0};
+    c.m.index = -1;
+    __searchPath_findAll(&c, 0, root);
+    free(c.m.ancestors);
+    return c.count;
+}
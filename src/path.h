@@ -31,6 +31,11 @@ typedef enum {
     NT_ROOT,
     NT_KEY,
     NT_INDEX,
+    NT_WILDCARD,  // all of a container's values
+    NT_DEEPSCAN,  // the node and all of its descendants, to which the rest of the path is applied
+    NT_SLICE,     // a range of an array's items
+    NT_UNION,     // a set of keys and indices
+    NT_FILTER,    // the container's values for which a filter expression is true
 } PathNodeType;
 
 /* Error codes returned from path lookups */
@@ -45,19 +50,45 @@ typedef enum {
 
     // the path predicate does not match the node type
     E_BADTYPE,
+
+    // the path node can match more than one node, which requires SearchPath_FindAll
+    E_MULTI,
 } PathError;
 
+/* Flags of a slice's bounds that were given, the others default to the whole array */
+#define PATH_SLICE_START 0x1
+#define PATH_SLICE_END 0x2
+
+struct pathFilter;
+
 /* A single lookup node in a lookup path. A lookup path is just a list of nodes */
-typedef struct {
+typedef struct pathNode {
     PathNodeType type;
     union {
         int index;
         const char *key;
+        // the items from start (inclusive) to end (exclusive), every step, as in Python's slices
+        struct {
+            int start;
+            int end;
+            int step;
+            int flags;
+        } slice;
+        // the union's keys and indices
+        struct {
+            struct pathNode *nodes;
+            int len;
+        } items;
+        // the filter's compiled expression
+        struct pathFilter *filter;
     } value;
 } PathNode;
 
-/** Evaluate a single path node against an object node */
-Node *__pathNode_eval(PathNode *pn, Node *n, PathError *err);
+/**
+* Evaluate a single path node against an object node. A packed array's item is copied to `scratch`
+* (see Node_ArrayItemPeek), which is returned.
+*/
+Node *__pathNode_eval(PathNode *pn, Node *n, Node *scratch, PathError *err);
 
 /**
 * A search path parsed from JSON or other formats, representing
@@ -81,22 +112,150 @@ void SearchPath_AppendKey(SearchPath *p, const char *key, const size_t len);
 /* Appends a root node to the search path (makes sense only as the first append)  */
 void SearchPath_AppendRoot(SearchPath *p);
 
+/* Append a wildcard node, which selects all of a dictionary's values or an array's items */
+void SearchPath_AppendWildcard(SearchPath *p);
+
+/* Append a deep scan node, which selects the node and all of its descendants */
+void SearchPath_AppendDeepScan(SearchPath *p);
+
+/* Append an array slice node. `flags` tells which of start and end were given (see PATH_SLICE_START
+ * and PATH_SLICE_END), and step must not be 0 */
+void SearchPath_AppendSlice(SearchPath *p, int start, int end, int step, int flags);
+
+/* Append a union node of the keys and indices that are appended to it, and return it */
+PathNode *SearchPath_AppendUnion(SearchPath *p);
+
+/* Append an array index to a union node */
+void PathNode_UnionAppendIndex(PathNode *pn, int idx);
+
+/* Append a string key to a union node */
+void PathNode_UnionAppendKey(PathNode *pn, const char *key, const size_t len);
+
+/* Append a filter node, which takes ownership of the compiled filter */
+void SearchPath_AppendFilter(SearchPath *p, struct pathFilter *f);
+
+/* Returns 1 if the path has nodes that can match more than one node, 0 otherwise */
+int SearchPath_IsMulti(const SearchPath *p);
+
 /* Free a search path and all its nodes */
 void SearchPath_Free(SearchPath *p);
 
-// Node *__pathNode_eval(PathNode *pn, Node *n, PathError *err);
+// Node *__pathNode_eval(PathNode *pn, Node *n, Node *scratch, PathError *err);
+
+/* The instructions of a filter's program, which runs on a stack of values */
+typedef enum {
+    FOP_CONST,  // push the constant at arg
+    FOP_PATH,   // push the value at the relative path arg of the filtered value, or a missing one
+    FOP_EQ,     // replace the two values on top with the result of comparing them
+    FOP_NE,
+    FOP_LT,
+    FOP_LE,
+    FOP_GT,
+    FOP_GE,
+    FOP_NOT,  // replace the value on top with its negation
+    FOP_AND,  // jump to arg if the value on top is false, and pop it otherwise
+    FOP_OR,   // jump to arg if the value on top is true, and pop it otherwise
+} PathFilterOp;
+
+typedef struct {
+    PathFilterOp op;
+    int arg;
+} PathFilterInstr;
+
+/* The deepest that a filter's stack of values may get */
+#define PATH_FILTER_MAX_DEPTH 32
+
+/**
+* A filter expression that's compiled once to a program for a small stack machine, which runs for
+* each of the values that it filters. The program's values are its constants and the values at paths
+* relative to the filtered value (`@`), or are missing if it has none at a path.
+*
+* Numbers are compared numerically and strings lexicographically. Values of other types are only
+* equal to values of their own type, and objects and arrays aren't equal to anything. Comparisons
+* with a missing value are false, except for `!=`. A value is true unless it is missing, null or
+* false, so a path alone tests for the value's existence.
+*/
+typedef struct pathFilter {
+    PathFilterInstr *code;
+    int len;
+    Node **consts;       // the literals
+    int nconsts;
+    SearchPath *paths;   // the relative paths, which only have keys and indices
+    int npaths;
+    int depth;           // the stack depth that the program reaches
+    int sp;              // while it's emitted
+} PathFilter;
+
+PathFilter *NewPathFilter();
+
+/* Emits an instruction and returns its position, so a jump's target can be set once it's known */
+int PathFilter_Emit(PathFilter *f, PathFilterOp op, int arg);
+
+/* Adds a constant, which the filter takes ownership of, and returns its index */
+int PathFilter_AddConst(PathFilter *f, Node *n);
+
+/* Adds a relative path, which the filter takes ownership of, and returns its index */
+int PathFilter_AddPath(PathFilter *f, SearchPath p);
+
+/* Returns 1 if the filter's expression is true for the value n */
+int PathFilter_Match(PathFilter *f, const Node *n);
+
+void PathFilter_Free(PathFilter *f);
 
 /**
 * Find a node in an object tree based on a parsed path.
 * An error code is returned, and if a node matches the path, its value
 * is put into n's pointer. This can be NULL if the lookup matches a NULL node.
+* A packed array's item isn't unpacked, it is copied to `scratch` and n points to the copy, which
+* Node_Free ignores. Replacing it with Node_ArraySet is what changes the array.
 */
-PathError SearchPath_Find(SearchPath *path, Node *root, Node **n);
+PathError SearchPath_Find(SearchPath *path, Node *root, Node **n, Node *scratch);
 
 /**
 * Like SearchPath_Find, but sets p to the parent container of n. In case of E_NOKEY, E_NOINDEX,
 * and E_INFINDEX returns the path level of the error in errnode.
 */
-PathError SearchPath_FindEx(SearchPath *path, Node *root, Node **n, Node **p, int *errnode);
+PathError SearchPath_FindEx(SearchPath *path, Node *root, Node **n, Node **p, int *errnode,
+                            Node *scratch);
+
+/**
+* A node that a path matches, and where it is. A packed array's items are passed as transient copies
+* (see NODE_F_PACKED_ITEM), and like the ancestors they are valid only during the callback.
+*/
+typedef struct {
+    Node *n;           // the node
+    Node **ancestors;  // the containers above it, from the root down to its parent
+    int depth;         // the number of ancestors
+    const char *key;   // its key if its parent is a dictionary
+    int index;         // or its index if its parent is an array, and -1 otherwise
+} SearchPathMatch;
+
+/**
+* Called by SearchPath_FindAll for every node that the path matches. The tree must not be changed
+* during the call. Returning a non-zero value stops the search.
+*/
+typedef int (*SearchPathCallback)(const SearchPathMatch *m, void *ctx);
+
+/**
+* Find all the nodes in an object tree that a path, which may have wildcard, deep scan, slice, union
+* and filter nodes, matches. The callback is called for each in document order, and mismatching
+* branches of the tree are skipped rather than reported as errors.
+* Returns the number of nodes that were passed to the callback.
+*/
+size_t SearchPath_FindAll(SearchPath *path, Node *root, SearchPathCallback cb, void *ctx);
+
+/**
+* Returns 1 if any of the containers above the node at `level` of the path (the root being at level
+* 0) has cached statistics, in which case changes to the node have to be reported to them with
+* SearchPath_UpdateStats.
+*/
+int SearchPath_HasStats(SearchPath *path, Node *root, int level);
+
+/**
+* Applies the change of the node at `level` of the path, from the `before` statistics to `after`, to
+* the cached statistics of the containers above it. See Node_GetStats.
+*/
+void SearchPath_UpdateStats(SearchPath *path, Node *root, int level, const NodeStats *before,
+                            const NodeStats *after);
 
 #endif
\ No newline at end of file
@@ -49,19 +49,122 @@ static inline int SearchPath_IsRootPath(const SearchPath *sp) {
     return (1 == sp->len && NT_ROOT == sp->nodes[0].type);
 }
 
-/* Stores everything about a resolved path. */
+/* A parsed path that's shared by the path cache and the commands that use it. */
 typedef struct {
-    const char *spath;  // the path's string
-    size_t spathlen;    // the path's string length
-    Node *n;            // the referenced node
-    Node *p;            // its parent
     SearchPath sp;      // the search path
-    PathError err;      // set in case of path error
-    int errlevel;       // indicates the level of the error in the path
+    uint32_t refcount;  // the number of references, including the cache's
+} SharedPath;
+
+/* The cache of parsed paths, keyed by the path's string. */
+static LRUCache *pathCache = NULL;
+
+/* Releases a reference to a shared path, freeing it when it's no longer referenced. */
+static void SharedPath_Release(void *value) {
+    SharedPath *p = value;
+    if (!--p->refcount) {
+        SearchPath_Free(&p->sp);
+        free(p);
+    }
+}
+
+static size_t PathFilter_Size(const PathFilter *f);
+
+/* Returns the size of what path nodes own: their keys, unions' items and filters. */
+static size_t PathNodes_Size(const PathNode *nodes, size_t len) {
+    size_t size = 0;
+    for (size_t i = 0; i < len; i++) {
+        const PathNode *pn = &nodes[i];
+        if (NT_KEY == pn->type) {
+            size += strlen(pn->value.key) + 1;
+        } else if (NT_UNION == pn->type) {
+            size += pn->value.items.len * sizeof(PathNode) +
+                    PathNodes_Size(pn->value.items.nodes, pn->value.items.len);
+        } else if (NT_FILTER == pn->type) {
+            size += PathFilter_Size(pn->value.filter);
+        }
+    }
+    return size;
+}
+
+/* Returns the size of a filter's program, with its constants and relative paths. */
+static size_t PathFilter_Size(const PathFilter *f) {
+    NodeStats stats;
+    size_t size = sizeof(*f) + f->len * sizeof(PathFilterInstr) + f->nconsts * sizeof(Node *) +
+                  f->npaths * sizeof(SearchPath);
+    for (int i = 0; i < f->nconsts; i++) {
+        Node_GetStats(f->consts[i], &stats);
+        size += stats.memory + stats.keys;
+    }
+    for (int i = 0; i < f->npaths; i++) {
+        size += f->paths[i].cap * sizeof(PathNode) +
+                PathNodes_Size(f->paths[i].nodes, f->paths[i].len);
+    }
+    return size;
+}
+
+/* Returns the size of a shared path, for the cache's accounting. */
+static size_t SharedPath_Size(const SharedPath *p) {
+    return sizeof(*p) + p->sp.cap * sizeof(PathNode) + PathNodes_Size(p->sp.nodes, p->sp.len);
+}
+
+/* Returns a reference to the parsed path, or NULL if it can't be parsed. Paths that were recently
+ * used are found in the cache and aren't parsed again. The reference is released with
+ * SharedPath_Release.
+ */
+static SharedPath *SharedPath_Get(const char *spath, size_t len) {
+    SharedPath *p = pathCache ? LRUCache_Get(pathCache, spath, len) : NULL;
+    if (p) {
+        p->refcount++;
+        return p;
+    }
+
+    p = malloc(sizeof(*p));
+    p->sp = NewSearchPath(0);
+    p->refcount = 1;
+    if (PARSE_ERR == ParseJSONPath(spath, len, &p->sp)) {
+        SharedPath_Release(p);
+        return NULL;
+    }
+
+    // the cache keeps its own reference, as a later lookup may evict it while it is still in use
+    if (pathCache) {
+        p->refcount++;
+        LRUCache_Put(pathCache, spath, len, p, SharedPath_Size(p));
+    }
+    return p;
+}
+
+/* Stores everything about a resolved path. */
+typedef struct {
+    const char *spath;   // the path's string
+    size_t spathlen;     // the path's string length
+    Node *n;             // the referenced node
+    Node *p;             // its parent
+    Node item;           // a copy of n when it is a packed array's item
+    SearchPath *sp;      // the search path
+    SharedPath *shared;  // the reference that holds the search path
+    PathError err;       // set in case of path error
+    int errlevel;        // indicates the level of the error in the path
+    Node *w;             // the node that a write changes
+    int wlevel;          // its level in the path, or -1 if it needn't be tracked
+    NodeStats wstats;    // and its statistics before the write
 } JSONPathNode_t;
 
+/* Parses the path's string into the struct's search path. Returns PARSE_OK if parsing successful */
+static int JSONPathNode_Parse(JSONPathNode_t *jpn, const char *spath, size_t len) {
+    jpn->spath = spath;
+    jpn->spathlen = len;
+    jpn->shared = SharedPath_Get(spath, len);
+    jpn->sp = jpn->shared ? &jpn->shared->sp : NULL;
+    return jpn->shared ? PARSE_OK : PARSE_ERR;
+}
+
 /* Call this to free the struct's contents. */
-void JSONPathNode_Free(JSONPathNode_t *jpn) { SearchPath_Free(&jpn->sp); }
+void JSONPathNode_Free(JSONPathNode_t *jpn) {
+    if (jpn->shared) SharedPath_Release(jpn->shared);
+    jpn->shared = NULL;
+    jpn->sp = NULL;
+}
 
 /* Sets n to the target node by path.
  * p is n's parent, errors are set into err and level is the error's depth
@@ -73,19 +176,17 @@ int NodeFromJSONPath(Node *root, const RedisModuleString *path, JSONPathNode_t *
     jpn->p = NULL;
     jpn->err = E_OK;
     jpn->errlevel = -1;
+    jpn->wlevel = -1;
 
     // path must be valid from the root or it's an error
-    jpn->sp = NewSearchPath(0);
-    jpn->spath = RedisModule_StringPtrLen(path, &jpn->spathlen);
-    if (PARSE_ERR == ParseJSONPath(jpn->spath, jpn->spathlen, &jpn->sp)) {
-        SearchPath_Free(&jpn->sp);
-        jpn->sp.nodes = NULL;   // in case someone tries to free it later
-        return PARSE_ERR;
-    }
+    size_t spathlen;
+    const char *spath = RedisModule_StringPtrLen(path, &spathlen);
+    if (PARSE_ERR == JSONPathNode_Parse(jpn, spath, spathlen)) return PARSE_ERR;
 
     // if there are any errors return them
-    if (!SearchPath_IsRootPath(&jpn->sp)) {
-        jpn->err = SearchPath_FindEx(&jpn->sp, root, &jpn->n, &jpn->p, &jpn->errlevel);
+    if (!SearchPath_IsRootPath(jpn->sp)) {
+        jpn->err = SearchPath_FindEx(jpn->sp, root, &jpn->n, &jpn->p, &jpn->errlevel,
+                                     &jpn->item);
     } else {
         // deal with edge case of setting root's parent
         jpn->n = root;
@@ -94,6 +195,267 @@ int NodeFromJSONPath(Node *root, const RedisModuleString *path, JSONPathNode_t *
     return PARSE_OK;
 }
 
+/* Prepares for a write that changes the target node, or its parent container if `parent` is set, by
+ * taking the node's statistics when any of the containers above it keep theirs.
+ */
+static void JSONPathNode_BeginWrite(JSONPathNode_t *jpn, Node *root, int parent) {
+    int level = SearchPath_IsRootPath(jpn->sp) ? 0 : (int)jpn->sp->len - (parent ? 1 : 0);
+    jpn->w = parent ? jpn->p : jpn->n;
+    jpn->wlevel = -1;
+    if (!SearchPath_HasStats(jpn->sp, root, level)) return;
+
+    jpn->wlevel = level;
+    Node_GetStats(jpn->w, &jpn->wstats);
+}
+
+/* Updates the statistics of the containers above the node that was changed by a write. */
+static void JSONPathNode_EndWrite(JSONPathNode_t *jpn, Node *root) {
+    NodeStats after;
+    if (jpn->wlevel < 0) return;
+
+    Node_GetStats(jpn->w, &after);
+    SearchPath_UpdateStats(jpn->sp, root, jpn->wlevel, &jpn->wstats, &after);
+    jpn->wlevel = -1;
+}
+
+/* Where a node that a path matches is in the document, see SearchPathMatch. */
+typedef struct {
+    Node *n;            // the node, or a copy of a packed array's item
+    Node *p;            // its parent, or NULL for the root
+    const char *key;    // its key in its parent dictionary
+    int index;          // or its index in its parent array
+    int depth;          // the number of its ancestors
+    size_t ancestors;   // and their offset in the matches' ancestors
+} JSONPathMatch_t;
+/* The nodes that a path with wildcards, deep scans, slices, unions or filters matches, see
+ * SearchPath_FindAll. */
+typedef struct {
+    Node *nodes;             // an array that references the matching nodes
+    Node *copies;            // the copies of packed arrays' items that it references
+    JSONPathMatch_t *where;  // where each of the nodes is, if requested
+    Node **ancestors;        // the matches' ancestors, which are shared by consecutive siblings
+    size_t nancestors;
+    size_t cap;              // of where and ancestors
+    size_t limit;            // the search stops once it has this many matches, unless it's 0
+} JSONPathMatches_t;
+
+/* Records where a match is, sharing the ancestors of the previous match if they are the same. */
+static void JSONPathMatches_AddWhere(JSONPathMatches_t *m, Node *n, const SearchPathMatch *sm) {
+    size_t i = Node_Length(m->nodes) - 1;
+    if (i == m->cap) {
+        m->cap = m->cap ? m->cap * 2 : 8;
+        m->where = realloc(m->where, m->cap * sizeof(JSONPathMatch_t));
+    }
+
+    JSONPathMatch_t *w = &m->where[i], *prev = i ? &m->where[i - 1] : NULL;
+    *w = (JSONPathMatch_t){.n = n, .key = sm->key, .index = sm->index, .depth = sm->depth};
+    w->p = sm->depth ? sm->ancestors[sm->depth - 1] : NULL;
+    if (prev && prev->depth == w->depth &&
+        !memcmp(&m->ancestors[prev->ancestors], sm->ancestors, w->depth * sizeof(Node *))) {
+        w->ancestors = prev->ancestors;
+        return;
+    }
+    w->ancestors = m->nancestors;
+    m->nancestors += w->depth;
+    m->ancestors = realloc(m->ancestors, MAX(m->nancestors, 1) * sizeof(Node *));
+    memcpy(&m->ancestors[w->ancestors], sm->ancestors, w->depth * sizeof(Node *));
+}
+
+static int JSONPathMatches_Add(const SearchPathMatch *sm, void *ctx) {
+    JSONPathMatches_t *m = ctx;
+    // a packed array's item is transient, so it's copied
+    Node *n = sm->n;
+    if (n && n->flags & NODE_F_PACKED_ITEM) {
+        n = N_INTEGER == n->type ? NewIntNode(n->value.intval) : NewDoubleNode(n->value.numval);
+        Node_ArrayAppend(m->copies, n);
+    }
+    Node_ArrayAppend(m->nodes, n);
+    if (m->where) JSONPathMatches_AddWhere(m, n, sm);
+    return m->limit && Node_Length(m->nodes) >= m->limit;
+}
+
+/* Sets the resolved path's node to an array of all the nodes that the path matches in the document,
+ * or of the first `limit` of them if it isn't 0, and records where each of them is if `where` is
+ * set. The matches are freed with JSONPathMatches_Free.
+ */
+static void JSONPathNode_FindAll(JSONPathNode_t *jpn, Node *root, JSONPathMatches_t *m, int where,
+                                 size_t limit) {
+    *m = (JSONPathMatches_t){.nodes = NewArrayNode(1), .copies = NewArrayNode(1), .limit = limit};
+    if (where) {
+        m->cap = 8;
+        m->where = malloc(m->cap * sizeof(JSONPathMatch_t));
+    }
+    SearchPath_FindAll(jpn->sp, root, JSONPathMatches_Add, m);
+    jpn->n = m->nodes;
+    jpn->p = NULL;
+    jpn->err = E_OK;
+}
+
+/* Returns the ancestors of a match. */
+static inline Node **JSONPathMatches_Ancestors(const JSONPathMatches_t *m,
+                                               const JSONPathMatch_t *w) {
+    return &m->ancestors[w->ancestors];
+}
+
+/* Frees the matches, leaving the nodes they reference in their document. */
+static void JSONPathMatches_Free(JSONPathMatches_t *m) {
+    if (!m->nodes) return;
+    m->nodes->value.arrval.len = 0;
+    Node_Free(m->nodes);
+    Node_Free(m->copies);
+    free(m->where);
+    free(m->ancestors);
+    *m = (JSONPathMatches_t){0};
+}
+
+/* Like JSONPathNode_BeginWrite, for a node that is below `depth` ancestors. Returns 1 if any of
+ * them keep statistics, which JSONPathMatches_EndWrite updates with the node's change. */
+static int JSONPathMatches_BeginWrite(Node **ancestors, int depth, Node *n, NodeStats *before) {
+    for (int i = 0; i < depth; i++) {
+        if (ancestors[i]->flags & NODE_F_STATS) {
+            Node_GetStats(n, before);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void JSONPathMatches_EndWrite(Node **ancestors, int depth, Node *n,
+                                     const NodeStats *before) {
+    NodeStats after;
+    Node_GetStats(n, &after);
+    for (int i = 0; i < depth; i++) Node_UpdateStats(ancestors[i], before, &after);
+}
+
+/* Orders matches for writing to them: the deepest first, so that a write doesn't free a node that's
+ * yet to be written, and otherwise in reverse document order. */
+static int JSONPathMatches_CompareWrites(const void *a, const void *b) {
+    const JSONPathMatch_t *wa = *(const JSONPathMatch_t **)a, *wb = *(const JSONPathMatch_t **)b;
+    if (wa->depth != wb->depth) return wb->depth - wa->depth;
+    return wa < wb ? 1 : wa > wb ? -1 : 0;
+}
+
+/* Returns the matches sorted with the comparison function, in an array to be freed. */
+static JSONPathMatch_t **JSONPathMatches_Sort(const JSONPathMatches_t *m,
+                                              int (*compar)(const void *, const void *)) {
+    size_t len = Node_Length(m->nodes);
+    JSONPathMatch_t **order = malloc(MAX(len, 1) * sizeof(JSONPathMatch_t *));
+    for (size_t i = 0; i < len; i++) order[i] = &m->where[i];
+    qsort(order, len, sizeof(JSONPathMatch_t *), compar);
+    return order;
+}
+
+/* Orders matches for deleting them: the deepest first, and then by parent, from an array's last
+ * item so that deleting it keeps the indices of the others. Repeated matches are adjacent. */
+static int JSONPathMatches_CompareDeletes(const void *a, const void *b) {
+    const JSONPathMatch_t *wa = *(const JSONPathMatch_t **)a, *wb = *(const JSONPathMatch_t **)b;
+    if (wa->depth != wb->depth) return wb->depth - wa->depth;
+    if (wa->p != wb->p) return wa->p < wb->p ? -1 : 1;
+    if (wa->index != wb->index) return wb->index - wa->index;
+    return wa->key && wb->key ? strcmp(wa->key, wb->key) : 0;
+}
+
+/* Deletes all the values that a path matches from the document, and returns their number. The items
+ * of an array that are next to each other are deleted as a range. */
+static long long JSONPathNode_DelAll(JSONPathNode_t *jpn, Node *root) {
+    JSONPathMatches_t m;
+    JSONPathNode_FindAll(jpn, root, &m, 1, 0);
+    size_t len = Node_Length(m.nodes);
+    JSONPathMatch_t **order = JSONPathMatches_Sort(&m, JSONPathMatches_CompareDeletes);
+
+    long long deleted = 0;
+    for (size_t i = 0, run; i < len; i += run) {
+        JSONPathMatch_t *w = order[i];
+        Node **ancestors = JSONPathMatches_Ancestors(&m, w);
+        NodeStats before;
+        int count = 1;
+        run = 1;
+        if (!w->p) continue;  // the root isn't matched by multiple value paths
+
+        // the run of matches that are deleted at once, skipping repeated ones
+        for (run = 1; i + run < len && order[i + run]->p == w->p; run++) {
+            JSONPathMatch_t *next = order[i + run];
+            if (N_ARRAY == NODETYPE(w->p) && next->index == w->index - count) {
+                count++;
+            } else if (N_ARRAY == NODETYPE(w->p) ? next->index != w->index - count + 1
+                                                 : strcmp(next->key, w->key)) {
+                break;
+            }
+        }
+
+        int stats = JSONPathMatches_BeginWrite(ancestors, w->depth - 1, w->p, &before);
+        if (N_DICT == w->p->type) {
+            Node_DictDel(w->p, w->key);
+        } else {
+            Node_ArrayDelRange(w->p, w->index - count + 1, count);
+        }
+        if (stats) JSONPathMatches_EndWrite(ancestors, w->depth - 1, w->p, &before);
+        deleted += count;
+    }
+
+    free(order);
+    JSONPathMatches_Free(&m);
+    jpn->n = NULL;
+    return deleted;
+}
+
+/* A command's operation on one of the values that its path matches, which returns the value's
+ * reply: an integer or a string node, or NULL for null. */
+typedef Node *(*JSONPathOp)(Node *n, void *arg);
+
+/* Applies a command's operation to every value of the `type` that a multi-value path matches, and
+ * replies with an array of the operation's replies in document order, and nulls for the values of
+ * other types. An operation that writes is applied to the deepest values first, so that it doesn't
+ * free a value that it's yet to be applied to.
+ */
+static void JSONPathNode_ReplyWithAll(RedisModuleCtx *ctx, JSONPathNode_t *jpn, Node *root,
+                                      NodeType type, int write, JSONPathOp op, void *arg) {
+    JSONPathMatches_t m;
+    JSONPathNode_FindAll(jpn, root, &m, 1, 0);
+    size_t len = Node_Length(m.nodes);
+    Node **replies = calloc(MAX(len, 1), sizeof(Node *));
+
+    JSONPathMatch_t **order = JSONPathMatches_Sort(&m, JSONPathMatches_CompareWrites);
+    for (size_t i = 0; i < len; i++) {
+        JSONPathMatch_t *w = order[i];
+        Node **ancestors = JSONPathMatches_Ancestors(&m, w);
+        NodeStats before;
+        if (NODETYPE(w->n) != type) continue;
+
+        int stats = write && JSONPathMatches_BeginWrite(ancestors, w->depth, w->n, &before);
+        replies[w - m.where] = op(w->n, arg);
+        if (stats) JSONPathMatches_EndWrite(ancestors, w->depth, w->n, &before);
+    }
+
+    RedisModule_ReplyWithArray(ctx, len);
+    for (size_t i = 0; i < len; i++) {
+        if (!replies[i]) {
+            RedisModule_ReplyWithNull(ctx);
+        } else if (N_INTEGER == replies[i]->type) {
+            RedisModule_ReplyWithLongLong(ctx, replies[i]->value.intval);
+        } else {
+            RedisModule_ReplyWithStringBuffer(ctx, NODE_STRING_DATA(replies[i]),
+                                              NODE_STRING_LEN(replies[i]));
+        }
+        Node_Free(replies[i]);
+    }
+
+    free(order);
+    free(replies);
+    JSONPathMatches_Free(&m);
+    jpn->n = NULL;
+}
+
+/* Returns 1 if `path` is a valid path to the root, 0 otherwise. */
+static int JSONPathIsRoot(const RedisModuleString *path) {
+    size_t len;
+    const char *spath = RedisModule_StringPtrLen(path, &len);
+    SharedPath *p = SharedPath_Get(spath, len);
+    int ret = p && SearchPath_IsRootPath(&p->sp);
+    if (p) SharedPath_Release(p);
+    return ret;
+}
+
 void ReplyWithPathTypeError(RedisModuleCtx *ctx, NodeType expected, NodeType actual) {
     sds err = sdscatfmt(sdsempty(), REJSON_ERROR_PATH_WRONGTYPE, NodeTypeStr(expected),
                         NodeTypeStr(actual));
@@ -104,7 +466,7 @@ void ReplyWithPathTypeError(RedisModuleCtx *ctx, NodeType expected, NodeType act
 /* Generic path error reply handler */
 void ReplyWithPathError(RedisModuleCtx *ctx, const JSONPathNode_t *jpn) {
     // TODO: report actual position in path & literal token
-    PathNode *epn = &jpn->sp.nodes[jpn->errlevel];
+    PathNode *epn = &jpn->sp->nodes[jpn->errlevel];
     sds err = sdsempty();
     switch (jpn->err) {
         case E_OK:
@@ -127,6 +489,10 @@ void ReplyWithPathError(RedisModuleCtx *ctx, const JSONPathNode_t *jpn) {
             err = sdscatfmt(err, "ERR key '%s' does not exist at level %i in path", epn->value.key,
                             jpn->errlevel);
             break;
+        case E_MULTI:
+            err = sdscatfmt(err, "ERR path matches multiple values at level %i, which is only "
+                                 "supported by JSON.GET and JSON.MGET", jpn->errlevel);
+            break;
         default:
             err = sdscatfmt(err, "ERR unknown path error at level %i in path", jpn->errlevel);
             break;
@@ -138,6 +504,43 @@ void ReplyWithPathError(RedisModuleCtx *ctx, const JSONPathNode_t *jpn) {
 /* The custom Redis data type. */
 static RedisModuleType *JSONType;
 
+/* The cache of JSON.GET replies, keyed by the document's version and the command's arguments. */
+static LRUCache *replyCache = NULL;
+
+static void ReplyCache_FreeValue(void *value) { sdsfree((sds)value); }
+
+/* Returns the reply cache's key for the arguments that follow the key of a command. */
+static sds ReplyCache_Key(const JSONType_t *jt, RedisModuleString **argv, int argc) {
+    sds key = sdsnewlen(&jt->version, sizeof(jt->version));
+    for (int i = 0; i < argc; i++) {
+        size_t len;
+        const char *arg = RedisModule_StringPtrLen(argv[i], &len);
+        uint32_t len32 = (uint32_t)len;
+        key = sdscatlen(key, &len32, sizeof(len32));
+        key = sdscatlen(key, arg, len);
+    }
+    return key;
+}
+
+/* Replies with a cache's statistics, a disabled (NULL) cache's are all zeros. */
+static void ReplyWithCacheStats(RedisModuleCtx *ctx, const LRUCache *c) {
+    LRUCache empty = {0};
+    if (!c) c = &empty;
+    RedisModule_ReplyWithArray(ctx, 12);
+    RedisModule_ReplyWithSimpleString(ctx, "hits");
+    RedisModule_ReplyWithLongLong(ctx, (long long)c->hits);
+    RedisModule_ReplyWithSimpleString(ctx, "misses");
+    RedisModule_ReplyWithLongLong(ctx, (long long)c->misses);
+    RedisModule_ReplyWithSimpleString(ctx, "evictions");
+    RedisModule_ReplyWithLongLong(ctx, (long long)c->evictions);
+    RedisModule_ReplyWithSimpleString(ctx, "entries");
+    RedisModule_ReplyWithLongLong(ctx, (long long)c->entries);
+    RedisModule_ReplyWithSimpleString(ctx, "size");
+    RedisModule_ReplyWithLongLong(ctx, (long long)c->size);
+    RedisModule_ReplyWithSimpleString(ctx, "maxsize");
+    RedisModule_ReplyWithLongLong(ctx, (long long)c->maxsize);
+}
+
 // == Module JSON commands ==
 
 /**
@@ -178,7 +581,7 @@ int JSONResp_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int arg
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (3 == argc ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -206,10 +609,16 @@ int JSONResp_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int arg
  * Supported subcommands are:
  *   `MEMORY <key> [path]` - report the memory usage in bytes of a value. `path` defaults to root if
  *   not provided.
+ *   `CACHE` - report the statistics of the JSON.GET reply cache
+ *   `PATHCACHE` - report the statistics of the parsed path cache
+ *   `INTERN` - report the statistics of the interned object keys
+ *   `LAZYFREE` - report the statistics of the documents freed on a background thread
  *  `HELP` - replies with a helpful message
  *
  * Reply: depends on the subcommand used:
  *   `MEMORY` returns an integer, specifically the size in bytes of the value
+ *   `CACHE`, `PATHCACHE`, `INTERN` and `LAZYFREE` return an array of statistic names and their
+ *   integer values
  *   `HELP` returns an array, specifically with the help message
 */
 int JSONDebug_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
@@ -247,7 +656,7 @@ int JSONDebug_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
         }
 
         // validate path
-        JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+        JSONType_t *jt = JSONType_GetValue(key);
         JSONPathNode_t jpn;
         RedisModuleString *spath =
             (4 == argc ? argv[3] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -265,8 +674,61 @@ int JSONDebug_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
             JSONPathNode_Free(&jpn);
             return REDISMODULE_ERR;
         }
+    } else if (!strncasecmp("cache", subcmd, subcmdlen)) {
+        if (argc != 2) {
+            RedisModule_WrongArity(ctx);
+            return REDISMODULE_ERR;
+        }
+
+        ReplyWithCacheStats(ctx, replyCache);
+        return REDISMODULE_OK;
+    } else if (!strncasecmp("pathcache", subcmd, subcmdlen)) {
+        if (argc != 2) {
+            RedisModule_WrongArity(ctx);
+            return REDISMODULE_ERR;
+        }
+
+        ReplyWithCacheStats(ctx, pathCache);
+        return REDISMODULE_OK;
+    } else if (!strncasecmp("intern", subcmd, subcmdlen)) {
+        if (argc != 2) {
+            RedisModule_WrongArity(ctx);
+            return REDISMODULE_ERR;
+        }
+
+        // saved is negative while most keys are unique, due to the table's overhead
+        KeyInternStats stats;
+        Key_GetInternStats(&stats);
+        RedisModule_ReplyWithArray(ctx, 8);
+        RedisModule_ReplyWithSimpleString(ctx, "keys");
+        RedisModule_ReplyWithLongLong(ctx, (long long)stats.keys);
+        RedisModule_ReplyWithSimpleString(ctx, "references");
+        RedisModule_ReplyWithLongLong(ctx, (long long)stats.refs);
+        RedisModule_ReplyWithSimpleString(ctx, "size");
+        RedisModule_ReplyWithLongLong(ctx, (long long)stats.size);
+        RedisModule_ReplyWithSimpleString(ctx, "saved");
+        RedisModule_ReplyWithLongLong(ctx, (long long)stats.refsize - (long long)stats.size);
+        return REDISMODULE_OK;
+    } else if (!strncasecmp("lazyfree", subcmd, subcmdlen)) {
+        if (argc != 2) {
+            RedisModule_WrongArity(ctx);
+            return REDISMODULE_ERR;
+        }
+
+        LazyFreeStats stats;
+        LazyFree_GetStats(&stats);
+        RedisModule_ReplyWithArray(ctx, 4);
+        RedisModule_ReplyWithSimpleString(ctx, "pending");
+        RedisModule_ReplyWithLongLong(ctx, (long long)stats.pending);
+        RedisModule_ReplyWithSimpleString(ctx, "freed");
+        RedisModule_ReplyWithLongLong(ctx, (long long)stats.freed);
+        return REDISMODULE_OK;
     } else if (!strncasecmp("help", subcmd, subcmdlen)) {
         const char *help[] = {"MEMORY <key> [path] - reports memory usage",
+                              "CACHE               - reports JSON.GET reply cache statistics",
+                              "PATHCACHE           - reports parsed path cache statistics",
+                              "INTERN              - reports interned object keys statistics",
+                              "LAZYFREE            - reports background freed documents statistics",
                               "HELP                - this message", NULL};
 
         RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
@@ -311,7 +773,7 @@ int JSONType_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int arg
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (3 == argc ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -323,6 +785,8 @@ int JSONType_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int arg
     // make the type-specifc reply, or deal with path errors
     if (E_OK == jpn.err) {
         RedisModule_ReplyWithSimpleString(ctx, NodeTypeStr(NODETYPE(jpn.n)));
+    } else if (E_MULTI == jpn.err) {
+        ReplyWithPathError(ctx, &jpn);
     } else {
         // reply with null if there are **any** non-existing elements along the path
         RedisModule_ReplyWithNull(ctx);
@@ -342,6 +806,8 @@ int JSONType_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int arg
  *
  * Reply: Integer, specifically the length of the value.
 */
+static Node *JSONLenOp(Node *n, void *arg) { return NewIntNode(Node_Length(n)); }
+
 int JSONLen_GenericCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     // check args
     if ((argc < 2) || (argc > 3)) {
@@ -366,7 +832,7 @@ int JSONLen_GenericCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (3 == argc ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -375,12 +841,6 @@ int JSONLen_GenericCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
         return REDISMODULE_ERR;
     }
 
-    // deal with path errors
-    if (E_OK != jpn.err) {
-        ReplyWithPathError(ctx, &jpn);
-        goto error;
-    }
-
     // determine the type of target value based on command name
     NodeType expected, actual = NODETYPE(jpn.n);
     if (!strcasecmp("json.arrlen", cmd))
@@ -390,6 +850,19 @@ int JSONLen_GenericCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
     else  // must be json.strlen
         expected = N_STRING;
 
+    // a path that can match multiple values gets the length of each
+    if (SearchPath_IsMulti(jpn.sp)) {
+        JSONPathNode_ReplyWithAll(ctx, &jpn, jt->root, expected, 0, JSONLenOp, NULL);
+        JSONPathNode_Free(&jpn);
+        return REDISMODULE_OK;
+    }
+
+    // deal with path errors
+    if (E_OK != jpn.err) {
+        ReplyWithPathError(ctx, &jpn);
+        goto error;
+    }
+
     // reply with the length per type, or with an error if the wrong type is encountered
     if (actual == expected) {
         RedisModule_ReplyWithLongLong(ctx, Node_Length(jpn.n));
@@ -436,7 +909,7 @@ int JSONObjKeys_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (3 == argc ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -478,6 +951,110 @@ error:
     return REDISMODULE_ERR;
 }
 
+/* Parses the NX or XX condition of a set. */
+static int JSONSetParseCondition(RedisModuleString *arg, int *nx, int *xx) {
+    const char *subcmd = RedisModule_StringPtrLen(arg, NULL);
+    if (!strcasecmp("nx", subcmd)) {
+        *nx = 1;
+    } else if (!strcasecmp("xx", subcmd)) {
+        *xx = 1;
+    } else {
+        return REDISMODULE_ERR;
+    }
+    return REDISMODULE_OK;
+}
+
+// the outcomes of checking a set
+#define JSONSET_ERR -1  // the set is invalid, and an error was replied
+#define JSONSET_SKIP 0  // the NX or XX condition isn't met
+#define JSONSET_OK 1    // the value can be set
+
+/* Checks that a value can be set at the path, which was looked up in the document of an existing
+ * key or in the new value if the key is `empty`, given the NX and XX conditions.
+ */
+static int JSONSetCheck(RedisModuleCtx *ctx, int empty, const JSONPathNode_t *jpn, int nx,
+                        int xx) {
+    int isRootPath = SearchPath_IsRootPath(jpn->sp);
+
+    // handle an empty key
+    if (empty) {
+        // new keys must be created at the root
+        if (E_OK != jpn->err || !isRootPath) {
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_NEW_NOT_ROOT);
+            return JSONSET_ERR;
+        }
+
+        // new keys can be created only if the XX flag is off
+        return xx ? JSONSET_SKIP : JSONSET_OK;
+    }
+
+    // handle an existing key, first make sure there weren't any obvious path errors
+    if (E_OK != jpn->err && E_NOKEY != jpn->err) {
+        ReplyWithPathError(ctx, jpn);
+        return JSONSET_ERR;
+    }
+
+    // verify that we're dealing with the last child in case of an object
+    if (E_NOKEY == jpn->err && jpn->errlevel != jpn->sp->len - 1) {
+        RedisModule_ReplyWithError(ctx, REJSON_ERROR_PATH_NONTERMINAL_KEY);
+        return JSONSET_ERR;
+    }
+
+    if (E_OK == jpn->err) {
+        NodeType ntp = NODETYPE(jpn->p);
+
+        // an existing value in the root or an object can be replaced only if the NX is off
+        if (nx && (isRootPath || N_DICT == ntp)) return JSONSET_SKIP;
+
+        // other containers, i.e. arrays, do not sport the NX or XX behavioral modification agents
+        if (N_ARRAY == ntp && (nx || xx)) {
+            RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
+            return JSONSET_ERR;
+        }
+        return JSONSET_OK;
+    }
+
+    // must be E_NOKEY, new keys in the dictionary can be created only if the XX flag is off
+    return xx ? JSONSET_SKIP : JSONSET_OK;
+}
+
+/* Sets the value at a checked path in the document of an existing key, replacing the document when
+ * the path is the root, which takes ownership of the value and its arena. Replies with an error if
+ * the value can't be set.
+ */
+static int JSONSetNode(RedisModuleCtx *ctx, RedisModuleKey *key, JSONType_t *jt,
+                       JSONPathNode_t *jpn, Node *jo, NodeArena *arena) {
+    // replacing the root is easy
+    if (SearchPath_IsRootPath(jpn->sp)) {
+        RedisModule_DeleteKey(key);
+        RedisModule_ModuleTypeSetValue(key, JSONType, NewJSONType(jo, arena));
+        return REDISMODULE_OK;
+    }
+
+    // replace a value according to its container type
+    JSONPathNode_BeginWrite(jpn, jt->root, 1);
+    if (E_NOKEY == jpn->err || N_DICT == NODETYPE(jpn->p)) {
+        if (OBJ_OK != Node_DictSet(jpn->p, jpn->sp->nodes[jpn->sp->len - 1].value.key, jo)) {
+            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_DICT_SET);
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_DICT_SET);
+            return REDISMODULE_ERR;
+        }
+    } else {  // must be an array
+        int index = jpn->sp->nodes[jpn->sp->len - 1].value.index;
+        if (index < 0) index = Node_Length(jpn->p) + index;
+        if (OBJ_OK != Node_ArraySet(jpn->p, index, jo)) {
+            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_ARRAY_SET);
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_ARRAY_SET);
+            return REDISMODULE_ERR;
+        }
+        // unlike DictSet, ArraySet does not free so we need to call it explicitly (a packed
+        // array's item is a copy that ArraySet took care of, which Node_Free ignores)
+        Node_Free(jpn->n);
+    }
+    JSONPathNode_EndWrite(jpn, jt->root);
+    return REDISMODULE_OK;
+}
+
 /**
  * JSON.SET <key> <path> <json> [NX|XX]
  * Sets the JSON value at `path` in `key`
@@ -518,10 +1095,15 @@ int JSONSet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
         return REDISMODULE_ERR;
     }
 
-    // Create object from json
+    /* Create object from json. A value that becomes a document's root is allocated in an arena
+     * that the document owns, whereas values that are set inside existing documents use the heap.
+     */
     Object *jo = NULL;
     char *jerr = NULL;
-    if (JSONOBJECT_OK != CreateNodeFromJSON(json, jsonlen, &jo, &jerr)) {
+    NodeArena *arena = NULL;
+    if (REDISMODULE_KEYTYPE_EMPTY == type || JSONPathIsRoot(argv[2])) arena = NewNodeArena();
+    if (JSONOBJECT_OK != CreateNodeFromJSONEx(json, jsonlen, arena, &jo, &jerr)) {
+        if (arena) NodeArena_Free(arena);
         if (jerr) {
             RedisModule_ReplyWithError(ctx, jerr);
             free(jerr);
@@ -535,11 +1117,11 @@ int JSONSet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
     // initialize or get JSON type container
     JSONType_t *jt;
     if (REDISMODULE_KEYTYPE_EMPTY == type) {
-        jt = calloc(1, sizeof(JSONType_t));
-        jt->root = jo;
+        jt = NewJSONType(jo, arena);
     }
     else {
-        jt = RedisModule_ModuleTypeGetValue(key);
+        jt = JSONType_GetValue(key);
+        JSONType_Touch(jt);
     }
 
     /* Validate path against the existing object root, and pretend that the new object is the root
@@ -551,121 +1133,215 @@ int JSONSet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
         goto error;
     }
-    int isRootPath = SearchPath_IsRootPath(&jpn.sp);
 
     // subcommand for key creation behavior modifiers NX and XX
     int subnx = 0, subxx = 0;
-    if (argc > 4) {
-        const char *subcmd = RedisModule_StringPtrLen(argv[4], NULL);
-        if (!strcasecmp("nx", subcmd)) {
-            subnx = 1;
-        } else if (!strcasecmp("xx", subcmd)) {
-            subxx = 1;
-        } else {
-            RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
+    if (argc > 4 && REDISMODULE_OK != JSONSetParseCondition(argv[4], &subnx, &subxx)) {
+        RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
+        goto error;
+    }
+
+    switch (JSONSetCheck(ctx, REDISMODULE_KEYTYPE_EMPTY == type, &jpn, subnx, subxx)) {
+        case JSONSET_ERR:
             goto error;
-        }
+        case JSONSET_SKIP:
+            goto null;
     }
 
-    // handle an empty key
     if (REDISMODULE_KEYTYPE_EMPTY == type) {
-        // new keys must be created at the root
-        if (E_OK != jpn.err || !isRootPath) {
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_NEW_NOT_ROOT);
-            goto error;
-        }
+        RedisModule_ModuleTypeSetValue(key, JSONType, jt);
+    } else if (REDISMODULE_OK != JSONSetNode(ctx, key, jt, &jpn, jo, arena)) {
+        goto error;
+    }
 
-        // new keys can be created only if the XX flag is off
-        if (subxx) goto null;
+    RedisModule_ReplyWithSimpleString(ctx, "OK");
+    RedisModule_ReplicateVerbatim(ctx);
+    JSONPathNode_Free(&jpn);
+    return REDISMODULE_OK;
 
-        RedisModule_ModuleTypeSetValue(key, JSONType, jt);
-        goto ok;
+null:
+    RedisModule_ReplyWithNull(ctx);
+    JSONPathNode_Free(&jpn);
+    if (REDISMODULE_KEYTYPE_EMPTY == type) {
+        free(jt);
     }
+    Node_Free(jo);
+    if (arena) NodeArena_Free(arena);
+    return REDISMODULE_OK;
 
-    // handle an existing key, first make sure there weren't any obvious path errors
-    if (E_OK != jpn.err && E_NOKEY != jpn.err) {
-        ReplyWithPathError(ctx, &jpn);
-        goto error;
+error:
+    JSONPathNode_Free(&jpn);
+    if (REDISMODULE_KEYTYPE_EMPTY == type) {
+        free(jt);
     }
+    if (jo) Node_Free(jo);
+    if (arena) NodeArena_Free(arena);
+    return REDISMODULE_ERR;
+}
 
-    // verify that we're dealing with the last child in case of an object
-    if (E_NOKEY == jpn.err && jpn.errlevel != jpn.sp.len - 1) {
-        RedisModule_ReplyWithError(ctx, REJSON_ERROR_PATH_NONTERMINAL_KEY);
-        goto error;
+/* A value of JSON.MSET, which is checked along with the others before any of them is set. */
+typedef struct {
+    JSONType_t *jt;      // the key's document before the command, NULL if the key was empty
+    Node *jo;            // the value, until it is set
+    NodeArena *arena;    // the value's arena, if it becomes a document's root
+    JSONPathNode_t jpn;  // the path
+} JSONMSetValue;
+
+/* Returns 1 if the path goes through the node n, i.e. n is one of the containers above the path's
+ * target in the document's root, 0 otherwise.
+ */
+static int JSONPathNode_IsBelow(const JSONPathNode_t *jpn, Node *root, const Node *n) {
+    if (!n || SearchPath_IsRootPath(jpn->sp)) return 0;
+
+    Node *current = root, scratch;
+    PathError err;
+    for (size_t i = 0; current; i++) {
+        if (current == n) return 1;
+        if (i + 1 >= jpn->sp->len) break;
+        current = __pathNode_eval(&jpn->sp->nodes[i], current, &scratch, &err);
+    }
+    return 0;
+}
+
+/**
+ * JSON.MSET <key> <path> <json> [<key> <path> <json> ...] [NX|XX]
+ * Sets the JSON values at the `path`s in the `key`s, in the order that they're given.
+ *
+ * All the values and paths are checked before any of them is set, so either all of them are set or
+ * none is. The paths are checked against the keys as they are before the command, so a new key can
+ * only be set at its root, and a path can't go through a value that's set by a preceding path in
+ * the same key. The optional `NX` or `XX` condition is that of JSON.SET, and applies to every
+ * value.
+ *
+ * Reply: Simple String `OK` if executed correctly, or Null Bulk if the specified `NX` or `XX`
+ * condition was not met by any of the values, in which case none is set.
+*/
+int JSONMSet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    // check args, which are triplets that may be followed by the condition
+    if ((argc < 4) || ((argc - 1) % 3 > 1)) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_ERR;
     }
+    if (RedisModule_IsKeysPositionRequest(ctx)) {
+        for (int i = 1; i + 2 < argc; i += 3) RedisModule_KeyAtPos(ctx, i);
+        return REDISMODULE_OK;
+    }
+    RedisModule_AutoMemory(ctx);
 
-    // replace a value according to its container type
-    if (E_OK == jpn.err) {
-        NodeType ntp = NODETYPE(jpn.p);
+    int subnx = 0, subxx = 0;
+    if ((argc - 1) % 3 && REDISMODULE_OK != JSONSetParseCondition(argv[argc - 1], &subnx, &subxx)) {
+        RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
 
-        // an existing value in the root or an object can be replaced only if the NX is off
-        if (subnx && (isRootPath || N_DICT == ntp)) {
-            goto null;
-        }
+    int count = (argc - 1) / 3;
+    int rc = REDISMODULE_ERR;
+    int skip = 0;
+    JSONMSetValue *values = calloc(count, sizeof(JSONMSetValue));
 
-        // other containers, i.e. arrays, do not sport the NX or XX behavioral modification agents
-        if (N_ARRAY == ntp && (subnx || subxx)) {
-            RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
-            goto error;
+    // check all the values and paths before anything is set
+    for (int i = 0; i < count; i++) {
+        JSONMSetValue *v = &values[i];
+        RedisModuleString **args = &argv[1 + 3 * i];
+
+        // key must be empty or a JSON type
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, args[0], REDISMODULE_READ);
+        int type = RedisModule_KeyType(key);
+        if (REDISMODULE_KEYTYPE_EMPTY != type && RedisModule_ModuleTypeGetType(key) != JSONType) {
+            RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+            goto done;
         }
+        if (REDISMODULE_KEYTYPE_EMPTY != type) v->jt = JSONType_GetValue(key);
 
-        if (isRootPath) {
-            // replacing the root is easy
-            RedisModule_DeleteKey(key);
-            jt = calloc(1, sizeof(JSONType_t));
-            jt->root = jo;
-            RedisModule_ModuleTypeSetValue(key, JSONType, jt);
-        } else if (N_DICT == NODETYPE(jpn.p)) {
-            if (OBJ_OK != Node_DictSet(jpn.p, jpn.sp.nodes[jpn.sp.len - 1].value.key, jo)) {
-                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_DICT_SET);
-                RedisModule_ReplyWithError(ctx, REJSON_ERROR_DICT_SET);
-                goto error;
+        // JSON must be valid, and values that become a document's root are put in an arena
+        size_t jsonlen;
+        const char *json = RedisModule_StringPtrLen(args[2], &jsonlen);
+        if (!jsonlen) {
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_EMPTY_STRING);
+            goto done;
+        }
+        char *jerr = NULL;
+        if (!v->jt || JSONPathIsRoot(args[1])) v->arena = NewNodeArena();
+        if (JSONOBJECT_OK != CreateNodeFromJSONEx(json, jsonlen, v->arena, &v->jo, &jerr)) {
+            if (jerr) {
+                RedisModule_ReplyWithError(ctx, jerr);
+                free(jerr);
+            } else {
+                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_JSONOBJECT_ERROR);
+                RedisModule_ReplyWithError(ctx, REJSON_ERROR_JSONOBJECT_ERROR);
             }
-        } else {  // must be an array
-            int index = jpn.sp.nodes[jpn.sp.len - 1].value.index;
-            if (index < 0) index = Node_Length(jpn.p) + index;
-            if (OBJ_OK != Node_ArraySet(jpn.p, index, jo)) {
-                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_ARRAY_SET);
-                RedisModule_ReplyWithError(ctx, REJSON_ERROR_ARRAY_SET);
-                goto error;
+            goto done;
+        }
+
+        // like JSON.SET, the path of an empty key is looked up in the value to reject non-roots
+        if (PARSE_OK != NodeFromJSONPath(v->jt ? v->jt->root : v->jo, args[1], &v->jpn)) {
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
+            goto done;
+        }
+        switch (JSONSetCheck(ctx, !v->jt, &v->jpn, subnx, subxx)) {
+            case JSONSET_ERR:
+                goto done;
+            case JSONSET_SKIP:
+                skip = 1;
+                break;
+        }
+
+        // the preceding values in the same document mustn't change the path's containers
+        for (int j = 0; v->jt && j < i; j++) {
+            if (values[j].jt == v->jt && E_OK == values[j].jpn.err &&
+                JSONPathNode_IsBelow(&v->jpn, v->jt->root, values[j].jpn.n)) {
+                RedisModule_ReplyWithError(ctx, REJSON_ERROR_PATH_OVERLAP);
+                goto done;
             }
-            // unlike DictSet, ArraySet does not free so we need to call it explicitly
-            Node_Free(jpn.n);
         }
-    } else {  // must be E_NOKEY
-        // new keys in the dictionary can be created only if the XX flag is off
-        if (subxx) goto null;
+    }
 
-        if (OBJ_OK != Node_DictSet(jpn.p, jpn.sp.nodes[jpn.sp.len - 1].value.key, jo)) {
-            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_DICT_SET);
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_DICT_SET);
-            goto error;
+    if (skip) {
+        RedisModule_ReplyWithNull(ctx);
+        rc = REDISMODULE_OK;
+        goto done;
+    }
+
+    // set the values in order, the documents own them once they're set
+    for (int i = 0; i < count; i++) {
+        JSONMSetValue *v = &values[i];
+        RedisModuleString **args = &argv[1 + 3 * i];
+        RedisModuleKey *key =
+            RedisModule_OpenKey(ctx, args[0], REDISMODULE_READ | REDISMODULE_WRITE);
+        if (REDISMODULE_KEYTYPE_EMPTY == RedisModule_KeyType(key)) {
+            RedisModule_ModuleTypeSetValue(key, JSONType, NewJSONType(v->jo, v->arena));
+        } else {
+            // the path is looked up again, as the preceding values may have changed the document
+            JSONType_t *jt = JSONType_GetValue(key);
+            JSONType_Touch(jt);
+            JSONPathNode_Free(&v->jpn);
+            if (PARSE_OK != NodeFromJSONPath(jt->root, args[1], &v->jpn) ||
+                JSONSET_OK != JSONSetCheck(ctx, 0, &v->jpn, 0, 0) ||
+                REDISMODULE_OK != JSONSetNode(ctx, key, jt, &v->jpn, v->jo, v->arena)) {
+                goto done;
+            }
         }
+        v->jo = NULL;
+        v->arena = NULL;
     }
 
-ok:
     RedisModule_ReplyWithSimpleString(ctx, "OK");
     RedisModule_ReplicateVerbatim(ctx);
-    JSONPathNode_Free(&jpn);
-    return REDISMODULE_OK;
+    rc = REDISMODULE_OK;
 
-null:
-    RedisModule_ReplyWithNull(ctx);
-    JSONPathNode_Free(&jpn);
-    return REDISMODULE_OK;
-
-error:
-    JSONPathNode_Free(&jpn);
-    if (REDISMODULE_KEYTYPE_EMPTY == type) {
-        free(jt);
+done:
+    for (int i = 0; i < count; i++) {
+        JSONPathNode_Free(&values[i].jpn);
+        if (values[i].jo) Node_Free(values[i].jo);
+        if (values[i].arena) NodeArena_Free(values[i].arena);
     }
-    if (jo) Node_Free(jo);
-    return REDISMODULE_ERR;
+    free(values);
+    return rc;
 }
 
 /**
  * JSON.GET <key> [INDENT indentation-string] [NEWLINE newline-string] [SPACE space-string]
- *                [path ...]
+ *                [LIMIT count] [path ...]
  * Return the value at `path` in JSON serialized form.
  *
  * This command accepts multiple `path`s, and defaults to the value's root when none are given.
@@ -675,10 +1351,13 @@ error:
  *   - `NEWLINE` sets the string that's printed at the end of each line
  *   - `SPACE` sets the string that's put between a key and a value
  *
+ * `LIMIT` stops the search of a path that can match multiple values once it has `count` of them.
+ *
  * Reply: Bulk String, specifically the JSON serialization.
  * The reply's structure depends on the on the number of paths. A single path results in the value
  * being itself is returned, whereas multiple paths are returned as a JSON object in which each path
- * is a key.
+ * is a key. The value of a path with wildcards (`*`), deep scans (`..`), slices, unions or filters
+ * (`[?(...)]`) is an array of all the values that it matches, which is empty if there are none.
 */
 int JSONGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     if ((argc < 2)) {
@@ -698,6 +1377,19 @@ int JSONGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
         return REDISMODULE_ERR;
     }
 
+    // reply from the cache if the same arguments were used since the document was last changed
+    JSONType_t *jt = JSONType_GetValue(key);
+    sds cachekey = NULL;
+    if (replyCache) {
+        cachekey = ReplyCache_Key(jt, &argv[2], argc - 2);
+        sds cached = LRUCache_Get(replyCache, cachekey, sdslen(cachekey));
+        if (cached) {
+            RedisModule_ReplyWithStringBuffer(ctx, cached, sdslen(cached));
+            sdsfree(cachekey);
+            return REDISMODULE_OK;
+        }
+    }
+
     // check for optional arguments
     int pathpos = 2;
     JSONSerializeOpt jsopt = {0};
@@ -725,15 +1417,26 @@ int JSONGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
             jsopt.spacestr = "";
         }
     }
+    long long limit = 0;
+    if (pathpos + 1 < argc && !strcasecmp("limit", RedisModule_StringPtrLen(argv[pathpos], NULL))) {
+        if (REDISMODULE_OK != RedisModule_StringToLongLong(argv[pathpos + 1], &limit) ||
+            limit < 1) {
+            RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
+            sdsfree(cachekey);
+            return REDISMODULE_ERR;
+        }
+        pathpos += 2;
+    }
 
-    // initialize the reply
-    sds json = sdsempty();
+    // the reply, which is allocated once the values to serialize are known
+    sds json = NULL;
 
     // validate paths, if none provided default to root
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
     int npaths = argc - pathpos;
     int jpnslen = 0;
     JSONPathNode_t jpns[MAX(npaths, 1)];  // if no paths then the root
+    JSONPathMatches_t matches[MAX(npaths, 1)];
+    memset(matches, 0, sizeof(matches));
     if (!npaths) {  // default to root
         NodeFromJSONPath(jt->root, RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1), &jpns[0]);
         jpnslen = 1;
@@ -745,9 +1448,15 @@ int JSONGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
                 goto error;
             }
 
+            // a path that can match multiple values gets an array of them
+            if (SearchPath_IsMulti(jpns[jpnslen].sp)) {
+                JSONPathNode_FindAll(&jpns[jpnslen], jt->root, &matches[jpnslen], 0, limit);
+            }
+
             // deal with path errors
             if (E_OK != jpns[jpnslen].err) {
                 ReplyWithPathError(ctx, &jpns[jpnslen]);
+                JSONPathNode_Free(&jpns[jpnslen]);
                 goto error;
             }
 
@@ -757,13 +1466,16 @@ int JSONGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
 
     // return the single path's JSON value, or wrap all paths-values as an object
     if (1 == jpnslen) {
-        SerializeNodeToJSON(jpns[0].n, &jsopt, &json);
+        json = SerializeNodeToJSONSized(jpns[0].n, &jsopt);
     } else {
         Node *objReply = NewDictNode(jpnslen);
         for (int i = 0; i < jpnslen; i++) {
+            // setting a repeated path would free the value that it replaces
+            Node *dummy;
+            if (OBJ_OK == Node_DictGet(objReply, jpns[i].spath, &dummy)) continue;
             Node_DictSet(objReply, jpns[i].spath, jpns[i].n);
         }
-        SerializeNodeToJSON(objReply, &jsopt, &json);
+        json = SerializeNodeToJSONSized(objReply, &jsopt);
 
         // avoid removing the actual data by resetting the reply dict
         // TODO: need a non-freeing Del
@@ -784,97 +1496,148 @@ int JSONGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
 
     for (int i = 0; i < jpnslen; i++) {
         JSONPathNode_Free(&jpns[i]);
+        JSONPathMatches_Free(&matches[i]);
+    }
+    if (cachekey) {
+        // the cache takes ownership of the reply
+        LRUCache_Put(replyCache, cachekey, sdslen(cachekey), json, sdsAllocSize(json));
+        sdsfree(cachekey);
+    } else {
+        sdsfree(json);
     }
-    sdsfree(json);
     return REDISMODULE_OK;
 
 error:
     for (int i = 0; i < jpnslen; i++) {
         JSONPathNode_Free(&jpns[i]);
+        JSONPathMatches_Free(&matches[i]);
     }
     sdsfree(json);
+    sdsfree(cachekey);
     return REDISMODULE_ERR;
 }
 
-/**
- * JSON.MGET <path> <key> [<key> ...]
- * Returns the values at `path` from multiple `key`s. Non-existing keys and non-existing paths are
- * reported as null.
- * Reply: Array of Bulk Strings, specifically the JSON serialization of the value at each key's
- * path.
-*/
-int JSONMGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    if ((argc < 2)) {
-        RedisModule_WrongArity(ctx);
-        return REDISMODULE_ERR;
-    }
+/* Replies with the values at `npaths` paths, starting at argv[pathpos], from each of the keys that
+ * follow them. With `multi`, the values of every key are in an array of their own. */
+static int JSONMGet_Reply(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, int multi,
+                          int npaths, int pathpos) {
+    int keypos = pathpos + npaths;
+
     if (RedisModule_IsKeysPositionRequest(ctx)) {
-        for (int i = 2; i < argc - 2; i++) RedisModule_KeyAtPos(ctx, i);
+        for (int i = keypos; i < argc; i++) RedisModule_KeyAtPos(ctx, i);
         return REDISMODULE_OK;
     }
     RedisModule_AutoMemory(ctx);
 
-    // validate search path
-    size_t spathlen;
-    const char *spath = RedisModule_StringPtrLen(argv[1], &spathlen);
-    JSONPathNode_t jpn;
-    jpn.sp = NewSearchPath(0);
-    if (PARSE_ERR == ParseJSONPath(spath, spathlen, &jpn.sp)) {
-        RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
-        goto error;
+    // validate search paths
+    int ret = REDISMODULE_OK;
+    JSONPathNode_t *jpns = calloc(npaths, sizeof(JSONPathNode_t));
+    for (int i = 0; i < npaths; i++) {
+        size_t spathlen;
+        const char *spath = RedisModule_StringPtrLen(argv[pathpos + i], &spathlen);
+        if (PARSE_ERR == JSONPathNode_Parse(&jpns[i], spath, spathlen)) {
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
+            ret = REDISMODULE_ERR;
+            goto done;
+        }
     }
 
     // iterate keys
-    RedisModule_ReplyWithArray(ctx, argc - 2);
-    int isRootPath = SearchPath_IsRootPath(&jpn.sp);
+    RedisModule_ReplyWithArray(ctx, argc - keypos);
     JSONSerializeOpt jsopt = {0};
-    for (int i = 2; i < argc; i++) {
+    for (int i = keypos; i < argc; i++) {
         RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[i], REDISMODULE_READ);
 
         // key must an object type, empties and others return null like Redis' MGET
-        int type = RedisModule_KeyType(key);
-        if (REDISMODULE_KEYTYPE_EMPTY == type) goto null;
-        if (RedisModule_ModuleTypeGetType(key) != JSONType) goto null;
-
-        // follow the path to the target node in the key
-        JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
-        if (isRootPath) {
-            jpn.err = E_OK;
-            jpn.n = jt->root;
-        } else {
-            jpn.err = SearchPath_FindEx(&jpn.sp, jt->root, &jpn.n, &jpn.p, &jpn.errlevel);
+        JSONType_t *jt = NULL;
+        if (REDISMODULE_KEYTYPE_EMPTY != RedisModule_KeyType(key) &&
+            RedisModule_ModuleTypeGetType(key) == JSONType) {
+            jt = JSONType_GetValue(key);
         }
 
-        // deal with path errors by returning null
-        if (E_OK != jpn.err) goto null;
+        if (multi) RedisModule_ReplyWithArray(ctx, npaths);
+        for (int j = 0; j < npaths; j++) {
+            JSONPathNode_t *jpn = &jpns[j];
+            if (!jt) goto null;
+
+            // follow the path to the target node in the key, or to all the nodes it matches
+            JSONPathMatches_t matches = {0};
+            if (SearchPath_IsMulti(jpn->sp)) {
+                JSONPathNode_FindAll(jpn, jt->root, &matches, 0, 0);
+            } else if (SearchPath_IsRootPath(jpn->sp)) {
+                jpn->err = E_OK;
+                jpn->n = jt->root;
+            } else {
+                jpn->err = SearchPath_FindEx(jpn->sp, jt->root, &jpn->n, &jpn->p,
+                                             &jpn->errlevel, &jpn->item);
+            }
 
-        // serialize it
-        sds json = sdsempty();
-        SerializeNodeToJSON(jpn.n, &jsopt, &json);
+            // deal with path errors by returning null
+            if (E_OK != jpn->err) goto null;
 
-        // check whether serialization had succeeded
-        if (!sdslen(json)) {
+            // serialize it, and add the serialization of object for that key's path
+            sds json = SerializeNodeToJSONSized(jpn->n, &jsopt);
+            if (sdslen(json)) {
+                RedisModule_ReplyWithStringBuffer(ctx, json, sdslen(json));
+            } else {
+                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_SERIALIZE);
+                RedisModule_ReplyWithError(ctx, REJSON_ERROR_SERIALIZE);
+            }
             sdsfree(json);
-            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_SERIALIZE);
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_SERIALIZE);
-            goto error;
+            JSONPathMatches_Free(&matches);
+            continue;
+
+        null:  // reply with null for keys that the path mismatches
+            RedisModule_ReplyWithNull(ctx);
         }
+    }
 
-        // add the serialization of object for that key's path
-        RedisModule_ReplyWithStringBuffer(ctx, json, sdslen(json));
-        sdsfree(json);
-        continue;
+done:
+    for (int i = 0; i < npaths; i++) {
+        JSONPathNode_Free(&jpns[i]);
+    }
+    free(jpns);
+    return ret;
+}
 
-    null:  // reply with null for keys that the path mismatches
-        RedisModule_ReplyWithNull(ctx);
+/**
+ * JSON.MGET <path> <key> [<key> ...]
+ * Returns the values at `path` from multiple `key`s. Non-existing keys and non-existing paths are
+ * reported as null. A path with wildcards or deep scans returns an array of the values that it
+ * matches, as in JSON.GET.
+ *
+ * Reply: Array of Bulk Strings, specifically the JSON serialization of the value at each key's
+ * path.
+*/
+int JSONMGet_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if ((argc < 2)) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_ERR;
     }
+    return JSONMGet_Reply(ctx, argv, argc, 0, 1, 1);
+}
 
-    SearchPath_Free(&jpn.sp);
-    return REDISMODULE_OK;
+/**
+ * JSON.MGETPATHS <count> <path> [<path> ...] <key> [<key> ...]
+ * Returns the values of `count` paths from multiple `key`s, every path being parsed once for all of
+ * the keys. Non-existing keys and non-existing paths are reported as null.
+ *
+ * Reply: Array with an Array of Bulk Strings per key, specifically the JSON serialization of the
+ * value at each of the paths in that key.
+*/
+int JSONMGetPaths_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if ((argc < 3)) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_ERR;
+    }
 
-error:
-    SearchPath_Free(&jpn.sp);
-    return REDISMODULE_ERR;
+    long long count;
+    if (REDISMODULE_OK != RedisModule_StringToLongLong(argv[1], &count) || count < 1 ||
+        count > argc - 2) {
+        RedisModule_ReplyWithError(ctx, RM_ERRORMSG_SYNTAX);
+        return REDISMODULE_ERR;
+    }
+    return JSONMGet_Reply(ctx, argv, argc, 1, (int)count, 2);
 }
 
 /**
@@ -882,9 +1645,10 @@ error:
  * Delete a value.
  *
  * `path` defaults to root if not provided. Non-existing keys as well as non-existing paths are
- * ignored. Deleting an object's root is equivalent to deleting the key from Redis.
+ * ignored. Deleting an object's root is equivalent to deleting the key from Redis. A path with
+ * wildcards, deep scans, slices, unions or filters deletes all the values that it matches.
  *
- * Reply: Integer, specifically the number of paths deleted (0 or 1).
+ * Reply: Integer, specifically the number of values deleted.
 */
 int JSONDel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     // check args
@@ -906,7 +1670,8 @@ int JSONDel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (3 == argc ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -915,6 +1680,12 @@ int JSONDel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
         return REDISMODULE_ERR;
     }
 
+    // a path that can match multiple values deletes all of them
+    if (SearchPath_IsMulti(jpn.sp)) {
+        RedisModule_ReplyWithLongLong(ctx, JSONPathNode_DelAll(&jpn, jt->root));
+        goto ok;
+    }
+
     // deal with path errors
     if (E_NOINDEX == jpn.err || E_NOKEY == jpn.err) {
         // reply with 0 if there are **any** non-existing elements along the path
@@ -926,22 +1697,25 @@ int JSONDel_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc
     }
 
     // if it is the root then delete the key, otherwise delete the target from parent container
-    if (SearchPath_IsRootPath(&jpn.sp)) {
+    JSONPathNode_BeginWrite(&jpn, jt->root, 1);
+    if (SearchPath_IsRootPath(jpn.sp)) {
         RedisModule_DeleteKey(key);
     } else if (N_DICT == NODETYPE(jpn.p)) {  // delete from a dict
-        const char *dictkey = jpn.sp.nodes[jpn.sp.len - 1].value.key;
+        const char *dictkey = jpn.sp->nodes[jpn.sp->len - 1].value.key;
         if (OBJ_OK != Node_DictDel(jpn.p, dictkey)) {
             RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_DICT_DEL);
             RedisModule_ReplyWithError(ctx, REJSON_ERROR_DICT_DEL);
             goto error;
         }
+        JSONPathNode_EndWrite(&jpn, jt->root);
     } else {  // container must be an array
-        int index = jpn.sp.nodes[jpn.sp.len - 1].value.index;
+        int index = jpn.sp->nodes[jpn.sp->len - 1].value.index;
         if (OBJ_OK != Node_ArrayDelRange(jpn.p, index, 1)) {
             RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_ARRAY_DEL);
             RedisModule_ReplyWithError(ctx, REJSON_ERROR_ARRAY_DEL);
             goto error;
         }
+        JSONPathNode_EndWrite(&jpn, jt->root);
     }  // if (N_DICT)
 
     RedisModule_ReplyWithLongLong(ctx, (long long)argc - 2);
@@ -983,7 +1757,8 @@ int JSONNum_GenericCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (4 == argc ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -1052,34 +1827,39 @@ int JSONNum_GenericCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
         orz = NewDoubleNode(rz);
     }
 
+    // serialize the result for the reply, since a packed array keeps it as a value and frees it
+    JSONSerializeOpt jsopt = {0};
+    sds json = sdsempty();
+    SerializeNodeToJSON(orz, &jsopt, &json);
+
     // replace the original value with the result depending on the parent container's type
-    if (SearchPath_IsRootPath(&jpn.sp)) {
-        RedisModule_DeleteKey(key);
+    JSONPathNode_BeginWrite(&jpn, jt->root, 1);
+    if (SearchPath_IsRootPath(jpn.sp)) {
+        // replace the root in place, deleting the key would free the container
+        Node_Free(jt->root);
         jt->root = orz;
-        RedisModule_ModuleTypeSetValue(key, JSONType, jt);
     } else if (N_DICT == NODETYPE(jpn.p)) {
-        if (OBJ_OK != Node_DictSet(jpn.p, jpn.sp.nodes[jpn.sp.len - 1].value.key, orz)) {
+        if (OBJ_OK != Node_DictSet(jpn.p, jpn.sp->nodes[jpn.sp->len - 1].value.key, orz)) {
             RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_DICT_SET);
             RedisModule_ReplyWithError(ctx, REJSON_ERROR_DICT_SET);
+            sdsfree(json);
             goto error;
         }
     } else {  // container must be an array
-        int index = jpn.sp.nodes[jpn.sp.len - 1].value.index;
+        int index = jpn.sp->nodes[jpn.sp->len - 1].value.index;
         if (index < 0) index = Node_Length(jpn.p) + index;
         if (OBJ_OK != Node_ArraySet(jpn.p, index, orz)) {
             RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_ARRAY_SET);
             RedisModule_ReplyWithError(ctx, REJSON_ERROR_ARRAY_SET);
+            sdsfree(json);
             goto error;
         }
         // unlike DictSet, ArraySet does not free so we need to call it explicitly
         Node_Free(jpn.n);
     }
-    jpn.n = orz;
+    JSONPathNode_EndWrite(&jpn, jt->root);
 
     // reply with the serialization of the new value
-    JSONSerializeOpt jsopt = {0};
-    sds json = sdsempty();
-    SerializeNodeToJSON(jpn.n, &jsopt, &json);
     RedisModule_ReplyWithStringBuffer(ctx, json, sdslen(json));
     sdsfree(json);
 
@@ -1116,7 +1896,8 @@ int JSONStrAppend_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     Object *objRoot = RedisModule_ModuleTypeGetValue(key);
     RedisModuleString *spath =
@@ -1169,7 +1950,9 @@ int JSONStrAppend_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // actually concatenate the strings
+    JSONPathNode_BeginWrite(&jpn, jt->root, 0);
     Node_StringAppend(jpn.n, jo);
+    JSONPathNode_EndWrite(&jpn, jt->root);
     RedisModule_ReplyWithLongLong(ctx, (long long)Node_Length(jpn.n));
 
     JSONPathNode_Free(&jpn);
@@ -1180,6 +1963,76 @@ error:
     return REDISMODULE_ERR;
 }
 
+/* Parses JSON values to a new array in `sub`. Returns OBJ_OK, or OBJ_ERR after replying with an
+ * error. */
+static int JSONArrParseValues(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, Node **sub) {
+    *sub = NewArrayNode(argc);
+    for (int i = 0; i < argc; i++) {
+        // JSON must be valid
+        size_t jsonlen;
+        const char *json = RedisModule_StringPtrLen(argv[i], &jsonlen);
+        if (!jsonlen) {
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_EMPTY_STRING);
+            goto error;
+        }
+
+        // create object from json
+        Object *jo = NULL;
+        char *jerr = NULL;
+        if (JSONOBJECT_OK != CreateNodeFromJSON(json, jsonlen, &jo, &jerr)) {
+            if (jerr) {
+                RedisModule_ReplyWithError(ctx, jerr);
+                free(jerr);
+            } else {
+                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_JSONOBJECT_ERROR);
+                RedisModule_ReplyWithError(ctx, REJSON_ERROR_JSONOBJECT_ERROR);
+            }
+            goto error;
+        }
+
+        // append it to the sub array
+        if (OBJ_OK != Node_ArrayAppend(*sub, jo)) {
+            Node_Free(jo);
+            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_INSERT_SUBARRY);
+            RedisModule_ReplyWithError(ctx, REJSON_ERROR_INSERT_SUBARRY);
+            goto error;
+        }
+    }
+    return OBJ_OK;
+
+error:
+    Node_Free(*sub);
+    *sub = NULL;
+    return OBJ_ERR;
+}
+
+/* The arguments of JSON.ARRINSERT's and JSON.ARRAPPEND's operation on each of the arrays that a
+ * path matches. */
+typedef struct {
+    RedisModuleString **values;  // the JSON values
+    int nvalues;
+    Node *sub;        // the parsed values, for the first array
+    long long index;  // where to insert them
+    int append;       // or whether to append them
+} JSONArrInsertArg;
+
+static Node *JSONArrInsertOp(Node *n, void *arg) {
+    JSONArrInsertArg *a = arg;
+    long long len = Node_Length(n);
+    long long index = a->append ? len : a->index < 0 ? len + a->index : a->index;
+    if (index < 0 || index > len) return NULL;
+
+    // the other arrays get their own copy of the values, which are known to be valid
+    Node *sub = a->sub;
+    a->sub = NULL;
+    if (!sub && OBJ_OK != JSONArrParseValues(NULL, a->values, a->nvalues, &sub)) return NULL;
+    if (OBJ_OK != Node_ArrayInsert(n, index, sub)) {
+        Node_Free(sub);
+        return NULL;
+    }
+    return NewIntNode(Node_Length(n));
+}
+
 /**
  * JSON.ARRINSERT <key> <path> <index> <json> [<json> ...]
  * Insert the `json` value(s) into the array at `path` before the `index` (shifts to the right).
@@ -1206,7 +2059,8 @@ int JSONArrInsert_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     if (PARSE_OK != NodeFromJSONPath(jt->root, argv[2], &jpn)) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
@@ -1214,13 +2068,14 @@ int JSONArrInsert_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // deal with path errors
-    if (E_OK != jpn.err) {
+    int multi = SearchPath_IsMulti(jpn.sp);
+    if (!multi && E_OK != jpn.err) {
         ReplyWithPathError(ctx, &jpn);
         goto error;
     }
 
     // the target must be an array
-    if (N_ARRAY != NODETYPE(jpn.n)) {
+    if (!multi && N_ARRAY != NODETYPE(jpn.n)) {
         ReplyWithPathTypeError(ctx, N_ARRAY, NODETYPE(jpn.n));
         goto error;
     }
@@ -1233,58 +2088,36 @@ int JSONArrInsert_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // convert negative values
-    if (index < 0) index = Node_Length(jpn.n) + index;
+    if (!multi && index < 0) index = Node_Length(jpn.n) + index;
 
-    // check for out of range
-    if (index < 0 || index > Node_Length(jpn.n)) {
+    // check for out of range, which is done per array for multiple arrays
+    if (!multi && (index < 0 || index > Node_Length(jpn.n))) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_INDEX_OUTOFRANGE);
         goto error;
     }
 
     // make an array from the JSON values
-    Node *sub = NewArrayNode(argc - 4);
-    for (int i = 4; i < argc; i++) {
-        // JSON must be valid
-        size_t jsonlen;
-        const char *json = RedisModule_StringPtrLen(argv[i], &jsonlen);
-        if (!jsonlen) {
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_EMPTY_STRING);
-            Node_Free(sub);
-            goto error;
-        }
-
-        // create object from json
-        Object *jo = NULL;
-        char *jerr = NULL;
-        if (JSONOBJECT_OK != CreateNodeFromJSON(json, jsonlen, &jo, &jerr)) {
-            Node_Free(sub);
-            if (jerr) {
-                RedisModule_ReplyWithError(ctx, jerr);
-                free(jerr);
-            } else {
-                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_JSONOBJECT_ERROR);
-                RedisModule_ReplyWithError(ctx, REJSON_ERROR_JSONOBJECT_ERROR);
-            }
-            goto error;
-        }
-
-        // append it to the sub array
-        if (OBJ_OK != Node_ArrayAppend(sub, jo)) {
-            Node_Free(jo);
-            Node_Free(sub);
-            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_INSERT_SUBARRY);
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_INSERT_SUBARRY);
-            goto error;
-        }
+    Node *sub;
+    if (OBJ_OK != JSONArrParseValues(ctx, &argv[4], argc - 4, &sub)) goto error;
+
+    // a path that can match multiple values inserts to each of the arrays
+    if (multi) {
+        JSONArrInsertArg arg = {&argv[4], argc - 4, sub, index, 0};
+        JSONPathNode_ReplyWithAll(ctx, &jpn, jt->root, N_ARRAY, 1, JSONArrInsertOp, &arg);
+        Node_Free(arg.sub);
+        JSONPathNode_Free(&jpn);
+        return REDISMODULE_OK;
     }
 
     // insert the sub array to the target array
+    JSONPathNode_BeginWrite(&jpn, jt->root, 0);
     if (OBJ_OK != Node_ArrayInsert(jpn.n, index, sub)) {
         Node_Free(sub);
         RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_INSERT);
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_INSERT);
         goto error;
     }
+    JSONPathNode_EndWrite(&jpn, jt->root);
 
     RedisModule_ReplyWithLongLong(ctx, Node_Length(jpn.n));
 
@@ -1317,7 +2150,8 @@ int JSONArrAppend_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     if (PARSE_OK != NodeFromJSONPath(jt->root, argv[2], &jpn)) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
@@ -1325,61 +2159,40 @@ int JSONArrAppend_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
 
     // deal with path errors
-    if (E_OK != jpn.err) {
+    int multi = SearchPath_IsMulti(jpn.sp);
+    if (!multi && E_OK != jpn.err) {
         ReplyWithPathError(ctx, &jpn);
         goto error;
     }
 
     // the target must be an array
-    if (N_ARRAY != NODETYPE(jpn.n)) {
+    if (!multi && N_ARRAY != NODETYPE(jpn.n)) {
         ReplyWithPathTypeError(ctx, N_ARRAY, NODETYPE(jpn.n));
         goto error;
     }
 
     // make an array from the JSON values
-    Node *sub = NewArrayNode(argc - 3);
-    for (int i = 3; i < argc; i++) {
-        // JSON must be valid
-        size_t jsonlen;
-        const char *json = RedisModule_StringPtrLen(argv[i], &jsonlen);
-        if (!jsonlen) {
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_EMPTY_STRING);
-            Node_Free(sub);
-            goto error;
-        }
-
-        // create object from json
-        Object *jo = NULL;
-        char *jerr = NULL;
-        if (JSONOBJECT_OK != CreateNodeFromJSON(json, jsonlen, &jo, &jerr)) {
-            Node_Free(sub);
-            if (jerr) {
-                RedisModule_ReplyWithError(ctx, jerr);
-                free(jerr);
-            } else {
-                RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_JSONOBJECT_ERROR);
-                RedisModule_ReplyWithError(ctx, REJSON_ERROR_JSONOBJECT_ERROR);
-            }
-            goto error;
-        }
-
-        // append it to the sub array
-        if (OBJ_OK != Node_ArrayAppend(sub, jo)) {
-            Node_Free(jo);
-            Node_Free(sub);
-            RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_INSERT_SUBARRY);
-            RedisModule_ReplyWithError(ctx, REJSON_ERROR_INSERT_SUBARRY);
-            goto error;
-        }
+    Node *sub;
+    if (OBJ_OK != JSONArrParseValues(ctx, &argv[3], argc - 3, &sub)) goto error;
+
+    // a path that can match multiple values appends to each of the arrays
+    if (multi) {
+        JSONArrInsertArg arg = {&argv[3], argc - 3, sub, 0, 1};
+        JSONPathNode_ReplyWithAll(ctx, &jpn, jt->root, N_ARRAY, 1, JSONArrInsertOp, &arg);
+        Node_Free(arg.sub);
+        JSONPathNode_Free(&jpn);
+        return REDISMODULE_OK;
     }
 
     // insert the sub array to the target array
+    JSONPathNode_BeginWrite(&jpn, jt->root, 0);
     if (OBJ_OK != Node_ArrayInsert(jpn.n, Node_Length(jpn.n), sub)) {
         Node_Free(sub);
         RM_LOG_WARNING(ctx, "%s", REJSON_ERROR_INSERT);
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_INSERT);
         goto error;
     }
+    JSONPathNode_EndWrite(&jpn, jt->root);
 
     RedisModule_ReplyWithLongLong(ctx, Node_Length(jpn.n));
 
@@ -1403,6 +2216,18 @@ error:
  *
  * Reply: Integer, specifically the position of the scalar value in the array or -1 if unfound.
 */
+/* The arguments of JSON.ARRINDEX's operation on each of the arrays that a path matches. */
+typedef struct {
+    Node *jo;
+    int start;
+    int stop;
+} JSONArrIndexArg;
+
+static Node *JSONArrIndexOp(Node *n, void *arg) {
+    JSONArrIndexArg *a = arg;
+    return NewIntNode(Node_ArrayIndex(n, a->jo, a->start, a->stop));
+}
+
 int JSONArrIndex_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     // check args
     if ((argc < 4) || (argc > 6)) {
@@ -1420,21 +2245,23 @@ int JSONArrIndex_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
     JSONPathNode_t jpn;
+    Object *jo = NULL;
     if (PARSE_OK != NodeFromJSONPath(jt->root, argv[2], &jpn)) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
         return REDISMODULE_ERR;
     }
 
     // deal with path errors
-    if (E_OK != jpn.err) {
+    int multi = SearchPath_IsMulti(jpn.sp);
+    if (!multi && E_OK != jpn.err) {
         ReplyWithPathError(ctx, &jpn);
         goto error;
     }
 
     // verify that the target's type is an array
-    if (N_ARRAY != NODETYPE(jpn.n)) {
+    if (!multi && N_ARRAY != NODETYPE(jpn.n)) {
         ReplyWithPathTypeError(ctx, N_ARRAY, NODETYPE(jpn.n));
         goto error;
     }
@@ -1448,7 +2275,6 @@ int JSONArrIndex_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int
     }
 
     // create an object from json
-    Object *jo = NULL;
     char *jerr = NULL;
     if (JSONOBJECT_OK != CreateNodeFromJSON(json, jsonlen, &jo, &jerr)) {
         if (jerr) {
@@ -1476,16 +2302,56 @@ int JSONArrIndex_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int
         }
     }
 
-    RedisModule_ReplyWithLongLong(ctx, Node_ArrayIndex(jpn.n, jo, (int)start, (int)stop));
+    // a path that can match multiple values searches each of the arrays
+    if (multi) {
+        JSONArrIndexArg arg = {jo, (int)start, (int)stop};
+        JSONPathNode_ReplyWithAll(ctx, &jpn, jt->root, N_ARRAY, 0, JSONArrIndexOp, &arg);
+    } else {
+        RedisModule_ReplyWithLongLong(ctx, Node_ArrayIndex(jpn.n, jo, (int)start, (int)stop));
+    }
 
+    Node_Free(jo);
     JSONPathNode_Free(&jpn);
     return REDISMODULE_OK;
 
 error:
+    Node_Free(jo);
     JSONPathNode_Free(&jpn);
     return REDISMODULE_ERR;
 }
 
+/* Pops the array's item at index, which is relative to its end if negative and clamped to its
+ * range, and returns its serialization. The item is left in its place if it can't be serialized, in
+ * which case the serialization is empty. The array must not be empty. */
+static sds JSONArrPop(Node *arr, long long index) {
+    long long len = Node_Length(arr);
+
+    // convert negative index
+    if (index < 0) index = len + index;
+    if (index < 0) index = 0;
+    if (index >= len) index = len - 1;
+
+    // get and serialize the popped array item
+    JSONSerializeOpt jsopt = {0};
+    sds json = sdsempty();
+    Node scratch;
+    SerializeNodeToJSON(Node_ArrayItemPeek(arr, index, &scratch), &jsopt, &json);
+
+    // delete the item from the array
+    if (sdslen(json)) Node_ArrayDelRange(arr, index, 1);
+    return json;
+}
+
+static Node *JSONArrPopOp(Node *n, void *arg) {
+    if (!Node_Length(n)) return NULL;
+
+    sds json = JSONArrPop(n, *(long long *)arg);
+    Node *ret = sdslen(json) ? NewStringNode(json, sdslen(json)) : NULL;
+    if (!ret) RM_LOG_WARNING(NULL, "%s", REJSON_ERROR_SERIALIZE);
+    sdsfree(json);
+    return ret;
+}
+
 /**
 * JSON.ARRPOP <key> [path [index]]
 * Remove and return element from the index in the array.
@@ -1513,7 +2379,8 @@ int JSONArrPop_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int a
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     RedisModuleString *spath =
         (argc > 2 ? argv[2] : RedisModule_CreateString(ctx, OBJECT_ROOT_PATH, 1));
@@ -1523,20 +2390,20 @@ int JSONArrPop_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int a
     }
 
     // deal with path errors
-    if (E_OK != jpn.err) {
+    int multi = SearchPath_IsMulti(jpn.sp);
+    if (!multi && E_OK != jpn.err) {
         ReplyWithPathError(ctx, &jpn);
         goto error;
     }
 
     // verify that the target's type is an array
-    if (N_ARRAY != NODETYPE(jpn.n)) {
+    if (!multi && N_ARRAY != NODETYPE(jpn.n)) {
         ReplyWithPathTypeError(ctx, N_ARRAY, NODETYPE(jpn.n));
         goto error;
     }
 
     // nothing to do
-    long long len = Node_Length(jpn.n);
-    if (!len) {
+    if (!multi && !Node_Length(jpn.n)) {
         RedisModule_ReplyWithNull(ctx);
         goto ok;
     }
@@ -1548,17 +2415,16 @@ int JSONArrPop_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int a
         goto error;
     }
 
-    // convert negative index
-    if (index < 0) index = len + index;
-    if (index < 0) index = 0;
-    if (index >= len) index = len - 1;
+    // a path that can match multiple values pops from each of the arrays
+    if (multi) {
+        JSONPathNode_ReplyWithAll(ctx, &jpn, jt->root, N_ARRAY, 1, JSONArrPopOp, &index);
+        goto ok;
+    }
 
-    // get and serialize the popped array item
-    JSONSerializeOpt jsopt = {0};
-    sds json = sdsempty();
-    Node *item;
-    Node_ArrayItem(jpn.n, index, &item);
-    SerializeNodeToJSON(item, &jsopt, &json);
+    // pop the array item
+    JSONPathNode_BeginWrite(&jpn, jt->root, 0);
+    sds json = JSONArrPop(jpn.n, index);
+    JSONPathNode_EndWrite(&jpn, jt->root);
 
     // check whether serialization had succeeded
     if (!sdslen(json)) {
@@ -1568,9 +2434,6 @@ int JSONArrPop_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int a
         goto error;
     }
 
-    // delete the item from the array
-    Node_ArrayDelRange(jpn.n, index, 1);
-
     // reply with the serialization
     RedisModule_ReplyWithStringBuffer(ctx, json, sdslen(json));
     sdsfree(json);
@@ -1584,6 +2447,37 @@ error:
     return REDISMODULE_ERR;
 }
 
+/* Trims the array so that it only has the items from start to stop, both inclusive and relative to
+ * its end if negative. */
+static void JSONArrTrim(Node *arr, long long start, long long stop) {
+    long long left, right;
+    long long len = (long long)Node_Length(arr);
+
+    // convert negative indexes
+    if (start < 0) start = len + start;
+    if (stop < 0) stop = len + stop;
+
+    if (start < 0) start = 0;            // start at the beginning
+    if (start > stop || start >= len) {  // empty the array
+        left = len;
+        right = 0;
+    } else {  // set the boundries
+        left = start;
+        if (stop >= len) stop = len - 1;
+        right = len - stop - 1;
+    }
+
+    // trim the array
+    Node_ArrayDelRange(arr, 0, left);
+    Node_ArrayDelRange(arr, -right, right);
+}
+
+static Node *JSONArrTrimOp(Node *n, void *arg) {
+    long long *range = arg;
+    JSONArrTrim(n, range[0], range[1]);
+    return NewIntNode(Node_Length(n));
+}
+
 /**
 * JSON.ARRTRIM <key> <path> <start> <stop>
 * Trim an array so that it contains only the specified inclusive range of elements.
@@ -1612,7 +2506,8 @@ int JSONArrTrim_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int
     }
 
     // validate path
-    JSONType_t *jt = RedisModule_ModuleTypeGetValue(key);
+    JSONType_t *jt = JSONType_GetValue(key);
+    JSONType_Touch(jt);
     JSONPathNode_t jpn;
     if (PARSE_OK != NodeFromJSONPath(jt->root, argv[2], &jpn)) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_PARSE_PATH);
@@ -1620,49 +2515,39 @@ int JSONArrTrim_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int
     }
 
     // deal with path errors
-    if (E_OK != jpn.err) {
+    int multi = SearchPath_IsMulti(jpn.sp);
+    if (!multi && E_OK != jpn.err) {
         ReplyWithPathError(ctx, &jpn);
         goto error;
     }
 
     // verify that the target's type is an array
-    if (N_ARRAY != NODETYPE(jpn.n)) {
+    if (!multi && N_ARRAY != NODETYPE(jpn.n)) {
         ReplyWithPathTypeError(ctx, N_ARRAY, NODETYPE(jpn.n));
         goto error;
     }
 
     // get start & stop
-    long long start, stop, left, right;
-    long long len = (long long)Node_Length(jpn.n);
-    if (REDISMODULE_OK != RedisModule_StringToLongLong(argv[3], &start)) {
+    long long range[2];
+    if (REDISMODULE_OK != RedisModule_StringToLongLong(argv[3], &range[0])) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_INDEX_INVALID);
         goto error;
     }
-    if (REDISMODULE_OK != RedisModule_StringToLongLong(argv[4], &stop)) {
+    if (REDISMODULE_OK != RedisModule_StringToLongLong(argv[4], &range[1])) {
         RedisModule_ReplyWithError(ctx, REJSON_ERROR_INDEX_INVALID);
         goto error;
     }
 
-    // convert negative indexes
-    if (start < 0) start = len + start;
-    if (stop < 0) stop = len + stop;
-
-    if (start < 0) start = 0;            // start at the beginning
-    if (start > stop || start >= len) {  // empty the array
-        left = len;
-        right = 0;
-    } else {  // set the boundries
-        left = start;
-        if (stop >= len) stop = len - 1;
-        right = len - stop - 1;
+    // trim the array, or each of the arrays that a path with multiple values matches
+    if (multi) {
+        JSONPathNode_ReplyWithAll(ctx, &jpn, jt->root, N_ARRAY, 1, JSONArrTrimOp, range);
+    } else {
+        JSONPathNode_BeginWrite(&jpn, jt->root, 0);
+        JSONArrTrim(jpn.n, range[0], range[1]);
+        JSONPathNode_EndWrite(&jpn, jt->root);
+        RedisModule_ReplyWithLongLong(ctx, (long long)Node_Length(jpn.n));
     }
 
-    // trim the array
-    Node_ArrayDelRange(jpn.n, 0, left);
-    Node_ArrayDelRange(jpn.n, -right, right);
-
-    RedisModule_ReplyWithLongLong(ctx, (long long)Node_Length(jpn.n));
-
     JSONPathNode_Free(&jpn);
     return REDISMODULE_OK;
 
@@ -1671,12 +2556,23 @@ error:
     return REDISMODULE_ERR;
 }
 
-int RedisModule_OnLoad(RedisModuleCtx *ctx) __attribute__((visibility("default")));
-int RedisModule_OnLoad(RedisModuleCtx *ctx) {
+int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
+    __attribute__((visibility("default")));
+int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     // Register the module
     if (RedisModule_Init(ctx, RLMODULE_NAME, 1, REDISMODULE_APIVER_1) == REDISMODULE_ERR)
         return REDISMODULE_ERR;
 
+    // Configure it
+    if (RejsonConfig_Load(ctx, argv, argc) == REDISMODULE_ERR) return REDISMODULE_ERR;
+    jsonObjectParser = rejsonConfig.parser;
+    if (rejsonConfig.replyCacheSize) {
+        replyCache = NewLRUCache(rejsonConfig.replyCacheSize, ReplyCache_FreeValue);
+    }
+    if (rejsonConfig.pathCacheSize) {
+        pathCache = NewLRUCache(rejsonConfig.pathCacheSize, SharedPath_Release);
+    }
+
     // Register the JSON data type
     RedisModuleTypeMethods tm = { .version = REDISMODULE_TYPE_METHOD_VERSION,
                                   .rdb_load = JSONTypeRdbLoad,
@@ -1705,6 +2601,10 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx) {
                                   1) == REDISMODULE_ERR)
         return REDISMODULE_ERR;
 
+    if (RedisModule_CreateCommand(ctx, "json.mset", JSONMSet_RedisCommand,
+                                  "write deny-oom getkeys-api", 1, -1, 3) == REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
     if (RedisModule_CreateCommand(ctx, "json.get", JSONGet_RedisCommand, "readonly", 1, 1, 1) ==
         REDISMODULE_ERR)
         return REDISMODULE_ERR;
@@ -1713,6 +2613,10 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx) {
                                   1, 1, 1) == REDISMODULE_ERR)
         return REDISMODULE_ERR;
 
+    if (RedisModule_CreateCommand(ctx, "json.mgetpaths", JSONMGetPaths_RedisCommand,
+                                  "readonly getkeys-api", 1, 1, 1) == REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
     if (RedisModule_CreateCommand(ctx, "json.del", JSONDel_RedisCommand, "write", 1, 1, 1) ==
         REDISMODULE_ERR)
         return REDISMODULE_ERR;
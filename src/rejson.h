@@ -27,6 +27,8 @@
 #include "json_path.h"
 #include "object.h"
 #include "json_type.h"
+#include "lru_cache.h"
+#include "rejson_config.h"
 #include "redismodule.h"
 
 #define RLMODULE_NAME "ReJSON"
@@ -42,6 +44,7 @@
 #define REJSON_ERROR_PATH_NANTYPE "ERR wrong type of path value - expected a number but found %s"
 #define REJSON_ERROR_PATH_WRONGTYPE "ERR wrong type of path value - expected %s but found %s"
 #define REJSON_ERROR_PATH_NONTERMINAL_KEY "ERR missing key at non-terminal path level"
+#define REJSON_ERROR_PATH_OVERLAP "ERR path goes through a value that is set by a preceding path"
 #define REJSON_ERROR_INDEX_INVALID "ERR array index must be an integer"
 #define REJSON_ERROR_INDEX_OUTOFRANGE "ERR index out of range"
 #define REJSON_ERROR_VALUE_NAN "ERR value is not a number type"
@@ -0,0 +1,85 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <logging.h>
+#include <string.h>
+#include "rejson_config.h"
+
+RejsonConfig rejsonConfig = {.aofChunkSize = REJSON_DEFAULT_AOF_CHUNK_SIZE,
+                             .replyCacheSize = REJSON_DEFAULT_REPLY_CACHE_SIZE,
+                             .pathCacheSize = REJSON_DEFAULT_PATH_CACHE_SIZE,
+                             .lazyFreeThreshold = REJSON_DEFAULT_LAZY_FREE_THRESHOLD,
+                             .loadThreads = REJSON_DEFAULT_LOAD_THREADS,
+                             .parser = REJSON_DEFAULT_PARSER};
+
+/* A size argument must be an integer that's at least `min`. */
+static int _ParseSize(RedisModuleString *arg, long long min, size_t *val) {
+    long long ll;
+    if (REDISMODULE_OK != RedisModule_StringToLongLong(arg, &ll) || ll < min) {
+        return REDISMODULE_ERR;
+    }
+    *val = (size_t)ll;
+    return REDISMODULE_OK;
+}
+
+/* A parser argument must name one of the engines. */
+static int _ParseParser(RedisModuleString *arg, JSONObjectParser *val) {
+    const char *name = RedisModule_StringPtrLen(arg, NULL);
+    if (!strcasecmp("INDEXED", name)) {
+        *val = JSONOBJECT_PARSER_INDEXED;
+    } else if (!strcasecmp("JSONSL", name)) {
+        *val = JSONOBJECT_PARSER_JSONSL;
+    } else {
+        return REDISMODULE_ERR;
+    }
+    return REDISMODULE_OK;
+}
+
+int RejsonConfig_Load(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc % 2) {
+        RM_LOG_WARNING(ctx, "Module arguments must be given as name and value pairs");
+        return REDISMODULE_ERR;
+    }
+
+    for (int i = 0; i < argc; i += 2) {
+        const char *name = RedisModule_StringPtrLen(argv[i], NULL);
+        int rc;
+        if (!strcasecmp("AOF_CHUNK_SIZE", name)) {
+            rc = _ParseSize(argv[i + 1], 1, &rejsonConfig.aofChunkSize);
+        } else if (!strcasecmp("REPLY_CACHE_SIZE", name)) {
+            rc = _ParseSize(argv[i + 1], 0, &rejsonConfig.replyCacheSize);
+        } else if (!strcasecmp("PATH_CACHE_SIZE", name)) {
+            rc = _ParseSize(argv[i + 1], 0, &rejsonConfig.pathCacheSize);
+        } else if (!strcasecmp("LAZY_FREE_THRESHOLD", name)) {
+            rc = _ParseSize(argv[i + 1], 0, &rejsonConfig.lazyFreeThreshold);
+        } else if (!strcasecmp("LOAD_THREADS", name)) {
+            rc = _ParseSize(argv[i + 1], 0, &rejsonConfig.loadThreads);
+        } else if (!strcasecmp("PARSER", name)) {
+            rc = _ParseParser(argv[i + 1], &rejsonConfig.parser);
+        } else {
+            RM_LOG_WARNING(ctx, "Unknown module argument '%s'", name);
+            return REDISMODULE_ERR;
+        }
+
+        if (REDISMODULE_OK != rc) {
+            RM_LOG_WARNING(ctx, "Invalid value for module argument '%s'", name);
+            return REDISMODULE_ERR;
+        }
+    }
+
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,53 @@
+/*
+* Copyright (C) 2016 Redis Labs
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __REJSON_CONFIG_H__
+#define __REJSON_CONFIG_H__
+
+#include <stddef.h>
+#include "json_object.h"
+#include "redismodule.h"
+
+/* Default values of the module's configuration */
+#define REJSON_DEFAULT_AOF_CHUNK_SIZE (16 * 1024 * 1024)
+#define REJSON_DEFAULT_REPLY_CACHE_SIZE (16 * 1024 * 1024)
+#define REJSON_DEFAULT_PATH_CACHE_SIZE (1024 * 1024)
+#define REJSON_DEFAULT_LAZY_FREE_THRESHOLD 64
+#define REJSON_DEFAULT_LOAD_THREADS 4
+#define REJSON_DEFAULT_PARSER JSONOBJECT_PARSER_JSONSL
+
+/* The module's configuration, set with arguments when the module is loaded. */
+typedef struct {
+    size_t aofChunkSize;       // AOF_CHUNK_SIZE: the maximal size of a value in a rewritten AOF
+    size_t replyCacheSize;     // REPLY_CACHE_SIZE: the JSON.GET reply cache's size, 0 disables it
+    size_t pathCacheSize;      // PATH_CACHE_SIZE: the parsed path cache's size, 0 disables it
+    size_t lazyFreeThreshold;  // LAZY_FREE_THRESHOLD: the effort above which documents are freed
+                               // on a background thread, 0 frees them immediately
+    size_t loadThreads;        // LOAD_THREADS: the number of threads that unpack documents that
+                               // are loaded from RDB files, 0 unpacks them on the main thread
+    JSONObjectParser parser;   // PARSER: the engine that parses JSON text, INDEXED or JSONSL
+} RejsonConfig;
+
+extern RejsonConfig rejsonConfig;
+
+/**
+* Sets the configuration from the module's load time arguments, which are given as name and value
+* pairs. Returns REDISMODULE_ERR and logs the reason if the arguments are invalid.
+*/
+int RejsonConfig_Load(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
+
+#endif
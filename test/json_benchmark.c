@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <time.h>
+#include "../src/json_object.h"
+#include "../deps/jsonsl/perf/documents.h"
+
+/* Microbenchmarks for the JSON parser and serializer, run with a list of JSON files (e.g.
+ * test/files/pass-*). The parser is also benchmarked with jsonsl's performance test documents. */
+
+typedef struct {
+    const char *name;
+    char *json;
+    size_t len;
+    Node *node;
+} benchFile;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int readFile(const char *name, benchFile *f) {
+    FILE *fp = fopen(name, "rb");
+    if (!fp) return 0;
+    fseek(fp, 0, SEEK_END);
+    f->len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    f->json = malloc(f->len + 1);
+    f->len = fread(f->json, 1, f->len, fp);
+    f->json[f->len] = '\0';
+    fclose(fp);
+    f->name = name;
+
+    char *err = NULL;
+    if (JSONOBJECT_OK != CreateNodeFromJSON(f->json, f->len, &f->node, &err)) {
+        printf("%s: %s\n", name, err ? err : "ERR unknown");
+        free(err);
+        return 0;
+    }
+    return 1;
+}
+
+static void report(const char *what, size_t bytes, double secs) {
+    printf("  %-28s %10.1f MB/s\n", what, bytes / secs / (1024 * 1024));
+}
+
+/* === string escaping === */
+
+/* The byte at a time escaping that the serializer used before it scanned for clean runs. */
+static sds referenceEscape(sds buf, const char *p, size_t len) {
+    buf = sdsMakeRoomFor(buf, len + 2);
+    buf = sdscatlen(buf, "\"", 1);
+    while (len--) {
+        switch (*p) {
+            case '"':
+            case '\\':
+                buf = sdscatprintf(buf, "\\%c", *p);
+                break;
+            case '/':
+                buf = sdscatlen(buf, "\\/", 2);
+                break;
+            case '\b':
+                buf = sdscatlen(buf, "\\b", 2);
+                break;
+            case '\f':
+                buf = sdscatlen(buf, "\\f", 2);
+                break;
+            case '\n':
+                buf = sdscatlen(buf, "\\n", 2);
+                break;
+            case '\r':
+                buf = sdscatlen(buf, "\\r", 2);
+                break;
+            case '\t':
+                buf = sdscatlen(buf, "\\t", 2);
+                break;
+            default:
+                if ((unsigned char)*p > 31 && isprint(*p))
+                    buf = sdscatprintf(buf, "%c", *p);
+                else
+                    buf = sdscatprintf(buf, "\\u%04x", (unsigned char)*p);
+                break;
+        }
+        p++;
+    }
+    return sdscatlen(buf, "\"", 1);
+}
+
+static void collectStrings(Node *n, void *ctx) {
+    if (n && N_STRING == n->type) {
+        Node_ArrayAppend((Node *)ctx, NewStringNode(NODE_STRING_DATA(n), NODE_STRING_LEN(n)));
+    }
+}
+
+/* Serializes an array of all the strings in the files, with the reference and current escaping. */
+static int benchEscape(benchFile *files, int nfiles, int iterations) {
+    Node *strings = NewArrayNode(1);
+    NodeSerializerOpt nso = {.fBegin = collectStrings, .xBegin = N_STRING};
+    for (int i = 0; i < nfiles; i++) Node_Serializer(files[i].node, &nso, strings);
+
+    JSONSerializeOpt opt = {"", "", ""};
+    sds ref = sdsempty(), cur = sdsempty();
+    double start = now();
+    for (int i = 0; i < iterations; i++) {
+        sdsclear(ref);
+        ref = sdscatlen(ref, "[", 1);
+        for (uint32_t j = 0; j < strings->value.arrval.len; j++) {
+            Node *s = strings->value.arrval.entries[j];
+            if (j) ref = sdscatlen(ref, ",", 1);
+            ref = referenceEscape(ref, NODE_STRING_DATA(s), NODE_STRING_LEN(s));
+        }
+        ref = sdscatlen(ref, "]", 1);
+    }
+    double refsecs = now() - start;
+
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+        sdsclear(cur);
+        SerializeNodeToJSON(strings, &opt, &cur);
+    }
+    double cursecs = now() - start;
+
+    int ok = !strcmp(ref, cur);
+    printf("string escaping (%u strings, %zu bytes serialized)%s\n", strings->value.arrval.len,
+           sdslen(cur), ok ? "" : " - OUTPUT MISMATCH");
+    report("reference", sdslen(ref) * iterations, refsecs);
+    report("current", sdslen(cur) * iterations, cursecs);
+
+    sdsfree(ref);
+    sdsfree(cur);
+    Node_Free(strings);
+    return ok;
+}
+
+/* === parsing === */
+
+/* Parses the texts with an engine, returning a hash of their serializations. */
+static size_t parseAll(JSONObjectParser parser, char **texts, size_t *lens, int ntexts,
+                       int iterations, double *secs) {
+    JSONSerializeOpt opt = {"", "", ""};
+    size_t hash = 0;
+    Node *n;
+
+    jsonObjectParser = parser;
+    double start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < ntexts; j++) {
+            if (JSONOBJECT_OK == CreateNodeFromJSON(texts[j], lens[j], &n, NULL)) Node_Free(n);
+        }
+    }
+    *secs = now() - start;
+
+    // the serializations tell whether the engines created the same objects
+    for (int j = 0; j < ntexts; j++) {
+        if (JSONOBJECT_OK != CreateNodeFromJSON(texts[j], lens[j], &n, NULL)) continue;
+        sds json = sdsempty();
+        SerializeNodeToJSON(n, &opt, &json);
+        for (size_t k = 0; k < sdslen(json); k++) hash = hash * 31 + (unsigned char)json[k];
+        sdsfree(json);
+        Node_Free(n);
+    }
+    return hash;
+}
+
+/* Parses the texts with jsonsl and with the indexed parser. */
+static int benchParseTexts(const char *what, char **texts, size_t *lens, int ntexts,
+                           int iterations) {
+    size_t bytes = 0;
+    double jsonslsecs, indexedsecs;
+    for (int j = 0; j < ntexts; j++) bytes += lens[j] * iterations;
+
+    size_t jsonsl =
+        parseAll(JSONOBJECT_PARSER_JSONSL, texts, lens, ntexts, iterations, &jsonslsecs);
+    size_t indexed =
+        parseAll(JSONOBJECT_PARSER_INDEXED, texts, lens, ntexts, iterations, &indexedsecs);
+    jsonObjectParser = JSONOBJECT_PARSER_JSONSL;
+
+    int ok = jsonsl == indexed;
+    printf("%s (%d texts, %zu bytes)%s\n", what, ntexts, bytes / iterations,
+           ok ? "" : " - OUTPUT MISMATCH");
+    report("jsonsl", bytes, jsonslsecs);
+    report("indexed", bytes, indexedsecs);
+    return ok;
+}
+
+static int benchParse(benchFile *files, int nfiles, int iterations) {
+    char **texts = calloc(nfiles, sizeof(char *));
+    size_t *lens = calloc(nfiles, sizeof(size_t));
+    for (int i = 0; i < nfiles; i++) {
+        texts[i] = files[i].json;
+        lens[i] = files[i].len;
+    }
+    int ok = benchParseTexts("file parsing", texts, lens, nfiles, iterations);
+    free(texts);
+    free(lens);
+
+    // jsonsl's documents are split into chunks that are joined for parsing
+    int ndocs = num_docs();
+    texts = calloc(ndocs, sizeof(char *));
+    lens = calloc(ndocs, sizeof(size_t));
+    for (int i = 0; i < ndocs; i++) {
+        texts[i] = malloc(doc_size(i));
+        for (const char **chunk = get_doc(i); *chunk; chunk++) {
+            size_t len = strlen(*chunk);
+            memcpy(&texts[i][lens[i]], *chunk, len);
+            lens[i] += len;
+        }
+    }
+    ok &= benchParseTexts("jsonsl document parsing", texts, lens, ndocs, iterations);
+    for (int i = 0; i < ndocs; i++) free(texts[i]);
+    free(texts);
+    free(lens);
+    return ok;
+}
+
+/* Parses tiny values, which take about as long to set the parser up for as to parse. */
+static void benchTinyParse(int iterations) {
+    const char *values[] = {"1", "-2.5", "true", "null", "\"foo\"", "[]", "[1,2,3]", "{\"a\":1}"};
+    int nvalues = sizeof(values) / sizeof(values[0]);
+    JSONObjectParser parsers[] = {JSONOBJECT_PARSER_JSONSL, JSONOBJECT_PARSER_INDEXED};
+    const char *names[] = {"jsonsl", "indexed"};
+    Node *n;
+
+    printf("tiny value parsing (%d values)\n", nvalues);
+    for (int p = 0; p < 2; p++) {
+        jsonObjectParser = parsers[p];
+        double start = now();
+        for (int i = 0; i < iterations * 1000; i++) {
+            for (int j = 0; j < nvalues; j++) {
+                if (JSONOBJECT_OK == CreateNodeFromJSON(values[j], strlen(values[j]), &n, NULL)) {
+                    Node_Free(n);
+                }
+            }
+        }
+        double secs = now() - start;
+        printf("  %-28s %10.1f ns/value\n", names[p], secs * 1e9 / (iterations * 1000.0 * nvalues));
+    }
+    jsonObjectParser = JSONOBJECT_PARSER_JSONSL;
+}
+
+/* === numbers === */
+
+/* Collects the numbers, and the strings that hold numbers like pass-jsonsl-yahoo2's coordinates. */
+static void collectNumbers(Node *n, void *ctx) {
+    double d;
+    if (!n) return;
+    if (N_NUMBER == n->type) {
+        Node_ArrayAppend((Node *)ctx, NewDoubleNode(n->value.numval));
+    } else if (N_STRING == n->type && NODE_STRING_LEN(n) &&
+               JSONNUMBER_OK == JSONNumber_ToDouble(NODE_STRING_DATA(n), NODE_STRING_LEN(n), &d)) {
+        Node_ArrayAppend((Node *)ctx, NewDoubleNode(d));
+    }
+}
+
+/* Formats and parses the numbers in the files with the C library and with json_number's routines.
+ * The reference format is the "%.17g" that round-trips, rather than the serializer's former "%g"
+ * that lost digits, and both parsers read the shortest formatting. */
+static int benchNumbers(benchFile *files, int nfiles, int iterations) {
+    Node *nums = NewArrayNode(1);
+    NodeSerializerOpt nso = {.fBegin = collectNumbers, .xBegin = N_NUMBER | N_STRING};
+    for (int i = 0; i < nfiles; i++) Node_Serializer(files[i].node, &nso, nums);
+
+    uint32_t count = nums->value.arrval.len;
+    Node **entries = nums->value.arrval.entries;
+    char(*texts)[JSONNUMBER_MAX_LENGTH + 1] = calloc(count, JSONNUMBER_MAX_LENGTH + 1);
+    size_t *lens = calloc(count, sizeof(size_t));
+    char ref[JSONNUMBER_MAX_LENGTH];
+    size_t bytes = 0;
+    double d, sum = 0, secs[4];
+    int ok = 1;
+
+    double start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (uint32_t j = 0; j < count; j++) {
+            sum += snprintf(ref, sizeof(ref), "%.17g", entries[j]->value.numval);
+        }
+    }
+    secs[0] = now() - start;
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (uint32_t j = 0; j < count; j++) {
+            lens[j] = JSONNumber_FormatDouble(texts[j], entries[j]->value.numval);
+        }
+    }
+    secs[1] = now() - start;
+
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (uint32_t j = 0; j < count; j++) sum += strtod(texts[j], NULL);
+    }
+    secs[2] = now() - start;
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (uint32_t j = 0; j < count; j++) {
+            JSONNumber_ToDouble(texts[j], lens[j], &d);
+            sum += d;
+        }
+    }
+    secs[3] = now() - start;
+
+    // the current routines round-trip exactly
+    for (uint32_t j = 0; j < count; j++) {
+        bytes += lens[j];
+        ok &= JSONNUMBER_OK == JSONNumber_ToDouble(texts[j], lens[j], &d) &&
+              d == entries[j]->value.numval;
+    }
+
+    const char *names[] = {"snprintf %.17g", "JSONNumber_FormatDouble", "strtod",
+                           "JSONNumber_ToDouble"};
+    printf("number formatting and parsing (%u numbers, %zu bytes, checksum %g)%s\n", count, bytes,
+           sum, ok ? "" : " - ROUND TRIP MISMATCH");
+    for (int i = 0; i < 4 && count; i++) {
+        printf("  %-28s %10.1f ns/number\n", names[i], secs[i] * 1e9 / count / iterations);
+    }
+
+    free(texts);
+    free(lens);
+    Node_Free(nums);
+    return ok;
+}
+
+/* === whole documents === */
+
+static void benchSerialize(benchFile *files, int nfiles, int iterations) {
+    JSONSerializeOpt opt = {"", "", ""};
+    size_t bytes = 0;
+    sds json = sdsempty();
+    double start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < nfiles; j++) {
+            sdsclear(json);
+            SerializeNodeToJSON(files[j].node, &opt, &json);
+            bytes += sdslen(json);
+        }
+    }
+    double secs = now() - start;
+
+    size_t sizedbytes = 0;
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < nfiles; j++) {
+            sds sized = SerializeNodeToJSONSized(files[j].node, &opt);
+            sizedbytes += sdslen(sized);
+            sdsfree(sized);
+        }
+    }
+    double sizedsecs = now() - start;
+
+    printf("document serialization (%d files)\n", nfiles);
+    report("SerializeNodeToJSON", bytes, secs);
+    report("SerializeNodeToJSONSized", sizedbytes, sizedsecs);
+    sdsfree(json);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: %s iterations file [file ...]\n", argv[0]);
+        exit(1);
+    }
+
+    int iterations = atoi(argv[1]);
+    int nfiles = 0;
+    benchFile *files = calloc(argc - 2, sizeof(benchFile));
+    for (int i = 2; i < argc; i++) {
+        if (readFile(argv[i], &files[nfiles])) nfiles++;
+    }
+
+    int ok = benchEscape(files, nfiles, iterations);
+    benchSerialize(files, nfiles, iterations);
+    ok &= benchNumbers(files, nfiles, iterations);
+    ok &= benchParse(files, nfiles, iterations);
+    benchTinyParse(iterations);
+
+    for (int i = 0; i < nfiles; i++) {
+        Node_Free(files[i].node);
+        free(files[i].json);
+    }
+    free(files);
+    return !ok;
+}
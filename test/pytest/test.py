@@ -3,6 +3,12 @@ import redis
 import unittest
 import json
 import os
+import time
+import glob
+import shutil
+import socket
+import subprocess
+import tempfile
 
 # Path to module
 module_path = os.environ['REDIS_MODULE_PATH']
@@ -22,6 +28,29 @@ json_ignore = [
     'pass-jsonsl-yelp.json',        # float percision
 ]
 
+def startServer(dirname, *args):
+    """Starts a server with the module in dirname, returning its process and a connection"""
+    sock = socket.socket()
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    cmd = [redis_path, '--port', str(port), '--dir', dirname, '--save', '',
+           '--loadmodule', module_path] + list(args)
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    r = redis.Redis(port=port, decode_responses=True)
+    for _ in range(100):
+        try:
+            r.ping()
+            return proc, r
+        except redis.exceptions.ConnectionError:
+            time.sleep(0.05)
+    proc.kill()
+    raise RuntimeError('redis-server did not start')
+
+def stopServer(proc, r):
+    r.shutdown(nosave=True)
+    proc.wait()
+
 # Some basic documents to use in the tests
 docs = {
     'simple': {
@@ -127,6 +156,49 @@ class ReJSONTestCase(ModuleTestCase(module_path=module_path, redis_path=redis_pa
                 self.assertEqual(str(type(data)), '<type \'{}\'>'.format(k), k)
                 self.assertEqual(data, v)
 
+    def testMSetCommand(self):
+        """Test JSON.MSET command"""
+
+        with self.redis() as r:
+            r.delete('test', 'test2', 'test3')
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '{"a":{"b":1},"arr":[1,2]}'))
+
+            # values are set in order, in new and existing keys
+            self.assertOk(r.execute_command('JSON.MSET', 'test', '.a.c', '2', 'test', '.arr[-1]', '"x"',
+                                            'test2', '.', '[]', 'test2', '.', '{"k":null}'))
+            self.assertEqual({'a': {'b': 1, 'c': 2}, 'arr': [1, 'x']}, json.loads(r.execute_command('JSON.GET', 'test')))
+            self.assertEqual({'k': None}, json.loads(r.execute_command('JSON.GET', 'test2')))
+
+            # nothing is set when any of the values is invalid
+            r.set('test3', 'bar')
+            bad = [['test3', '.', '{}'],
+                   ['test', '.a', '{"missing":'],
+                   ['test', '.x.y', '1'],
+                   ['test4', '.a', '1'],
+                   ['test', '.a', '{}', 'test', '.a.b', '2'],
+                   ['test', '.', '{}', 'test', '.arr', '[]']]
+            for args in bad:
+                with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                    r.execute_command('JSON.MSET', 'test', '.a.b', '3', *args)
+                self.assertEqual(1, json.loads(r.execute_command('JSON.GET', 'test', '.a.b')))
+            self.assertFalse(r.exists('test4'))
+            with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                r.execute_command('JSON.MSET', 'test', '.a.b')
+            with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                r.execute_command('JSON.MSET', 'test', '.a.b', '3', 'test2', '.')
+            with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                r.execute_command('JSON.MSET', 'test', '.a.b', '3', 'YY')
+
+            # the condition applies to every value, and none is set unless all meet it
+            self.assertIsNone(r.execute_command('JSON.MSET', 'test', '.n', '1', 'test2', '.k', '1', 'NX'))
+            self.assertIsNone(r.execute_command('JSON.MSET', 'test', '.a.b', '3', 'test4', '.', '1', 'XX'))
+            self.assertFalse(r.exists('test4'))
+            self.assertOk(r.execute_command('JSON.MSET', 'test', '.n', '1', 'test4', '.', '1', 'NX'))
+            self.assertOk(r.execute_command('JSON.MSET', 'test', '.n', '2', 'test4', '.', '2', 'XX'))
+            self.assertEqual('2', r.execute_command('JSON.GET', 'test', '.n'))
+            self.assertEqual('2', r.execute_command('JSON.GET', 'test4'))
+            r.delete('test', 'test2', 'test3', 'test4')
+
     def testSetGetWholeBasicDocumentShouldBeEqual(self):
         """Test basic JSON.GET/JSON.SET"""
 
@@ -228,6 +300,168 @@ class ReJSONTestCase(ModuleTestCase(module_path=module_path, redis_path=redis_pa
             self.assertTrue(json.loads(raw[1]))
             self.assertEqual(raw[2], None)
 
+            # Test an MGET of several paths
+            raw = r.execute_command('JSON.MGETPATHS', 3, '.bool', '.', '.foo', 'test', 'foo', 'doc:0')
+            self.assertEqual(len(raw), 3)
+            self.assertEqual(['false', '{"bool":false}', None], raw[0])
+            self.assertEqual([None, None, None], raw[1])
+            self.assertEqual('true', raw[2][0])
+            self.assertDictEqual(json.loads(raw[2][1]), docs['basic'])
+            self.assertEqual(None, raw[2][2])
+            self.assertEqual([['false']], r.execute_command('JSON.MGETPATHS', 1, 'bool', 'test'))
+            self.assertEqual([], r.execute_command('JSON.MGETPATHS', 1, '.'))
+            for count in [0, -1, 3, 'x']:
+                with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                    r.execute_command('JSON.MGETPATHS', count, '.', 'test')
+            with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                r.execute_command('JSON.MGETPATHS', 2, '.', '.foo[', 'test')
+
+            # a path or keys named like the arguments of JSON.MGETPATHS are just that
+            r.delete('paths', '2', 'x')
+            self.assertOk(r.execute_command('JSON.SET', 'paths', '.', '{"paths":"p"}'))
+            self.assertOk(r.execute_command('JSON.SET', '2', '.', '{"paths":2}'))
+            self.assertEqual(['2', None], r.execute_command('JSON.MGET', 'paths', '2', 'x'))
+            self.assertEqual(['{"paths":"p"}', '{"paths":2}', None],
+                             r.execute_command('JSON.MGET', '.', 'paths', '2', 'x'))
+            r.delete('paths', '2')
+
+    def testWildcardPaths(self):
+        """Test getting the values that wildcard and deep scan paths match"""
+
+        with self.redis() as r:
+            r.delete('test')
+            doc = {'items': [{'price': 1, 'name': 'a'}, {'price': 2.5}, {'name': 'c'}],
+                   'nums': list(range(40)), 'info': {'price': 3, 'tags': {'price': 4}}}
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', json.dumps(doc)))
+
+            get = lambda *paths: json.loads(r.execute_command('JSON.GET', 'test', *paths))
+            self.assertEqual([1, 2.5], get('items[*].price'))
+            self.assertEqual([1, 2.5], get('.items.*.price'))
+            self.assertEqual(['a', 'c'], get('items..name'))
+            self.assertEqual([1, 2.5, 3, 4], get('..price'))
+            self.assertEqual(list(range(40)), get('nums[*]'))
+            self.assertEqual([39], get('..nums[-1]'))
+            self.assertEqual([], get('items[*].nope'))
+            self.assertEqual([doc['items'], doc['nums'], doc['info']], get('*'))
+            self.assertDictEqual({'items[*].price': [1, 2.5], 'info.price': 3},
+                                 get('items[*].price', 'info.price'))
+
+            # the values are read in place, and a packed array isn't unpacked
+            size = r.execute_command('JSON.DEBUG', 'MEMORY', 'test')
+            self.assertEqual(list(range(40)), get('..nums.*'))
+            self.assertEqual(size, r.execute_command('JSON.DEBUG', 'MEMORY', 'test'))
+
+            # every key gets its own array of matches
+            r.delete('test2')
+            self.assertOk(r.execute_command('JSON.SET', 'test2', '.', '{"items":[{"price":9}]}'))
+            raw = r.execute_command('JSON.MGET', 'items[*].price', 'test', 'test2', 'foo')
+            self.assertEqual([[1, 2.5], [9]], [json.loads(v) for v in raw[:2]])
+            self.assertEqual(None, raw[2])
+            raw = r.execute_command('JSON.MGETPATHS', 2, '..price', 'info.price', 'test2')
+            self.assertEqual([['[9]', None]], raw)
+
+            # other commands need a path to a single value
+            for cmd in [('JSON.TYPE', 'test', 'items[*]'), ('JSON.SET', 'test', 'items[*].price', '0'),
+                        ('JSON.NUMINCRBY', 'test', '..price', '1')]:
+                with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                    r.execute_command(*cmd)
+                self.assertIn('multiple values', str(cm.exception))
+            for path in ['items..', 'items.*price', 'items[*']:
+                with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                    r.execute_command('JSON.GET', 'test', path)
+
+    def testSliceUnionPaths(self):
+        """Test reading and writing the values that slice, union and wildcard paths match"""
+
+        with self.redis() as r:
+            r.delete('test')
+            doc = {'nums': list(range(20)), 'a': {'x': [1, 2], 'y': 'foo', 'z': [3]}}
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', json.dumps(doc)))
+
+            get = lambda *paths: json.loads(r.execute_command('JSON.GET', 'test', *paths))
+            self.assertEqual(list(range(5)), get('nums[:5]'))
+            self.assertEqual(list(range(5, 10)), get('nums[5:10]'))
+            self.assertEqual([18, 19], get('nums[-2:]'))
+            self.assertEqual(list(range(0, 20, 5)), get('nums[::5]'))
+            self.assertEqual([19, 18, 17], get('nums[:-4:-1]'))
+            self.assertEqual([], get('nums[30:]'))
+            self.assertEqual([0, 19, 3], get('nums[0,-1,3,42]'))
+            self.assertEqual([[1, 2], 'foo'], get('a["x",\'y\',"nope"]'))
+            for path in ['nums[1:2:0]', 'nums[1,]', 'nums[:::]', 'nums[a:b]']:
+                with self.assertRaises(redis.exceptions.ResponseError):
+                    r.execute_command('JSON.GET', 'test', path)
+
+            # the lengths and ARR* commands reply with an array, and null for the wrong types
+            self.assertEqual([2, None, 1], r.execute_command('JSON.ARRLEN', 'test', 'a.*'))
+            self.assertEqual([None, 3, None], r.execute_command('JSON.STRLEN', 'test', 'a.*'))
+            self.assertEqual([4, None, 3],
+                             r.execute_command('JSON.ARRAPPEND', 'test', 'a.*', '0', '{"b":1}'))
+            self.assertEqual([5, None, 4],
+                             r.execute_command('JSON.ARRINSERT', 'test', 'a.*', '-1', 'true'))
+            self.assertEqual([6, None, None],
+                             r.execute_command('JSON.ARRINSERT', 'test', 'a.*', '5', 'null'))
+            self.assertEqual({'x': [1, 2, 0, True, {'b': 1}, None], 'y': 'foo',
+                              'z': [3, 0, True, {'b': 1}]}, get('a'))
+            self.assertEqual([2, None, 1],
+                             r.execute_command('JSON.ARRINDEX', 'test', 'a.*', '0'))
+            self.assertEqual(['1', None, '3'], r.execute_command('JSON.ARRPOP', 'test', 'a.*', 0))
+            self.assertEqual([2, None, 2], r.execute_command('JSON.ARRTRIM', 'test', 'a.*', 0, 1))
+            self.assertEqual({'x': [2, 0], 'y': 'foo', 'z': [0, True]}, get('a'))
+            self.assertEqual([None], r.execute_command('JSON.ARRPOP', 'test', 'a["y","no"]'))
+
+            # deleting every other number deletes from the end, so the indices stay valid
+            self.assertEqual(10, r.execute_command('JSON.DEL', 'test', 'nums[::2]'))
+            self.assertEqual(list(range(1, 20, 2)), get('nums'))
+            self.assertEqual(8, r.execute_command('JSON.DEL', 'test', 'nums[1:-1]'))
+            self.assertEqual([1, 19], get('nums'))
+            self.assertEqual(2, r.execute_command('JSON.DEL', 'test', 'nums[0,0,-1]'))
+            self.assertEqual(0, r.execute_command('JSON.DEL', 'test', 'nums[*]'))
+            self.assertEqual(2, r.execute_command('JSON.DEL', 'test', 'a["x","nope","z"]'))
+            self.assertEqual({'nums': [], 'a': {'y': 'foo'}}, get('.'))
+            self.assertEqual(3, r.execute_command('JSON.DEL', 'test', '..*'))
+            self.assertEqual({}, get('.'))
+
+    def testFilterPaths(self):
+        """Test filter expressions in paths"""
+
+        with self.redis() as r:
+            r.delete('test')
+            doc = {'orders': [{'id': 1, 'status': 'open', 'total': 10.5},
+                              {'id': 2, 'status': 'closed', 'total': 3},
+                              {'id': 3, 'status': 'open', 'total': 30, 'rush': True},
+                              {'id': 4, 'status': 'open'}],
+                   'nums': list(range(10))}
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', json.dumps(doc)))
+
+            get = lambda *args: json.loads(r.execute_command('JSON.GET', 'test', *args))
+            self.assertEqual([1, 3, 4], get('orders[?(@.status=="open")].id'))
+            self.assertEqual([1, 3], get('orders[?(@.status == "open" && @.total > 5)].id'))
+            self.assertEqual([2, 3], get('orders[?(@.total < 5 || @.rush == true)].id'))
+            self.assertEqual([4], get('orders[?(!@.total)].id'))
+            self.assertEqual([7, 8, 9], get('nums[?(@ >= 7)]'))
+            self.assertEqual([3], get('..[?(@.rush)].id'))
+
+            # the search stops after the first matches
+            self.assertEqual([1, 3], get('LIMIT', 2, 'orders[?(@.status=="open")].id'))
+            self.assertEqual({'nums[?(@ > 2)]': [3], 'orders[*].id': [1]},
+                             get('LIMIT', 1, 'nums[?(@ > 2)]', 'orders[*].id'))
+            self.assertEqual(doc['orders'][0], get('LIMIT', 1, 'orders[0]'))
+            for limit in ['0', '-1', 'x']:
+                with self.assertRaises(redis.exceptions.ResponseError):
+                    r.execute_command('JSON.GET', 'test', 'LIMIT', limit, 'orders[*]')
+
+            # filters select the values to write to and delete
+            self.assertEqual([4, 4],
+                             r.execute_command('JSON.STRLEN', 'test', 'orders[?(@.id > 2)].status'))
+            self.assertEqual(2, r.execute_command('JSON.DEL', 'test', 'orders[?(@.total <= 10.5)]'))
+            self.assertEqual([3, 4], get('orders[*].id'))
+            self.assertEqual(7, r.execute_command('JSON.DEL', 'test', 'nums[?(@ != 4 && @ < 8)]'))
+            self.assertEqual([4, 8, 9], get('nums'))
+
+            for path in ['orders[?(@.id = 1)]', 'orders[?(@.id == 1]', 'orders[?(@..id)]']:
+                with self.assertRaises(redis.exceptions.ResponseError):
+                    r.execute_command('JSON.GET', 'test', path)
+
     def testDelCommand(self):
         """Test REJSON.DEL command"""
 
@@ -515,6 +749,14 @@ class ReJSONTestCase(ModuleTestCase(module_path=module_path, redis_path=redis_pa
             self.assertEqual('3', r.execute_command('JSON.NUMINCRBY', 'test', '.foo', 2))
             self.assertEqual('3.5', r.execute_command('JSON.NUMINCRBY', 'test', '.foo', .5))
 
+            # numbers are serialized with the digits that parse back to them
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.foo', '0.1'))
+            self.assertEqual('0.30000000000000004',
+                             r.execute_command('JSON.NUMINCRBY', 'test', '.foo', 0.2))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.foo', '-2.718281828459045e-300'))
+            self.assertEqual('-2.718281828459045e-300',
+                             r.execute_command('JSON.GET', 'test', '.foo'))
+
             # test a wrong type
             with self.assertRaises(redis.exceptions.ResponseError) as cm:
                 r.execute_command('JSON.NUMINCRBY', 'test', '.bar', 1)
@@ -563,6 +805,277 @@ class ReJSONTestCase(ModuleTestCase(module_path=module_path, redis_path=redis_pa
             self.assertEqual(1, resp[1])
             self.assertEqual(2, resp[2])
 
+    def testReplyCache(self):
+        """Test that cached JSON.GET replies are invalidated by writes"""
+
+        with self.redis() as r:
+            r.delete('test')
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '{"s":"a","n":1,"a":[1]}'))
+            stats = r.execute_command('JSON.DEBUG', 'CACHE')
+            hits = stats[stats.index('hits') + 1]
+            self.assertEqual('{"s":"a","n":1,"a":[1]}', r.execute_command('JSON.GET', 'test'))
+            self.assertEqual('{"s":"a","n":1,"a":[1]}', r.execute_command('JSON.GET', 'test'))
+            self.assertEqual('1', r.execute_command('JSON.GET', 'test', '.n'))
+            self.assertEqual('1', r.execute_command('JSON.GET', 'test', '.n'))
+            stats = r.execute_command('JSON.DEBUG', 'CACHE')
+            self.assertEqual(hits + 2, stats[stats.index('hits') + 1])
+
+            # different arguments are cached separately
+            self.assertEqual('{\n".n": 1\n}', r.execute_command('JSON.GET', 'test', 'NEWLINE', '\n', 'SPACE', ' ', '.n', '.n'))
+
+            writes = [
+                (('JSON.SET', 'test', '.n', '2'), '{"s":"a","n":2,"a":[1]}'),
+                (('JSON.NUMINCRBY', 'test', '.n', '1'), '{"s":"a","n":3,"a":[1]}'),
+                (('JSON.NUMMULTBY', 'test', '.n', '2'), '{"s":"a","n":6,"a":[1]}'),
+                (('JSON.STRAPPEND', 'test', '.s', '"b"'), '{"s":"ab","n":6,"a":[1]}'),
+                (('JSON.ARRAPPEND', 'test', '.a', '2'), '{"s":"ab","n":6,"a":[1,2]}'),
+                (('JSON.ARRINSERT', 'test', '.a', '0', '0'), '{"s":"ab","n":6,"a":[0,1,2]}'),
+                (('JSON.ARRPOP', 'test', '.a'), '{"s":"ab","n":6,"a":[0,1]}'),
+                (('JSON.ARRTRIM', 'test', '.a', '1', '1'), '{"s":"ab","n":6,"a":[1]}'),
+                (('JSON.DEL', 'test', '.s'), '{"a":[1],"n":6}'),
+                (('JSON.SET', 'test', '.', '{"n":6,"a":[1]}'), '{"n":6,"a":[1]}'),
+            ]
+            for cmd, expected in writes:
+                r.execute_command(*cmd)
+                self.assertEqual(expected, r.execute_command('JSON.GET', 'test'), cmd)
+                self.assertEqual(expected, r.execute_command('JSON.GET', 'test'), cmd)
+
+            # a new document with the same key doesn't get its predecessor's replies
+            r.delete('test')
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '{"n":7,"a":[1]}'))
+            self.assertEqual('{"n":7,"a":[1]}', r.execute_command('JSON.GET', 'test'))
+            for _ in r.retry_with_rdb_reload():
+                self.assertEqual('{"n":7,"a":[1]}', r.execute_command('JSON.GET', 'test'))
+
+    def testPathCache(self):
+        """Test that parsed paths are reused across commands and keys"""
+
+        with self.redis() as r:
+            r.delete('test', 'test2')
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '{"foo":{"bar":[1,2]}}'))
+            self.assertOk(r.execute_command('JSON.SET', 'test2', '.', '{"foo":{"bar":[3]}}'))
+            stats = r.execute_command('JSON.DEBUG', 'PATHCACHE')
+            hits = stats[stats.index('hits') + 1]
+            self.assertEqual(2, r.execute_command('JSON.ARRLEN', 'test', '.foo.bar'))
+            self.assertEqual(2, r.execute_command('JSON.ARRLEN', 'test', '.foo.bar'))
+            self.assertEqual(1, r.execute_command('JSON.ARRLEN', 'test2', '.foo.bar'))
+            self.assertEqual(['[1,2]', '[3]'], r.execute_command('JSON.MGET', '.foo.bar', 'test', 'test2'))
+            stats = r.execute_command('JSON.DEBUG', 'PATHCACHE')
+            self.assertGreaterEqual(stats[stats.index('hits') + 1], hits + 3)
+            self.assertGreater(stats[stats.index('entries') + 1], 0)
+
+            # the same path is used more than once in a command
+            self.assertEqual('{".foo.bar":[1,2]}', r.execute_command('JSON.GET', 'test', '.foo.bar', '.foo.bar'))
+
+            # invalid paths are still errors when repeated
+            for _ in range(2):
+                with self.assertRaises(redis.exceptions.ResponseError) as cm:
+                    r.execute_command('JSON.GET', 'test', '.foo[')
+                self.assertIn('path', str(cm.exception))
+
+    def testInternedKeys(self):
+        """Test that object keys are shared by documents"""
+
+        with self.redis() as r:
+            r.delete('test', 'test2')
+            doc = '{"a_rather_long_key_name":{"a_rather_long_key_name":1}}'
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', doc))
+            stats = r.execute_command('JSON.DEBUG', 'INTERN')
+            refs, saved = stats[stats.index('references') + 1], stats[stats.index('saved') + 1]
+            mem = r.execute_command('JSON.DEBUG', 'MEMORY', 'test')
+
+            # a second document with the same keys only adds references
+            self.assertOk(r.execute_command('JSON.SET', 'test2', '.', doc))
+            stats = r.execute_command('JSON.DEBUG', 'INTERN')
+            self.assertEqual(refs + 2, stats[stats.index('references') + 1])
+            self.assertEqual(saved + 2 * len('a_rather_long_key_name?'), stats[stats.index('saved') + 1])
+            self.assertLess(r.execute_command('JSON.DEBUG', 'MEMORY', 'test'), mem)
+            for _ in r.retry_with_rdb_reload():
+                self.assertEqual(doc, r.execute_command('JSON.GET', 'test2'))
+
+            r.delete('test', 'test2')
+            stats = r.execute_command('JSON.DEBUG', 'INTERN')
+            self.assertEqual(refs - 2, stats[stats.index('references') + 1])
+
+    def testPackedArrays(self):
+        """Test arrays of numbers, which are packed, and their unpacking"""
+
+        with self.redis() as r:
+            r.delete('test', 'test2')
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '{"ints":[1,2,3],"nums":[0.5,1.5]}'))
+            self.assertOk(r.execute_command('JSON.SET', 'test2', '.', '{"ints":[1,2,3],"nums":[0.5,1.5]}'))
+            r.execute_command('JSON.ARRPOP', 'test2', '.ints')
+            r.execute_command('JSON.ARRAPPEND', 'test2', '.ints', '"x"')
+            self.assertLess(r.execute_command('JSON.DEBUG', 'MEMORY', 'test'),
+                            r.execute_command('JSON.DEBUG', 'MEMORY', 'test2'))
+
+            # operations that keep the array's numbers of one type
+            self.assertEqual(5, r.execute_command('JSON.ARRAPPEND', 'test', '.ints', 4, 5))
+            self.assertEqual(6, r.execute_command('JSON.ARRINSERT', 'test', '.ints', 0, 0))
+            self.assertEqual(4, r.execute_command('JSON.ARRINDEX', 'test', '.ints', 4))
+            self.assertEqual(-1, r.execute_command('JSON.ARRINDEX', 'test', '.ints', 4.0))
+            self.assertEqual(1, r.execute_command('JSON.ARRINDEX', 'test', '.nums', 1.5))
+            self.assertEqual('5', r.execute_command('JSON.ARRPOP', 'test', '.ints'))
+            self.assertEqual(3, r.execute_command('JSON.ARRTRIM', 'test', '.ints', 1, 3))
+            self.assertEqual('[1,2,3]', r.execute_command('JSON.GET', 'test', '.ints'))
+            self.assertEqual(['[', 1, 2, 3], r.execute_command('JSON.RESP', 'test', '.ints'))
+            mem = r.execute_command('JSON.DEBUG', 'MEMORY', 'test')
+            self.assertEqual('2', r.execute_command('JSON.GET', 'test', '.ints[1]'))
+            self.assertEqual('integer', r.execute_command('JSON.TYPE', 'test', '.ints[-1]'))
+            self.assertEqual('12', r.execute_command('JSON.NUMINCRBY', 'test', '.ints[2]', 9))
+            self.assertEqual('3', r.execute_command('JSON.NUMINCRBY', 'test', '.ints[2]', -9))
+            self.assertEqual('1.5', r.execute_command('JSON.NUMMULTBY', 'test', '.nums[1]', 1))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.nums[0]', '0.5'))
+            self.assertEqual(mem, r.execute_command('JSON.DEBUG', 'MEMORY', 'test'))
+            for _ in r.retry_with_rdb_reload():
+                self.assertEqual('{"ints":[1,2,3],"nums":[0.5,1.5]}', r.execute_command('JSON.GET', 'test'))
+
+            # and ones that don't
+            self.assertEqual(4, r.execute_command('JSON.ARRAPPEND', 'test', '.ints', 4.5))
+            self.assertEqual(3, r.execute_command('JSON.ARRINSERT', 'test', '.nums', 1, '"x"'))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.ints[0]', 'null'))
+            self.assertEqual('3', r.execute_command('JSON.NUMINCRBY', 'test', '.nums[0]', 2.5))
+            self.assertEqual('integer', r.execute_command('JSON.TYPE', 'test', '.ints[1]'))
+            for _ in r.retry_with_rdb_reload():
+                self.assertEqual('{"ints":[null,2,3,4.5],"nums":[3,"x",1.5]}', r.execute_command('JSON.GET', 'test'))
+            r.delete('test', 'test2')
+
+    def testMemoryUsage(self):
+        """Test that the memory usage of big documents follows their changes"""
+
+        with self.redis() as r:
+            r.delete('test')
+            doc = {'arr': [{'a': i} for i in range(100)], 'ints': list(range(100)),
+                   'dict': dict(('k%d' % i, i) for i in range(100))}
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', json.dumps(doc)))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.arr[5].a', '5'))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.arr[5].b', '[]'))
+            mem = r.execute_command('MEMORY', 'USAGE', 'test')
+
+            # changes deep down in the document are accounted for, even when they're undone
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.arr[5].a', '"%s"' % ('x' * 1000)))
+            self.assertGreaterEqual(r.execute_command('MEMORY', 'USAGE', 'test'), mem + 1000)
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.arr[5].a', '5'))
+            self.assertEqual(mem, r.execute_command('MEMORY', 'USAGE', 'test'))
+            self.assertEqual(2, r.execute_command('JSON.ARRAPPEND', 'test', '.arr[5].b', '[1]', '"%s"' % ('x' * 100)))
+            self.assertGreaterEqual(r.execute_command('MEMORY', 'USAGE', 'test'), mem + 100)
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.arr[5].b', '[]'))
+            self.assertEqual(mem, r.execute_command('MEMORY', 'USAGE', 'test'))
+
+            # as is the unpacking of a packed array, which looking its items up doesn't do
+            self.assertEqual('3', r.execute_command('JSON.GET', 'test', '.ints[3]'))
+            self.assertEqual('4', r.execute_command('JSON.NUMINCRBY', 'test', '.ints[3]', 1))
+            self.assertEqual(mem, r.execute_command('MEMORY', 'USAGE', 'test'))
+            self.assertEqual('4.5', r.execute_command('JSON.NUMINCRBY', 'test', '.ints[3]', 0.5))
+            self.assertGreater(r.execute_command('MEMORY', 'USAGE', 'test'), mem + 100 * 16)
+            r.delete('test')
+
+            # documents that use the same keys share their memory
+            doc = json.dumps(dict(('a key that is rather long %d' % i, i) for i in range(100)))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', doc))
+            mem = r.execute_command('MEMORY', 'USAGE', 'test')
+            self.assertOk(r.execute_command('JSON.SET', 'test2', '.', doc))
+            self.assertLess(r.execute_command('MEMORY', 'USAGE', 'test'), mem - 100 * 10)
+            self.assertEqual(r.execute_command('MEMORY', 'USAGE', 'test'),
+                             r.execute_command('MEMORY', 'USAGE', 'test2'))
+            r.delete('test', 'test2')
+
+    def testLazyFree(self):
+        """Test that big documents are freed in the background"""
+
+        def freed(r):
+            # waits for the pending frees to finish
+            while True:
+                stats = r.execute_command('JSON.DEBUG', 'LAZYFREE')
+                if not stats[stats.index('pending') + 1]:
+                    return stats[stats.index('freed') + 1]
+                time.sleep(0.01)
+
+        with self.redis() as r:
+            r.delete('test')
+            before = freed(r)
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '{"a":[1,"2",3]}'))
+            r.delete('test')
+            self.assertEqual(before, freed(r))
+
+            # deleting and overwriting a big document free it lazily
+            doc = json.dumps([{'a': str(i)} for i in range(1000)])
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', doc))
+            r.delete('test')
+            self.assertEqual(before + 1, freed(r))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', doc))
+            self.assertOk(r.execute_command('JSON.SET', 'test', '.', '[]'))
+            self.assertEqual(before + 2, freed(r))
+            self.assertEqual('[]', r.execute_command('JSON.GET', 'test'))
+            r.delete('test')
+
+    def testLoadThreads(self):
+        """Test that documents unpacked by the loading threads are intact"""
+
+        with self.redis() as r:
+            docs = {}
+            for i in range(20):
+                docs['test%d' % i] = json.dumps({'i': i, 'arr': [{'k%d' % j: 'v' * (i * j)} for j in range(i * 10)]})
+            for k, v in docs.items():
+                self.assertOk(r.execute_command('JSON.SET', k, '.', v))
+
+            # every kind of access waits for the document to be unpacked
+            for _ in r.retry_with_rdb_reload():
+                self.assertGreater(r.execute_command('MEMORY', 'USAGE', 'test19'), len(docs['test19']))
+                self.assertEqual(1, r.delete('test18'))
+                self.assertOk(r.execute_command('JSON.SET', 'test17', '.i', '-1'))
+                self.assertEqual(-1, json.loads(r.execute_command('JSON.GET', 'test17'))['i'])
+                self.assertOk(r.execute_command('JSON.SET', 'test17', '.i', '17'))
+                self.assertOk(r.execute_command('JSON.SET', 'test18', '.', docs['test18']))
+                for k, v in docs.items():
+                    self.assertEqual(json.loads(v), json.loads(r.execute_command('JSON.GET', k)))
+            r.delete(*docs.keys())
+
+    def testAofRewrite(self):
+        """Test that big documents are rewritten to the AOF in chunks that replay to the same value"""
+
+        docs = {
+            'test': {
+                'arr': [list(range(100)), 'x' * 200, {'a b': [1.5] * 50, 'c"d': ['y'] * 30}],
+                "e'f": {'n': None, 'deep': [[['z' * 100]]]},
+                'both': {'g"h\'i': list(range(40))},  # can't be addressed, so it's set whole
+                'ok': True,
+            },
+            'test2': [[i, str(i)] for i in range(200)],
+            'test3': 'a string that is longer than the chunk size, which is never broken up' * 2,
+        }
+        dirname = tempfile.mkdtemp()
+        try:
+            proc, r = startServer(dirname, 'AOF_CHUNK_SIZE', '64', '--appendonly', 'yes',
+                                  '--aof-use-rdb-preamble', 'no')
+            for k, v in docs.items():
+                self.assertOk(r.execute_command('JSON.SET', k, '.', json.dumps(v)))
+            before = {k: r.execute_command('JSON.GET', k) for k in docs}
+            r.execute_command('BGREWRITEAOF')
+            while True:
+                info = r.info('persistence')
+                if not info['aof_rewrite_in_progress'] and not info['aof_rewrite_scheduled']:
+                    break
+                time.sleep(0.05)
+            stopServer(proc, r)
+
+            # the documents were broken up, and replaying them gives back the same values
+            aof = b''
+            for f in glob.glob(os.path.join(dirname, '**', '*appendonly*'), recursive=True):
+                if os.path.isfile(f):
+                    with open(f, 'rb') as fp:
+                        aof += fp.read()
+            self.assertIn(b'JSON.ARRAPPEND', aof)
+            self.assertGreater(aof.count(b'JSON.SET'), len(docs))
+
+            proc, r = startServer(dirname, '--appendonly', 'yes')
+            for k in docs:
+                self.assertEqual(before[k], r.execute_command('JSON.GET', k), k)
+                self.assertEqual(docs[k], json.loads(r.execute_command('JSON.GET', k)), k)
+            stopServer(proc, r)
+        finally:
+            shutil.rmtree(dirname)
+
     def testAllJSONCaseFiles(self):
         """Test using all JSON test case files"""
         self.maxDiff = None
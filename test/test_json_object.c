@@ -4,6 +4,8 @@
 #include <dirent.h>
 #include "minunit.h"
 #include "../src/json_object.h"
+#include "../src/object_pack.h"
+#include "../src/json_path.h"
 
 #define _JSTR(e) "\"" #e "\""
 
@@ -100,7 +102,18 @@ MU_TEST(test_jo_create_literal_double) {
     mu_assert_double_eq(-4.2, n->value.numval);
     Node_Free(n);
 
-    // TODO: check more notations
+    // other notations, including those beyond the fast path, are converted like strtod does
+    const char *notations[] = {"1e23", "1E-2", "0.1e1", "-5e-324", "2.2250738585072014e-308",
+                               "9007199254740993.0", "1234567890.12345678901234567890e-5",
+                               "0.30000000000000004", "1.7976931348623157e308"};
+    for (size_t i = 0; i < sizeof(notations) / sizeof(notations[0]); i++) {
+        double d = strtod(notations[i], NULL);
+        mu_check(JSONOBJECT_OK ==
+                 CreateNodeFromJSON(notations[i], strlen(notations[i]), &n, NULL));
+        mu_check(N_NUMBER == n->type);
+        mu_check(!memcmp(&d, &n->value.numval, sizeof(d)));
+        Node_Free(n);
+    }
 }
 
 MU_TEST(test_jo_create_literal_string) {
@@ -111,12 +124,36 @@ MU_TEST(test_jo_create_literal_string) {
     mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, strlen(json), &n, NULL));
     mu_check(NULL != n);
     mu_check(N_STRING == n->type);
-    mu_check(0 == strncmp("foo", n->value.strval.data, n->value.strval.len));
+    mu_check(0 == strncmp("foo", NODE_STRING_DATA(n), NODE_STRING_LEN(n)));
     Node_Free(n);
 
     // TODO: more weird chars
 }
 
+MU_TEST(test_jo_create_literal_errors) {
+    const char *jsons[] = {"tru", "\"a\tb\"", "01", "\"\\x\"", "1 2", "\"abc", "1e999", "-", " "};
+    const char *errs[] = {
+        "ERR JSON lexer error SPECIAL_INCOMPLETE at position 1",
+        "ERR JSON lexer error WEIRD_WHITESPACE at position 1",
+        "ERR JSON lexer error INVALID_NUMBER at position 1",
+        "ERR JSON lexer error ESCAPE_INVALID at position 1",
+        "ERR JSON lexer error CANT_INSERT at position 3",
+        "ERR JSON value incomplete - 2 containers unterminated",
+        "ERR JSON lexer error INVALID_NUMBER at position 7",
+        "ERR JSON lexer error INVALID_NUMBER at position 1",
+        "ERR JSON value not found",
+    };
+
+    // scalars that aren't valid are reported by jsonsl
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        Node *n;
+        char *err = NULL;
+        mu_check(JSONOBJECT_ERROR == CreateNodeFromJSON(jsons[i], strlen(jsons[i]), &n, &err));
+        mu_check(!strcmp(errs[i], err));
+        free(err);
+    }
+}
+
 MU_TEST(test_jo_create_literal_dict) {
     Node *n;
     const char *json = "{}";
@@ -161,6 +198,18 @@ MU_TEST(test_jo_create_literal_array) {
     mu_check(N_ARRAY == n->type);
     mu_assert_int_eq(3, n->value.dictval.len);
     Node_Free(n);
+
+    // arrays of numbers of one type are packed
+    json = "[[1, -2, 3], [0.5, 1e3], [1, 2.5]]";
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, strlen(json), &n, NULL));
+    mu_check(!NODE_IS_PACKED_ARRAY(n));
+    mu_check(n->value.arrval.entries[0]->flags & NODE_F_INT_ARRAY);
+    mu_check(-2 == NODE_ARRAY_INTS(n->value.arrval.entries[0])[1]);
+    mu_check(n->value.arrval.entries[1]->flags & NODE_F_NUM_ARRAY);
+    mu_check(1000 == NODE_ARRAY_NUMS(n->value.arrval.entries[1])[1]);
+    mu_check(!NODE_IS_PACKED_ARRAY(n->value.arrval.entries[2]));
+    mu_assert_int_eq(2, Node_Length(n->value.arrval.entries[2]));
+    Node_Free(n);
 }
 
 MU_TEST(test_jo_create_object) {
@@ -196,11 +245,11 @@ MU_TEST(test_jo_create_object) {
 
     mu_check(OBJ_OK == Node_ArrayItem(n3, 0, &n4));
     mu_check(N_STRING == n4->type);
-    mu_check(0 == strncmp("element0", n4->value.strval.data, n4->value.strval.len));
+    mu_check(0 == strncmp("element0", NODE_STRING_DATA(n4), NODE_STRING_LEN(n4)));
 
     mu_check(OBJ_OK == Node_ArrayItem(n3, 1, &n4));
     mu_check(N_STRING == n4->type);
-    mu_check(0 == strncmp("element1", n4->value.strval.data, n4->value.strval.len));
+    mu_check(0 == strncmp("element1", NODE_STRING_DATA(n4), NODE_STRING_LEN(n4)));
 
     mu_check(OBJ_OK == Node_DictGet(n2, "inner object", &n3));
     mu_check(N_DICT == n3->type);
@@ -208,7 +257,7 @@ MU_TEST(test_jo_create_object) {
 
     mu_check(OBJ_OK == Node_DictGet(n3, "baz", &n4));
     mu_check(N_STRING == n4->type);
-    mu_check(0 == strncmp("qux", n4->value.strval.data, n4->value.strval.len));
+    mu_check(0 == strncmp("qux", NODE_STRING_DATA(n4), NODE_STRING_LEN(n4)));
 
     Node_Free(n1);
 }
@@ -280,6 +329,56 @@ MU_TEST(test_oj_integer) {
     Node_Free(n);
 }
 
+MU_TEST(test_oj_number) {
+    struct {
+        double d;
+        const char *json;
+    } nums[] = {
+        {0.0, "0"},
+        {-0.0, "-0"},
+        {1.0, "1"},
+        {-2.5, "-2.5"},
+        {0.1, "0.1"},
+        {0.1 + 0.2, "0.30000000000000004"},
+        {3.14159, "3.14159"},
+        {1e17, "100000000000000000"},
+        {1e18, "1e+18"},
+        {1.5e300, "1.5e+300"},
+        {0.000001, "0.000001"},
+        {1e-7, "1e-7"},
+        {-123.456e-20, "-1.23456e-18"},
+        {5e-324, "5e-324"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+    };
+    JSONSerializeOpt opt = {"", "", ""};
+
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        Node *n = NewDoubleNode(nums[i].d);
+        sds str = sdsempty();
+        SerializeNodeToJSON(n, &opt, &str);
+        if (strcmp(nums[i].json, str)) printf("\n%s != %s\n", nums[i].json, str);
+        mu_check(!strcmp(nums[i].json, str));
+        sdsfree(str);
+        Node_Free(n);
+    }
+
+    // any finite double is serialized with enough digits to parse back to itself
+    uint64_t bits = 0x9e3779b97f4a7c15;
+    for (int i = 0; i < 10000; i++) {
+        double d, parsed;
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        memcpy(&d, &bits, sizeof(d));
+        if (!isfinite(d)) continue;
+
+        char num[JSONNUMBER_MAX_LENGTH];
+        size_t len = JSONNumber_FormatDouble(num, d);
+        mu_check(JSONNUMBER_OK == JSONNumber_ToDouble(num, len, &parsed));
+        mu_check(!memcmp(&d, &parsed, sizeof(d)));
+    }
+}
+
 MU_TEST(test_oj_string) {
     Node *n;
     sds str = sdsempty();
@@ -342,6 +441,96 @@ MU_TEST(test_oj_array) {
     Node_Free(n);
 }
 
+MU_TEST(test_oj_long_string) {
+    Node *n;
+    sds str = sdsempty(), json = sdsnew("\"");
+    JSONSerializeOpt opt = {"", "", ""};
+    char val[100];
+    const char *specials = "\"\\/\n\x01\x7f\xe9";
+    const char *escapes[] = {"\\\"", "\\\\", "\\/", "\\n", "\\u0001", "\\u007f", "\\u00e9"};
+    int pos[] = {0, 15, 16, 31, 32, 63, 99};
+
+    // the specials are placed around block boundaries
+    memset(val, 'a', sizeof(val));
+    for (int i = 0, j = 0; i < sizeof(val); i++) {
+        if (j < 7 && i == pos[j]) {
+            val[i] = specials[j];
+            json = sdscat(json, escapes[j++]);
+        } else {
+            json = sdscatlen(json, "a", 1);
+        }
+    }
+    json = sdscatlen(json, "\"", 1);
+
+    n = NewStringNode(val, sizeof(val));
+    SerializeNodeToJSON(n, &opt, &str);
+    mu_check(!strcmp(json, str));
+    mu_assert_int_eq(sdslen(str), JSONSerializedLength(n, SIZE_MAX));
+    sdsfree(str);
+    sdsfree(json);
+    Node_Free(n);
+}
+
+MU_TEST(test_oj_length) {
+    Node *n;
+    sds str = sdsempty();
+    JSONSerializeOpt opt = {"", "", ""};
+    char *json =
+        "{\"k\\\"ey\":[null,true,false,-42,0.25,1e100,1.5e-9,\"a/b\\\\c\\n\\u0001\"],\"\":{},\"e\":[]}";
+
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, strlen(json), &n, NULL));
+    SerializeNodeToJSON(n, &opt, &str);
+
+    // quotes are escaped in keys just like in strings
+    mu_check(!strncmp("{\"k\\\"ey\":", str, 9));
+
+    // the length is exact, unless the limit is reached
+    mu_assert_int_eq(sdslen(str), JSONSerializedLength(n, SIZE_MAX));
+    mu_check(JSONSerializedLength(n, 10) > 10);
+    mu_check(JSONSerializedLength(n, 10) < sdslen(str));
+
+    // and so is the length of formatted serializations
+    JSONSerializeOpt fopts[] = {{"\t", "\n", " "}, {"  ", "", ""}, {"", "\r\n", ""}, {NULL, NULL, NULL}};
+    for (int i = 0; i < sizeof(fopts) / sizeof(fopts[0]); i++) {
+        sdsclear(str);
+        SerializeNodeToJSON(n, &fopts[i], &str);
+        mu_assert_int_eq(sdslen(str), JSONSerializedLengthEx(n, &fopts[i], SIZE_MAX));
+
+        sds sized = SerializeNodeToJSONSized(n, &fopts[i]);
+        mu_check(!strcmp(str, sized));
+        mu_assert_int_eq(sdslen(str), sdsalloc(sized));
+        sdsfree(sized);
+    }
+
+    sdsfree(str);
+    Node_Free(n);
+}
+
+MU_TEST(test_oj_utf8_key) {
+    Node *n, *v;
+    NodeStats stats;
+    sds str = sdsempty();
+    JSONSerializeOpt opt = {"", "", ""};
+    // UTF-8 and the solidus are kept as they are, around block boundaries too
+    const char *key = "kkkkkkkkkkkkkk\xc3\xa9kkkkkkkkkkkkkk/\xc3\xa9\x7f\"\x01\xe2\x82\xac";
+    const char *json =
+        "{\"kkkkkkkkkkkkkk\xc3\xa9kkkkkkkkkkkkkk/\xc3\xa9\x7f\\\"\\u0001\xe2\x82\xac\":1}";
+
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, strlen(json), &n, NULL));
+    mu_check(OBJ_OK == Node_DictGet(n, key, &v));
+    SerializeNodeToJSON(n, &opt, &str);
+    mu_check(!strcmp(json, str));
+    mu_assert_int_eq(sdslen(str), JSONSerializedLength(n, SIZE_MAX));
+    Node_GetStats(n, &stats);
+    mu_assert_int_eq(sdslen(str), stats.bytes);
+
+    sds sized = SerializeNodeToJSONSized(n, &opt);
+    mu_check(!strcmp(json, sized));
+    sdsfree(sized);
+    sdsfree(str);
+    Node_Free(n);
+}
+
 MU_TEST(test_oj_special_characters) {
     Node *n;
     sds str = sdsempty();
@@ -370,6 +559,394 @@ MU_TEST(test_oj_special_characters) {
     Node_Free(n);
 }
 
+MU_TEST(test_jo_create_arena) {
+    Node *n, *h;
+    sds str = sdsempty(), hstr = sdsempty();
+    JSONSerializeOpt opt = {"", "", ""};
+    char *json =
+        " {\"plain\":\"foo\",\"esc\\taped\":\"a\\\"b\\\\c\\/d\\n\",\"\":\"\","
+        "\"long\":\"a string that is too long\\tfor the node\","
+        "\"unicode\":[\"\\u00e9\\u20ac\",\"\\ud83d\\ude00\"],\"n\":[1,2.5,true,null]}";
+
+    // strings reference the arena's copy of the text, unescaped in place, and match the heap's
+    NodeArena *a = NewNodeArena();
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSONEx(json, strlen(json), a, &n, NULL));
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, strlen(json), &h, NULL));
+    SerializeNodeToJSON(n, &opt, &str);
+    SerializeNodeToJSON(h, &opt, &hstr);
+    mu_check(!strcmp(str, hstr));
+
+    Node *s;
+    mu_check(OBJ_OK == Node_DictGet(n, "esc\taped", &s));
+    mu_assert_int_eq(8, NODE_STRING_LEN(s));
+    mu_check(!strncmp("a\"b\\c/d\n", NODE_STRING_DATA(s), 8));
+    mu_check(OBJ_OK == Node_DictGet(n, "long", &s));
+    mu_check(s->flags & NODE_F_ARENA_DATA);
+    mu_check(!strcmp("a string that is too long\tfor the node", NODE_STRING_DATA(s)));
+    mu_check(OBJ_OK == Node_DictGet(n, "", &s));
+    mu_assert_int_eq(0, NODE_STRING_LEN(s));
+    Node_Free(n);
+    Node_Free(h);
+
+    // scalars and errors
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSONEx("\"b\\u0061r\"", 10, a, &n, NULL));
+    mu_assert_int_eq(N_STRING, n->type);
+    mu_check(!strncmp("bar", NODE_STRING_DATA(n), 3));
+    Node_Free(n);
+    mu_check(JSONOBJECT_ERROR == CreateNodeFromJSONEx("[\"\\ud83d\"]", 10, a, &n, NULL));
+    NodeArena_Free(a);
+
+    sdsfree(str);
+    sdsfree(hstr);
+}
+
+/* Parses the text with an engine, returning the serialization or the error. */
+static sds parseWith(JSONObjectParser parser, const char *json, size_t len, NodeArena *a) {
+    JSONSerializeOpt opt = {"", "", ""};
+    JSONObjectParser prev = jsonObjectParser;
+    Node *n = NULL;
+    char *err = NULL;
+    sds str = sdsempty();
+
+    jsonObjectParser = parser;
+    if (JSONOBJECT_OK == CreateNodeFromJSONEx(json, len, a, &n, &err)) {
+        SerializeNodeToJSON(n, &opt, &str);
+        Node_Free(n);
+    } else {
+        str = sdscat(str, err);
+        free(err);
+    }
+    jsonObjectParser = prev;
+    return str;
+}
+
+MU_TEST(test_jo_parsers) {
+    const char *jsons[] = {
+        // valid
+        "{}", "[]", " [ ] ", "\t{\n}\r\n", "0", "-0", "  -12.5e-3 ", "1E+2", "true", "false",
+        "null", "\"\"", "\"a\\u00e9\\\\\"", "[1,2,3]", "[1,2.5,-3e2]", "[1,\"a\",true,null,{},[]]",
+        "{\"a\":{\"b\":[{\"c\":null}]},\"\":\"\",\"d\\\"e\":[[[]]]}",
+        "[\"a\\\"],\\\\\",\"{\\\\\\\"}\"]", "9223372036854775807", "-9223372036854775808",
+        // a string that crosses blocks of 64 bytes with escapes at their edges
+        "[\"0123456789012345678901234567890123456789012345678901234567890\\\"\\\\\\\\\\\"\","
+        "\"01234567890123456789012345678901234567890123456789012345678\\\\\\\\\\\\\"]",
+        // invalid
+        "", "   ", "[", "]", "{\"a\"}", "{\"a\":}", "{1:2}", "[1,]", "[1 2]", "[1],", "01", "1.",
+        ".5", "-", "1e", "tru", "truex", "nul", "[\"a\tb\"]", "[\"\\x\"]", "[\"\\ud83d\"]",
+        "\"unterminated", "[\"a\\\"]", "9223372036854775808", "1e999", "{\"a\":1,}", "[1]x",
+        "[\"\\u00\"]", "{\"a\" \"b\"}", "[1] , [2]", "{\"a\":1} , 2}",
+    };
+
+    NodeArena *a = NewNodeArena();
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        // both engines create the same objects and report the same errors
+        size_t len = strlen(jsons[i]);
+        for (int arena = 0; arena < 2; arena++) {
+            sds jsonsl = parseWith(JSONOBJECT_PARSER_JSONSL, jsons[i], len, arena ? a : NULL);
+            sds indexed = parseWith(JSONOBJECT_PARSER_INDEXED, jsons[i], len, arena ? a : NULL);
+            if (strcmp(jsonsl, indexed)) printf("\n%s: %s != %s\n", jsons[i], jsonsl, indexed);
+            mu_check(!strcmp(jsonsl, indexed));
+            sdsfree(jsonsl);
+            sdsfree(indexed);
+        }
+    }
+
+    // nesting that's deeper than the indexed parser's limit is left to jsonsl, which gets the arena
+    // just as if it parsed the text on its own
+    char deep[2 * 520];
+    for (size_t depth = 500; depth <= 520; depth += 4) {
+        NodeArena *ja = NewNodeArena(), *ia = NewNodeArena();
+        memset(deep, '[', depth);
+        memset(&deep[depth], ']', depth);
+        sds jsonsl = parseWith(JSONOBJECT_PARSER_JSONSL, deep, 2 * depth, ja);
+        sds indexed = parseWith(JSONOBJECT_PARSER_INDEXED, deep, 2 * depth, ia);
+        mu_check(!strcmp(jsonsl, indexed));
+        mu_assert_int_eq(ja->size, ia->size);
+        sdsfree(jsonsl);
+        sdsfree(indexed);
+        NodeArena_Free(ja);
+        NodeArena_Free(ia);
+    }
+    NodeArena_Free(a);
+}
+
+MU_TEST(test_jo_parser_reuse) {
+    const char *jsons[] = {"x", "[1,", "{\"a\":[[{\"b\":tru", "[\"\\u12\"]", "{}}"};
+    size_t njsons = sizeof(jsons) / sizeof(jsons[0]);
+    sds errs[2][sizeof(jsons) / sizeof(jsons[0])];
+
+    // parsers are reused, but what an error leaves behind doesn't change the next parse's errors
+    for (int parser = JSONOBJECT_PARSER_JSONSL; parser <= JSONOBJECT_PARSER_INDEXED; parser++) {
+        for (int round = 0; round < 2; round++) {
+            for (size_t i = 0; i < njsons; i++) {
+                size_t j = round ? njsons - 1 - i : i;
+                errs[round][j] = parseWith(parser, jsons[j], strlen(jsons[j]), NULL);
+            }
+        }
+        for (size_t i = 0; i < njsons; i++) {
+            mu_check(!strncmp("ERR JSON", errs[0][i], 8));
+            mu_check(!strcmp(errs[0][i], errs[1][i]));
+            sdsfree(errs[0][i]);
+            sdsfree(errs[1][i]);
+        }
+    }
+}
+
+MU_TEST(test_jo_capacity) {
+    const char *json =
+        "{\"ints\":[1,2,3],\"nums\":[1.5,-2e3],\"mixed\":[1,2.5,\"a\",null],\"empty\":[],"
+        "\"dict\":{},\"ints\":[[4],{\"k\":5}]}";
+    Node *n, *v;
+
+    // containers are created at their length, and an array of numbers of the same type is packed
+    for (int arena = 0; arena < 2; arena++) {
+        NodeArena *a = arena ? NewNodeArena() : NULL;
+        mu_check(JSONOBJECT_OK == CreateNodeFromJSONEx(json, strlen(json), a, &n, NULL));
+        mu_assert_int_eq(5, n->value.dictval.len);
+        mu_assert_int_eq(6, n->value.dictval.cap);  // the repeated key replaced the first one
+        mu_check(OBJ_OK == Node_DictGet(n, "nums", &v));
+        mu_check(v->flags & NODE_F_NUM_ARRAY);
+        mu_assert_int_eq(2, v->value.arrval.cap);
+        mu_check(OBJ_OK == Node_DictGet(n, "mixed", &v));
+        mu_check(!NODE_IS_PACKED_ARRAY(v));
+        mu_assert_int_eq(4, v->value.arrval.cap);
+        mu_check(OBJ_OK == Node_DictGet(n, "empty", &v));
+        mu_assert_int_eq(0, v->value.arrval.cap);
+        mu_check(OBJ_OK == Node_DictGet(n, "dict", &v));
+        mu_assert_int_eq(0, v->value.dictval.cap);
+        mu_check(OBJ_OK == Node_DictGet(n, "ints", &v));
+        mu_assert_int_eq(2, v->value.arrval.cap);
+        mu_check(v->value.arrval.entries[0]->flags & NODE_F_INT_ARRAY);
+        mu_assert_int_eq(1, v->value.arrval.entries[0]->value.arrval.cap);
+        mu_assert_int_eq(1, v->value.arrval.entries[1]->value.dictval.cap);
+
+        // and they can grow, out of the arena if they're in one
+        Node_ArrayAppend(v, NewIntNode(6));
+        Node_DictSet(v->value.arrval.entries[1], "l", NewIntNode(7));
+        mu_assert_int_eq(3, v->value.arrval.len);
+        mu_assert_int_eq(2, v->value.arrval.entries[1]->value.dictval.len);
+        mu_check(OBJ_OK == Node_DictGet(n, "dict", &v));
+        Node_DictSet(v, "m", NewIntNode(8));
+        mu_assert_int_eq(1, v->value.dictval.len);
+        mu_check(OBJ_OK == Node_DictGet(n, "empty", &v));
+        Node_ArrayAppend(v, NewCStringNode("b"));
+        mu_assert_int_eq(1, v->value.arrval.len);
+        sds str = SerializeNodeToJSONSized(n, &(JSONSerializeOpt){"", "", ""});
+        mu_check(!strcmp("{\"ints\":[[4],{\"k\":5,\"l\":7},6],\"nums\":[1.5,-2000],"
+                         "\"mixed\":[1,2.5,\"a\",null],\"empty\":[\"b\"],\"dict\":{\"m\":8}}",
+                         str));
+        sdsfree(str);
+        Node_Free(n);
+        if (a) NodeArena_Free(a);
+    }
+}
+
+MU_TEST(test_jo_pack) {
+    Node *n, *u;
+    char *buf;
+    size_t len;
+    sds str = sdsempty(), ustr = sdsempty();
+    JSONSerializeOpt opt = {"", "", ""};
+    char *json =
+        "{\"null\":null,\"bools\":[true,false],\"ints\":[0,-1,63,-64,64,1000000,-9223372036854775808],"
+        "\"nums\":[0.5,-1.25e100,3.0],\"mixed\":[1,2.5,\"x\",{}],\"str\":\"f\\too\",\"\":[],"
+        "\"deep\":{\"a\":{\"b\":[[42]]}}}";
+
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, strlen(json), &n, NULL));
+    SerializeNodeToJSON(n, &opt, &str);
+    Node_Pack(n, &buf, &len);
+    mu_check(len < strlen(json));
+
+    // unpacking to the heap or to an arena gives back the same value
+    mu_check(OBJ_OK == Node_Unpack(buf, len, NULL, &u));
+    SerializeNodeToJSON(u, &opt, &ustr);
+    mu_check(!strcmp(str, ustr));
+    Node_Free(u);
+
+    NodeArena *a = NewNodeArena();
+    sdsclear(ustr);
+    mu_check(OBJ_OK == Node_Unpack(buf, len, a, &u));
+    SerializeNodeToJSON(u, &opt, &ustr);
+    mu_check(!strcmp(str, ustr));
+
+    // numeric arrays are unpacked into packed arrays at their length
+    Node *v;
+    mu_check(OBJ_OK == Node_DictGet(u, "nums", &v));
+    mu_check(v->flags & NODE_F_NUM_ARRAY && v->flags & NODE_F_ARENA_ENTRIES);
+    mu_assert_int_eq(3, v->value.arrval.cap);
+    mu_check(OBJ_OK == Node_DictGet(u, "ints", &v));
+    mu_check(v->flags & NODE_F_INT_ARRAY);
+    mu_assert_int_eq(7, v->value.arrval.cap);
+    Node_Free(u);
+    NodeArena_Free(a);
+
+    // truncated and trailing input are errors, that are found without unpacking too
+    mu_check(OBJ_OK == Node_UnpackCheck(buf, len));
+    for (size_t i = 0; i < len; i++) {
+        mu_check(OBJ_ERR == Node_Unpack(buf, i, NULL, &u));
+        mu_check(OBJ_ERR == Node_UnpackCheck(buf, i));
+    }
+
+    // and a corrupted buffer is checked just like it's unpacked
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            buf[i] ^= 1 << bit;
+            int rc = Node_Unpack(buf, len, NULL, &u);
+            if (OBJ_OK == rc) Node_Free(u);
+            mu_assert_int_eq(rc, Node_UnpackCheck(buf, len));
+            buf[i] ^= 1 << bit;
+        }
+    }
+
+    buf = realloc(buf, len + 1);
+    buf[len] = 0;
+    mu_check(OBJ_ERR == Node_Unpack(buf, len + 1, NULL, &u));
+    mu_check(OBJ_ERR == Node_UnpackCheck(buf, len + 1));
+
+    free(buf);
+    sdsfree(str);
+    sdsfree(ustr);
+    Node_Free(n);
+}
+
+/* Drops the cached statistics of all the containers in a tree. */
+static void dropStats(Node *n) {
+    if (!n || !(n->type & (N_DICT | N_ARRAY | N_KEYVAL))) return;
+    if (N_KEYVAL == n->type) return dropStats(n->value.kvval.val);
+
+    n->flags &= ~NODE_F_STATS;
+    for (int i = 0; !NODE_IS_PACKED_ARRAY(n) && i < Node_Length(n); i++) {
+        dropStats(n->value.arrval.entries[i]);
+    }
+}
+
+/* Returns 1 if the tree's statistics, cached or not, are the same as freshly computed ones. */
+static int statsFresh(Node *n) {
+    NodeStats cached, fresh;
+    sds json = SerializeNodeToJSONSized(n, &(JSONSerializeOpt){"", "", ""});
+    Node_GetStats(n, &cached);
+    dropStats(n);
+    Node_GetStats(n, &fresh);
+    int ret = !memcmp(&cached, &fresh, sizeof(NodeStats)) && cached.bytes == sdslen(json);
+    sdsfree(json);
+    return ret;
+}
+
+MU_TEST(test_jo_stats) {
+    Node *n, *v;
+    NodeStats stats, before, after;
+    sds json = sdsnew("{\"items\":[");
+    for (int i = 0; i < 40; i++) {
+        json = sdscatprintf(json, "%s{\"id\":%d,\"n\":\"a\\t/%d\"}", i ? "," : "", i, i);
+    }
+    json = sdscat(json, "],\"ints\":[");
+    for (int i = 0; i < 40; i++) json = sdscatprintf(json, "%s%d", i ? "," : "", i * 1000 - 7);
+    json = sdscat(json, "],\"nums\":[");
+    for (int i = 0; i < 40; i++) {
+        json = sdscatprintf(json, "%s%.3f", i ? "," : "", i * 0.25 + 1e-9 * i);
+    }
+    json = sdscat(json, "],\"keys\":{");
+    for (int i = 0; i < 40; i++) json = sdscatprintf(json, "%s\"k%d\":%d", i ? "," : "", i, i);
+    json = sdscat(json, "},\"deep\":{\"a\":[1,\"x\",null,true,false,{}]}}");
+
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSON(json, sdslen(json), &n, NULL));
+    sdsfree(json);
+
+    // big containers cache their statistics once they're asked for
+    mu_check(OBJ_ERR == Node_GetCachedStats(n, &stats));
+    Node_GetStats(n, &stats);
+    mu_assert_int_eq(1 + 1 + 40 * 3 + 1 + 40 + 1 + 40 + 1 + 40 + 1 + 1 + 6, stats.values);
+    mu_assert_int_eq(stats.memory, stats.heap);
+    Node *items;
+    mu_check(OBJ_OK == Node_DictGet(n, "items", &items));
+    mu_check(OBJ_OK == Node_GetCachedStats(items, &stats));
+    mu_check(statsFresh(n));
+
+    // the containers' own changes are kept up to date
+    Node *ints, *nums, *keys;
+    mu_check(OBJ_OK == Node_DictGet(n, "ints", &ints));
+    mu_check(OBJ_OK == Node_DictGet(n, "nums", &nums));
+    mu_check(OBJ_OK == Node_DictGet(n, "keys", &keys));
+    mu_check(NODE_IS_PACKED_ARRAY(ints) && NODE_IS_PACKED_ARRAY(nums));
+
+    // keys are shared, so their size is kept apart from the memory of the nodes
+    Node_GetStats(keys, &stats);
+    mu_assert_int_eq(10 * 3 + 30 * 4, stats.keys);
+    mu_assert_int_eq(sizeof(Node) + __nodeEntriesSize(keys) + 40 * 2 * sizeof(Node), stats.memory);
+    Node_GetStats(n, &stats);
+    Node_GetStats(ints, &before);
+    Node_ArrayAppendInt(NULL, ints, -123456789);
+    Node_ArrayDelRange(ints, 3, 5);
+    Node_GetStats(ints, &after);
+    Node_UpdateStats(n, &before, &after);
+    Node_GetStats(keys, &before);
+    Node_DictSet(keys, "k3", NewCStringNode("\x01replaced"));
+    Node_DictSet(keys, "new\"key", NewArrayNode(0));
+    Node_DictDel(keys, "k7");
+    Node_GetStats(keys, &after);
+    Node_UpdateStats(n, &before, &after);
+    Node_GetStats(items, &before);
+    Node_ArrayDelRange(items, -2, 2);
+    Node_ArrayAppend(items, NewDictNode(1));
+    mu_check(OBJ_OK == Node_ArrayItem(items, 0, &v));
+    Node_ArraySet(items, 0, NewBoolNode(1));
+    Node_Free(v);
+    Node_GetStats(items, &after);
+    Node_UpdateStats(n, &before, &after);
+    mu_check(statsFresh(n));
+
+    // and so are the changes further down, and unpacking, when they go through a path
+    SearchPath sp = NewSearchPath(0);
+    mu_check(PARSE_OK == ParseJSONPath(".items[3]", 9, &sp));
+    mu_check(E_OK == SearchPath_Find(&sp, n, &v, NULL));
+    mu_check(SearchPath_HasStats(&sp, n, 2));
+    Node_GetStats(v, &before);
+    Node_DictSet(v, "n", NewCStringNode("a longer value than it was"));
+    Node_GetStats(v, &after);
+    SearchPath_UpdateStats(&sp, n, 2, &before, &after);
+    SearchPath_Free(&sp);
+
+    // while looking up a packed array's item copies it, and setting a matching number keeps it
+    Node scratch;
+    sp = NewSearchPath(0);
+    mu_check(PARSE_OK == ParseJSONPath(".nums[5]", 8, &sp));
+    mu_check(E_OK == SearchPath_Find(&sp, n, &v, &scratch));
+    mu_check(NODE_IS_PACKED_ARRAY(nums) && v == &scratch && N_NUMBER == v->type);
+    Node_GetStats(nums, &before);
+    mu_check(OBJ_OK == Node_ArraySet(nums, 5, NewDoubleNode(v->value.numval + 0.5)));
+    mu_check(OBJ_OK == Node_ArraySet(nums, 6, NewDoubleNode(1e300)));
+    mu_check(NODE_IS_PACKED_ARRAY(nums));
+    mu_check(OBJ_OK == Node_ArraySet(nums, 7, NewIntNode(7)));
+    mu_check(!NODE_IS_PACKED_ARRAY(nums));
+    Node_GetStats(nums, &after);
+    SearchPath_UpdateStats(&sp, n, 1, &before, &after);
+    SearchPath_Free(&sp);
+    mu_check(statsFresh(n));
+
+    // whatever is in the arena isn't on the heap
+    Node_Free(n);
+    NodeArena *a = NewNodeArena();
+    json = sdsnew("[");
+    for (int i = 0; i < 40; i++) {
+        json = sdscatprintf(json, "%s\"a string that isn't short %d\"", i ? "," : "", i);
+    }
+    json = sdscat(json, "]");
+    mu_check(JSONOBJECT_OK == CreateNodeFromJSONEx(json, sdslen(json), a, &n, NULL));
+    Node_GetStats(n, &stats);
+    mu_assert_int_eq(sdslen(json), stats.bytes);
+    mu_check(stats.memory > sdslen(json));
+    // the entries are created in the arena once their count is known, without spare capacity
+    mu_assert_int_eq(0, stats.heap);
+    mu_assert_int_eq(40, n->value.arrval.cap);
+    Node_ArrayAppend(n, NewCStringNode("a string on the heap"));  // they grow out of the arena
+    Node_GetStats(n, &stats);
+    mu_assert_int_eq(__nodeEntriesSize(n) + sizeof(Node) + 20, stats.heap);
+    mu_check(statsFresh(n));
+    sdsfree(json);
+    Node_Free(n);
+    NodeArena_Free(a);
+}
+
 MU_TEST_SUITE(test_json_literals) {
     MU_RUN_TEST(test_jo_create_literal_null);
     MU_RUN_TEST(test_jo_create_literal_true);
@@ -379,25 +956,43 @@ MU_TEST_SUITE(test_json_literals) {
     MU_RUN_TEST(test_jo_create_literal_string);
     MU_RUN_TEST(test_jo_create_literal_dict);
     MU_RUN_TEST(test_jo_create_literal_array);
+    MU_RUN_TEST(test_jo_create_literal_errors);
 }
 
-MU_TEST_SUITE(test_json_object) { MU_RUN_TEST(test_jo_create_object); }
+MU_TEST_SUITE(test_json_object) {
+    MU_RUN_TEST(test_jo_create_object);
+    MU_RUN_TEST(test_jo_create_arena);
+    MU_RUN_TEST(test_jo_parsers);
+    MU_RUN_TEST(test_jo_parser_reuse);
+    MU_RUN_TEST(test_jo_capacity);
+    MU_RUN_TEST(test_jo_pack);
+    MU_RUN_TEST(test_jo_stats);
+}
 
 MU_TEST_SUITE(test_object_to_json) {
     MU_RUN_TEST(test_oj_null);
     MU_RUN_TEST(test_oj_boolean);
     MU_RUN_TEST(test_oj_integer);
+    MU_RUN_TEST(test_oj_number);
     MU_RUN_TEST(test_oj_string);
     MU_RUN_TEST(test_oj_keyval);
     MU_RUN_TEST(test_oj_dict);
     MU_RUN_TEST(test_oj_array);
     MU_RUN_TEST(test_oj_special_characters);
+    MU_RUN_TEST(test_oj_utf8_key);
+    MU_RUN_TEST(test_oj_long_string);
+    MU_RUN_TEST(test_oj_length);
 }
 
 int main(int argc, char *argv[]) {
     MU_RUN_SUITE(test_json_literals);
     MU_RUN_SUITE(test_json_object);
     MU_RUN_SUITE(test_object_to_json);
+
+    // again with the indexed parser, which leaves the text that it rejects to jsonsl
+    jsonObjectParser = JSONOBJECT_PARSER_INDEXED;
+    MU_RUN_SUITE(test_json_literals);
+    MU_RUN_SUITE(test_json_object);
     MU_REPORT();
     return minunit_fail;
 }
\ No newline at end of file
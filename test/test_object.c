@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "../src/json_path.h"
+#include "../src/lazy_free.h"
+#include "../src/lru_cache.h"
 #include "../src/object.h"
 #include "../src/path.h"
 #include "minunit.h"
@@ -29,7 +31,25 @@ MU_TEST(testNodeString) {
     mu_assert_int_eq(OBJ_OK, Node_StringAppend(n1, n2));
     mu_check(NULL != n1);
     mu_assert_int_eq(6, Node_Length(n1));
-    mu_check(!strncmp(n1->value.strval.data, "foobar", Node_Length(n1)));
+    mu_check(!strncmp(NODE_STRING_DATA(n1), "foobar", Node_Length(n1)));
+    mu_check(n1->flags & NODE_F_INLINE);
+
+    // strings longer than the inline maximum move out of the node
+    mu_assert_int_eq(OBJ_OK, Node_StringAppend(n1, n1));
+    mu_assert_int_eq(OBJ_OK, Node_StringAppend(n1, n2));
+    mu_assert_int_eq(15, Node_Length(n1));
+    mu_check(n1->flags & NODE_F_INLINE);
+    mu_assert_int_eq(OBJ_OK, Node_StringAppend(n1, n2));
+    mu_assert_int_eq(18, Node_Length(n1));
+    mu_check(!(n1->flags & NODE_F_INLINE));
+    mu_check(!strcmp(NODE_STRING_DATA(n1), "foobarfoobarbarbar"));
+    Node_Free(n1);
+    Node_Free(n2);
+
+    n1 = NewStringNode("0123456789abcdef", 16);
+    mu_check(!(n1->flags & NODE_F_INLINE));
+    mu_check(!strcmp(NODE_STRING_DATA(n1), "0123456789abcdef"));
+    Node_Free(n1);
 }
 
 MU_TEST(testNodeArray) {
@@ -152,6 +172,105 @@ MU_TEST(testNodeArray) {
     Node_Free(arr);
 }
 
+MU_TEST(testNodePackedArray) {
+    Node *n, *sub, *arr = NewArrayNode(0);
+    Node scratch;
+    const Node *item;
+
+    // numbers of one type are packed as values
+    for (int i = 0; i < 10; i++) mu_check(OBJ_OK == Node_ArrayAppendInt(NULL, arr, i * 10));
+    mu_check(arr->flags & NODE_F_INT_ARRAY);
+    mu_assert_int_eq(10, Node_Length(arr));
+    item = Node_ArrayItemPeek(arr, 3, &scratch);
+    mu_check(N_INTEGER == item->type);
+    mu_check(item->flags & NODE_F_PACKED_ITEM);
+    mu_check(30 == item->value.intval);
+
+    // appending a matching node keeps the packing
+    mu_check(OBJ_OK == Node_ArrayAppend(arr, NewIntNode(100)));
+    mu_check(arr->flags & NODE_F_INT_ARRAY);
+    mu_assert_int_eq(11, Node_Length(arr));
+
+    // searching and deleting work on the values
+    n = NewIntNode(50);
+    mu_assert_int_eq(5, Node_ArrayIndex(arr, n, 0, 0));
+    mu_assert_int_eq(-1, Node_ArrayIndex(arr, n, 6, 0));
+    Node_Free(n);
+    n = NewDoubleNode(50);
+    mu_assert_int_eq(-1, Node_ArrayIndex(arr, n, 0, 0));
+    Node_Free(n);
+    mu_check(OBJ_OK == Node_ArrayDelRange(arr, 0, 2));
+    mu_assert_int_eq(9, Node_Length(arr));
+    mu_check(20 == Node_ArrayItemPeek(arr, 0, &scratch)->value.intval);
+    mu_check(100 == Node_ArrayItemPeek(arr, 8, &scratch)->value.intval);
+
+    // so does inserting matching numbers
+    sub = NewArrayNode(2);
+    mu_check(OBJ_OK == Node_ArrayAppend(sub, NewIntNode(-1)));
+    mu_check(OBJ_OK == Node_ArrayAppend(sub, NewIntNode(-2)));
+    mu_check(OBJ_OK == Node_ArrayInsert(arr, 1, sub));
+    mu_check(arr->flags & NODE_F_INT_ARRAY);
+    mu_assert_int_eq(11, Node_Length(arr));
+    mu_check(20 == Node_ArrayItemPeek(arr, 0, &scratch)->value.intval);
+    mu_check(-1 == Node_ArrayItemPeek(arr, 1, &scratch)->value.intval);
+    mu_check(-2 == Node_ArrayItemPeek(arr, 2, &scratch)->value.intval);
+    mu_check(30 == Node_ArrayItemPeek(arr, 3, &scratch)->value.intval);
+
+    // anything else unpacks the array to nodes
+    sub = NewArrayNode(1);
+    mu_check(OBJ_OK == Node_ArrayAppend(sub, NewDoubleNode(0.5)));
+    mu_check(OBJ_OK == Node_ArrayInsert(arr, -1, sub));
+    mu_check(!NODE_IS_PACKED_ARRAY(arr));
+    mu_assert_int_eq(12, Node_Length(arr));
+    mu_check(OBJ_OK == Node_ArrayItem(arr, 10, &n));
+    mu_check(N_NUMBER == n->type);
+    mu_check(OBJ_OK == Node_ArrayItem(arr, 11, &n));
+    mu_check(N_INTEGER == n->type && 100 == n->value.intval);
+    mu_check(!(n->flags & NODE_F_PACKED_ITEM));
+    Node_Free(arr);
+
+    // setting a matching number over a peeked item keeps the packing
+    arr = NewArrayNode(0);
+    mu_check(OBJ_OK == Node_ArrayAppendDouble(NULL, arr, 1.5));
+    mu_check(OBJ_OK == Node_ArrayAppendDouble(NULL, arr, 2.5));
+    mu_check(arr->flags & NODE_F_NUM_ARRAY);
+    n = (Node *)Node_ArrayItemPeek(arr, 0, &scratch);
+    mu_check(OBJ_OK == Node_ArraySet(arr, 0, NewDoubleNode(-3.5)));
+    Node_Free(n);
+    mu_check(arr->flags & NODE_F_NUM_ARRAY);
+    mu_check(-3.5 == Node_ArrayItemPeek(arr, 0, &scratch)->value.numval);
+
+    // setting anything else, or getting an item for a change, unpacks the array
+    mu_check(OBJ_OK == Node_ArraySet(arr, 0, NewIntNode(7)));
+    mu_check(!NODE_IS_PACKED_ARRAY(arr));
+    mu_check(OBJ_OK == Node_ArrayItem(arr, 0, &n));
+    mu_check(N_INTEGER == n->type && 7 == n->value.intval);
+    mu_check(OBJ_OK == Node_ArrayItem(arr, 1, &n));
+    mu_check(!NODE_IS_PACKED_ARRAY(arr));
+    mu_check(N_NUMBER == n->type && 2.5 == n->value.numval);
+    mu_check(OBJ_OK == Node_ArraySet(arr, 1, NULL));
+    Node_Free(n);
+    mu_check(OBJ_OK == Node_ArrayItem(arr, 0, &n));
+    mu_check(OBJ_OK == Node_ArraySet(arr, 0, NewCStringNode("foo")));
+    Node_Free(n);
+    mu_check(OBJ_OK == Node_ArrayAppendInt(NULL, arr, 1));
+    mu_check(!NODE_IS_PACKED_ARRAY(arr));
+    mu_assert_int_eq(3, Node_Length(arr));
+    Node_Free(arr);
+
+    // an arena's array keeps its entries in the arena until it is unpacked
+    NodeArena *a = NewNodeArena();
+    arr = NewArrayNodeEx(a, 1);
+    for (int i = 0; i < 100; i++) mu_check(OBJ_OK == Node_ArrayAppendDouble(a, arr, i / 4.0));
+    mu_check(arr->flags & NODE_F_NUM_ARRAY);
+    mu_check(OBJ_OK == Node_ArrayAppend(arr, NewCStringNode("bar")));
+    mu_check(!(arr->flags & (NODE_F_NUM_ARRAY | NODE_F_ARENA_ENTRIES)));
+    mu_check(24.75 == Node_ArrayItemPeek(arr, 99, &scratch)->value.numval);
+    mu_check(N_STRING == Node_ArrayItemPeek(arr, 100, &scratch)->type);
+    Node_Free(arr);
+    NodeArena_Free(a);
+}
+
 MU_TEST(testObject) {
     Node *root = NewDictNode(1);
     mu_check(root != NULL);
@@ -183,6 +302,263 @@ MU_TEST(testObject) {
     Node_Free(root);
 }
 
+MU_TEST(testObjectIndexed) {
+    Node *root = NewDictNode(1);
+    Node *n;
+    char key[32];
+    const int count = 1000;
+
+    // grow past the index threshold
+    for (int i = 0; i < count; i++) {
+        sprintf(key, "key%d", i);
+        mu_check(OBJ_OK == Node_DictSet(root, key, NewIntNode(i)));
+    }
+    mu_assert_int_eq(count, Node_Length(root));
+    mu_check(__dictIndexCap(root->value.dictval.cap) > 0);
+
+    // replacing keeps the length
+    mu_check(OBJ_OK == Node_DictSet(root, "key42", NewIntNode(-42)));
+    mu_assert_int_eq(count, Node_Length(root));
+    mu_check(OBJ_OK == Node_DictGet(root, "key42", &n));
+    mu_check(-42 == n->value.intval);
+
+    // entries are kept in insertion order
+    mu_check(!strcmp("key0", root->value.dictval.entries[0]->value.kvval.key));
+    mu_check(!strcmp("key999", root->value.dictval.entries[count - 1]->value.kvval.key));
+
+    // delete every odd key
+    for (int i = 1; i < count; i += 2) {
+        sprintf(key, "key%d", i);
+        mu_check(OBJ_OK == Node_DictDel(root, key));
+    }
+    mu_assert_int_eq(count / 2, Node_Length(root));
+    mu_check(OBJ_ERR == Node_DictDel(root, "key1"));
+
+    // all remaining keys can still be found, and deleted ones can't
+    for (int i = 0; i < count; i++) {
+        sprintf(key, "key%d", i);
+        if (i % 2) {
+            mu_check(OBJ_ERR == Node_DictGet(root, key, &n));
+        } else {
+            mu_check(OBJ_OK == Node_DictGet(root, key, &n));
+            mu_check((42 == i ? -42 : i) == n->value.intval);
+        }
+    }
+
+    Node_Free(root);
+}
+
+MU_TEST(testNodeArena) {
+    NodeArena *a = NewNodeArena();
+    Node *root = NewDictNodeEx(a, 1);
+    Node *arr = NewArrayNodeEx(a, 1);
+    Node *str = NewStringNodeEx(a, "foo is a long string", 20);
+    Node *n;
+    char key[32];
+
+    mu_check(root->flags & NODE_F_ARENA);
+    mu_check(str->flags & NODE_F_ARENA_DATA);
+    mu_check(a->size > 0);
+
+    // grown containers move their entries to the heap
+    mu_check(OBJ_OK == Node_DictSet(root, "arr", arr));
+    mu_check(OBJ_OK == Node_DictSet(root, "str", str));
+    mu_check(!(root->flags & NODE_F_ARENA_ENTRIES));
+    for (int i = 0; i < 100; i++) {
+        sprintf(key, "key%d", i);
+        mu_check(OBJ_OK == Node_DictSet(root, key, NewIntNodeEx(a, i)));
+        mu_check(OBJ_OK == Node_ArrayAppend(arr, NewIntNode(i)));
+    }
+    mu_assert_int_eq(102, Node_Length(root));
+    mu_assert_int_eq(100, Node_Length(arr));
+
+    // so do appended strings
+    mu_check(OBJ_OK == Node_StringAppend(str, NewStringNodeEx(a, "bar", 3)));
+    mu_check(OBJ_OK == Node_DictGet(root, "str", &n));
+    mu_assert_int_eq(23, NODE_STRING_LEN(n));
+    mu_check(!strcmp("foo is a long stringbar", NODE_STRING_DATA(n)));
+    mu_check(!(n->flags & NODE_F_ARENA_DATA));
+
+    // replacing and deleting arena nodes mixes fine with heap nodes
+    mu_check(OBJ_OK == Node_DictSet(root, "key42", NewIntNode(-42)));
+    mu_check(OBJ_OK == Node_DictDel(root, "key43"));
+    mu_check(OBJ_OK == Node_DictGet(root, "key42", &n));
+    mu_check(-42 == n->value.intval);
+
+    // rewinding releases what was allocated since the mark, including new chunks
+    NodeArenaMark mark;
+    size_t size = a->size;
+    NodeArena_Mark(a, &mark);
+    void *p = NodeArena_Alloc(a, 8, 8);
+    for (int i = 0; i < 100; i++) NodeArena_Alloc(a, 4096, 1);
+    mu_check(a->size > size);
+    NodeArena_Rewind(a, &mark);
+    mu_assert_int_eq(size, a->size);
+    mu_check(p == NodeArena_Alloc(a, 8, 8));
+
+    Node_Free(root);
+    NodeArena_Free(a);
+}
+
+MU_TEST(testKeyIntern) {
+    KeyInternStats before, stats;
+    Key_GetInternStats(&before);
+
+    // identical keys in different objects and arenas are shared
+    NodeArena *a = NewNodeArena();
+    Node *d1 = NewDictNode(1);
+    Node *d2 = NewDictNodeEx(a, 1);
+    mu_check(OBJ_OK == Node_DictSet(d1, "interned", NewIntNode(1)));
+    mu_check(OBJ_OK == Node_DictSetKeyVal(d2, NewKeyValNodeEx(a, "internedXX", 8, NewIntNode(2))));
+    mu_check(OBJ_OK == Node_DictSet(d2, "other", NULL));
+    const char *k1 = d1->value.dictval.entries[0]->value.kvval.key;
+    const char *k2 = d2->value.dictval.entries[0]->value.kvval.key;
+    mu_check(k1 == k2);
+    mu_check(!strcmp("interned", k1));
+
+    Key_GetInternStats(&stats);
+    mu_assert_int_eq(before.keys + 2, stats.keys);
+    mu_assert_int_eq(before.refs + 3, stats.refs);
+    mu_assert_int_eq(before.refsize + 2 * 9 + 6, stats.refsize);
+
+    // all the references together are charged all of the interned keys
+    mu_assert_int_eq(stats.size, Key_SharedSizeOf(stats.refsize));
+
+    // keys are freed with their last reference
+    Node_Free(d1);
+    Key_GetInternStats(&stats);
+    mu_assert_int_eq(before.keys + 2, stats.keys);
+    mu_assert_int_eq(before.refs + 2, stats.refs);
+    Node_Free(d2);
+    NodeArena_Free(a);
+    Key_GetInternStats(&stats);
+    mu_assert_int_eq(before.keys, stats.keys);
+    mu_assert_int_eq(before.refs, stats.refs);
+    mu_assert_int_eq(before.size, stats.size);
+
+    // many keys grow the table
+    Node *d = NewDictNode(1);
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        mu_check(OBJ_OK == Node_DictSet(d, key, NULL));
+    }
+    Node *n;
+    mu_check(OBJ_OK == Node_DictGet(d, "key999", &n));
+    Key_GetInternStats(&stats);
+    mu_assert_int_eq(before.keys + 1000, stats.keys);
+    Node_Free(d);
+}
+
+MU_TEST(testLazyFree) {
+    KeyInternStats before, stats;
+    LazyFreeStats lfbefore, lfstats;
+    Key_GetInternStats(&before);
+    LazyFree_GetStats(&lfbefore);
+
+    // the effort is the number of nodes, and counting stops past the limit
+    Node *d = NewDictNode(1);
+    mu_check(OBJ_OK == Node_DictSet(d, "a", NewIntNode(1)));
+    mu_check(OBJ_OK == Node_DictSet(d, "b", NULL));
+    mu_assert_int_eq(4, LazyFree_Effort(d, 100));
+    mu_assert_int_eq(0, LazyFree_Effort(NULL, 100));
+    Node *arr = NewArrayNode(1);
+    for (int i = 0; i < 100; i++) Node_ArrayAppend(arr, NewStringNode("x", 1));
+    mu_check(OBJ_OK == Node_DictSet(d, "c", arr));
+    mu_assert_int_eq(11, LazyFree_Effort(d, 10));
+    mu_assert_int_eq(106, LazyFree_Effort(d, 1000));
+
+    // a packed array is freed at once
+    Node *ints = NewArrayNode(1);
+    for (int i = 0; i < 100; i++) Node_ArrayAppendInt(NULL, ints, i);
+    mu_check(NODE_IS_PACKED_ARRAY(ints));
+    mu_assert_int_eq(1, LazyFree_Effort(ints, 1000));
+    Node_Free(ints);
+
+    // trees are freed on the background thread while keys are interned and released on this one
+    NodeArena *a = NewNodeArena();
+    Node *big = NewDictNodeEx(a, 1);
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        mu_check(OBJ_OK == Node_DictSetKeyVal(
+                               big, NewKeyValNodeEx(a, key, strlen(key), NewStringNode(key, 20))));
+    }
+    LazyFree_Node(big, a);
+    LazyFree_Node(d, NULL);
+    for (int i = 0; i < 100; i++) {
+        Node *o = NewDictNode(1);
+        sprintf(key, "key%d", i);
+        mu_check(OBJ_OK == Node_DictSet(o, key, NULL));
+        Node_Free(o);
+    }
+    LazyFree_Wait();
+
+    LazyFree_GetStats(&lfstats);
+    mu_assert_int_eq(0, lfstats.pending);
+    mu_assert_int_eq(lfbefore.freed + 2, lfstats.freed);
+    Key_GetInternStats(&stats);
+    mu_assert_int_eq(before.keys, stats.keys);
+    mu_assert_int_eq(before.refs, stats.refs);
+    mu_assert_int_eq(before.size, stats.size);
+}
+
+static int lruFreed = 0;
+static void lruFree(void *value) {
+    lruFreed++;
+    free(value);
+}
+
+MU_TEST(testLRUCache) {
+    char key[32];
+    size_t esize = 100;  // the values' size, entries also account for their keys and overhead
+    LRUCache *c = NewLRUCache(10 * esize, lruFree);
+    lruFreed = 0;
+
+    // fill it up until it starts evicting
+    int i = 0;
+    while (!c->evictions) {
+        sprintf(key, "key%d", i++);
+        LRUCache_Put(c, key, strlen(key), strdup(key), esize);
+    }
+    mu_check(c->size <= c->maxsize);
+    mu_assert_int_eq(1, lruFreed);
+    mu_check(NULL == LRUCache_Get(c, "key0", 4));
+    mu_check(!strcmp("key1", LRUCache_Get(c, "key1", 4)));
+
+    // key1 is now the most recently used so key2 is evicted next
+    sprintf(key, "key%d", i++);
+    LRUCache_Put(c, key, strlen(key), strdup(key), esize);
+    mu_check(NULL == LRUCache_Get(c, "key2", 4));
+    mu_check(NULL != LRUCache_Get(c, "key1", 4));
+    mu_assert_int_eq(2, c->hits);
+    mu_assert_int_eq(2, c->misses);
+
+    // replacing a value frees the old one, values that are too big aren't cached
+    size_t entries = c->entries;
+    LRUCache_Put(c, "key1", 4, strdup("new"), esize);
+    mu_assert_int_eq(entries, c->entries);
+    mu_check(!strcmp("new", LRUCache_Get(c, "key1", 4)));
+    LRUCache_Put(c, "big", 3, strdup("big"), c->maxsize);
+    mu_check(NULL == LRUCache_Get(c, "big", 3));
+
+    // lots of entries make the table grow
+    LRUCache_Free(c);
+    c = NewLRUCache(SIZE_MAX, lruFree);
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        LRUCache_Put(c, key, strlen(key), strdup(key), 1);
+    }
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        mu_check(!strcmp(key, LRUCache_Get(c, key, strlen(key))));
+    }
+    LRUCache_Clear(c);
+    mu_assert_int_eq(0, c->entries);
+    mu_assert_int_eq(0, c->size);
+    LRUCache_Free(c);
+}
+
 MU_TEST(testPath) {
     Node *root = NewDictNode(1);
     mu_check(root != NULL);
@@ -200,14 +576,14 @@ MU_TEST(testPath) {
     SearchPath_AppendKey(&sp, "baz", 3);
     SearchPath_AppendIndex(&sp, 0);
 
-    Node *n = NULL;
-    PathError pe = SearchPath_Find(&sp, root, &n);
+    Node *n = NULL, scratch;
+    PathError pe = SearchPath_Find(&sp, root, &n, &scratch);
 
     mu_check(pe == E_OK);
     mu_check(n != NULL);
 
     mu_check(n->type == N_STRING);
-    mu_check(!strcmp(n->value.strval.data, "hello"));
+    mu_check(!strncmp(NODE_STRING_DATA(n), "hello", NODE_STRING_LEN(n)));
 
     SearchPath_Free(&sp);
     Node_Free(root);
@@ -242,18 +618,18 @@ MU_TEST(testPathEx) {
     sp = NewSearchPath(2);
     SearchPath_AppendKey(&sp, "arr", 3);
     SearchPath_AppendIndex(&sp, 0);
-    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel);
+    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel, NULL);
     mu_check(pe == E_OK);
     mu_check(arr == p);
     mu_check(n != NULL);
     mu_check(n->type == N_STRING);
-    mu_check(!strcmp(n->value.strval.data, "hello"));
+    mu_check(!strncmp(NODE_STRING_DATA(n), "hello", NODE_STRING_LEN(n)));
     SearchPath_Free(&sp);
 
     // check for non existing key in root
     sp = NewSearchPath(1);
     SearchPath_AppendKey(&sp, "qux", 3);
-    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel);
+    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel, NULL);
     mu_check(E_NOKEY == pe);
     mu_check(0 == errlevel);
     mu_check(p == root);
@@ -263,7 +639,7 @@ MU_TEST(testPathEx) {
     sp = NewSearchPath(2);
     SearchPath_AppendKey(&sp, "dict", 4);
     SearchPath_AppendKey(&sp, "f0", 2);
-    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel);
+    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel, NULL);
     mu_check(E_NOKEY == pe);
     mu_check(1 == errlevel);
     mu_check(p == dict);
@@ -273,7 +649,7 @@ MU_TEST(testPathEx) {
     sp = NewSearchPath(2);
     SearchPath_AppendKey(&sp, "foo", 3);
     SearchPath_AppendIndex(&sp, 0);
-    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel);
+    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel, NULL);
     mu_check(E_BADTYPE == pe);
     mu_check(1 == errlevel);
     SearchPath_Free(&sp);
@@ -282,7 +658,7 @@ MU_TEST(testPathEx) {
     sp = NewSearchPath(2);
     SearchPath_AppendKey(&sp, "arr", 3);
     SearchPath_AppendIndex(&sp, 99);
-    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel);
+    pe = SearchPath_FindEx(&sp, root, &n, &p, &errlevel, NULL);
     mu_check(E_NOINDEX == pe);
     mu_check(1 == errlevel);
     mu_check(arr == p);
@@ -292,7 +668,7 @@ MU_TEST(testPathEx) {
 }
 
 MU_TEST(testPathArray) {
-    Node *n, *arr = NewArrayNode(0);
+    Node *n, scratch, *arr = NewArrayNode(0);
     SearchPath sp;
     PathError pe;
 
@@ -308,7 +684,7 @@ MU_TEST(testPathArray) {
     for (int i = 0; i < 5; i++) {
         sp = NewSearchPath(1);
         SearchPath_AppendIndex(&sp, i);
-        pe = SearchPath_Find(&sp, arr, &n);
+        pe = SearchPath_Find(&sp, arr, &n, &scratch);
         mu_check(pe == E_OK);
         mu_check(NULL != n);
         mu_check(N_INTEGER == n->type);
@@ -320,7 +696,7 @@ MU_TEST(testPathArray) {
     for (int i = -1; i > -6; i--) {
         sp = NewSearchPath(1);
         SearchPath_AppendIndex(&sp, i);
-        pe = SearchPath_Find(&sp, arr, &n);
+        pe = SearchPath_Find(&sp, arr, &n, &scratch);
         mu_check(pe == E_OK);
         mu_check(NULL != n);
         mu_check(N_INTEGER == n->type);
@@ -331,13 +707,13 @@ MU_TEST(testPathArray) {
     // verify that out of bounds access errs
     sp = NewSearchPath(1);
     SearchPath_AppendIndex(&sp, 5);
-    pe = SearchPath_Find(&sp, arr, &n);
+    pe = SearchPath_Find(&sp, arr, &n, &scratch);
     mu_check(E_NOINDEX == pe);
     SearchPath_Free(&sp);
 
     sp = NewSearchPath(1);
     SearchPath_AppendIndex(&sp, -6);
-    pe = SearchPath_Find(&sp, arr, &n);
+    pe = SearchPath_Find(&sp, arr, &n, &scratch);
     mu_check(E_NOINDEX == pe);
     SearchPath_Free(&sp);
 
@@ -365,8 +741,10 @@ MU_TEST(testPathParse) {
 
     const char *badpaths[] = {
         "3",        "6379",        "foo[bar]", "foo[]",         "foo[3",        "bar[\"]",
-        "foo..bar", "foo[\"bar']", "foo/bar",  "foo.bar[-1.2]", "foo.bar[1.1]", "foo.bar[+3]",
-        "1foo",     "f?oo",        "foo\n",    "foo\tbar",      "foobar[-i]",   NULL};
+        "foo..",    "foo[\"bar']", "foo/bar",  "foo.bar[-1.2]", "foo.bar[1.1]", "foo.bar[+3]",
+        "1foo",     "f?oo",        "foo\n",    "foo\tbar",      "foobar[-i]",   "foo...bar",
+        "foo.*bar", "foo[*",       "foo[**]",  "..",            "foo[1:2:0]",   "foo[1,,2]",
+        "foo[:::]", "foo[1,]",     "foo[1:x]", "foo[1,\"a]", NULL};
 
     for (int idx = 0; badpaths[idx] != NULL; idx++) {
         mu_check(ParseJSONPath(badpaths[idx], strlen(badpaths[idx]), &sp) == PARSE_ERR);
@@ -387,17 +765,304 @@ MU_TEST(testPathParseRoot) {
     SearchPath_Free(&sp);
 }
 
+MU_TEST(testPathParseWildcard) {
+    const char *path = "foo.*[*]..bar..*..[2]";
+
+    SearchPath sp = NewSearchPath(0);
+    int rc = ParseJSONPath(path, strlen(path), &sp);
+    mu_assert_int_eq(rc, PARSE_OK);
+    mu_assert_int_eq(sp.len, 9);
+    mu_check(SearchPath_IsMulti(&sp));
+
+    mu_check(sp.nodes[0].type == NT_KEY && !strcmp(sp.nodes[0].value.key, "foo"));
+    mu_check(sp.nodes[1].type == NT_WILDCARD);
+    mu_check(sp.nodes[2].type == NT_WILDCARD);
+    mu_check(sp.nodes[3].type == NT_DEEPSCAN);
+    mu_check(sp.nodes[4].type == NT_KEY && !strcmp(sp.nodes[4].value.key, "bar"));
+    mu_check(sp.nodes[5].type == NT_DEEPSCAN);
+    mu_check(sp.nodes[6].type == NT_WILDCARD);
+    mu_check(sp.nodes[7].type == NT_DEEPSCAN);
+    mu_check(sp.nodes[8].type == NT_INDEX && sp.nodes[8].value.index == 2);
+    SearchPath_Free(&sp);
+
+    const char *multipaths[] = {"*", ".*", "[*]", "..foo", ".foo[0]..*", NULL};
+    for (int idx = 0; multipaths[idx] != NULL; idx++) {
+        sp = NewSearchPath(0);
+        mu_check(ParseJSONPath(multipaths[idx], strlen(multipaths[idx]), &sp) == PARSE_OK);
+        mu_check(SearchPath_IsMulti(&sp));
+        SearchPath_Free(&sp);
+    }
+
+    sp = NewSearchPath(0);
+    mu_check(ParseJSONPath("foo.bar[1]", 10, &sp) == PARSE_OK);
+    mu_check(!SearchPath_IsMulti(&sp));
+    SearchPath_Free(&sp);
+}
+
+MU_TEST(testPathParseSlice) {
+    const char *path = "foo[1:-1][::2][-2:][3:1:-1][0,-1][\"a\",'b,c',2]";
+
+    SearchPath sp = NewSearchPath(0);
+    int rc = ParseJSONPath(path, strlen(path), &sp);
+    mu_assert_int_eq(rc, PARSE_OK);
+    mu_assert_int_eq(sp.len, 7);
+    mu_check(SearchPath_IsMulti(&sp));
+
+    struct {
+        int start, end, step, flags;
+    } slices[] = {
+        {1, -1, 1, PATH_SLICE_START | PATH_SLICE_END},
+        {0, 0, 2, 0},
+        {-2, 0, 1, PATH_SLICE_START},
+        {3, 1, -1, PATH_SLICE_START | PATH_SLICE_END},
+    };
+    for (int i = 0; i < 4; i++) {
+        PathNode *pn = &sp.nodes[i + 1];
+        mu_check(NT_SLICE == pn->type);
+        mu_assert_int_eq(slices[i].flags, pn->value.slice.flags);
+        mu_assert_int_eq(slices[i].step, pn->value.slice.step);
+        if (slices[i].flags & PATH_SLICE_START)
+            mu_assert_int_eq(slices[i].start, pn->value.slice.start);
+        if (slices[i].flags & PATH_SLICE_END) mu_assert_int_eq(slices[i].end, pn->value.slice.end);
+    }
+
+    PathNode *items = sp.nodes[5].value.items.nodes;
+    mu_check(NT_UNION == sp.nodes[5].type);
+    mu_assert_int_eq(2, sp.nodes[5].value.items.len);
+    mu_check(NT_INDEX == items[0].type && 0 == items[0].value.index);
+    mu_check(NT_INDEX == items[1].type && -1 == items[1].value.index);
+
+    items = sp.nodes[6].value.items.nodes;
+    mu_check(NT_UNION == sp.nodes[6].type);
+    mu_assert_int_eq(3, sp.nodes[6].value.items.len);
+    mu_check(NT_KEY == items[0].type && !strcmp("a", items[0].value.key));
+    mu_check(NT_KEY == items[1].type && !strcmp("b,c", items[1].value.key));
+    mu_check(NT_INDEX == items[2].type && 2 == items[2].value.index);
+
+    SearchPath_Free(&sp);
+}
+
+static int collectIntegers(const SearchPathMatch *m, void *ctx) {
+    Node *arr = ctx;
+    if (m->n && N_INTEGER == m->n->type) Node_ArrayAppend(arr, NewIntNode(m->n->value.intval));
+    return arr->value.arrval.len >= 100;
+}
+
+MU_TEST(testPathFindAll) {
+    // {"a": {"x": 1, "y": [2, 3]}, "b": [{"x": 4}, {"x": 5, "z": {"x": 6}}], "c": [7, 8, 9]}
+    Node *root = NewDictNode(3);
+    Node *a = NewDictNode(2), *y = NewArrayNode(2);
+    Node_ArrayAppend(y, NewIntNode(2));
+    Node_ArrayAppend(y, NewIntNode(3));
+    Node_DictSet(a, "x", NewIntNode(1));
+    Node_DictSet(a, "y", y);
+    Node_DictSet(root, "a", a);
+
+    Node *b = NewArrayNode(2), *b0 = NewDictNode(1), *b1 = NewDictNode(2), *z = NewDictNode(1);
+    Node_DictSet(b0, "x", NewIntNode(4));
+    Node_DictSet(z, "x", NewIntNode(6));
+    Node_DictSet(b1, "x", NewIntNode(5));
+    Node_DictSet(b1, "z", z);
+    Node_ArrayAppend(b, b0);
+    Node_ArrayAppend(b, b1);
+    Node_DictSet(root, "b", b);
+
+    // a packed array
+    Node *c = NewArrayNode(3);
+    for (int i = 7; i < 10; i++) Node_ArrayAppendInt(NULL, c, i);
+    mu_check(NODE_IS_PACKED_ARRAY(c));
+    Node_DictSet(root, "c", c);
+
+    struct {
+        const char *path;
+        int count;  // of matches, some of which may not be integers
+        int nints;
+        int64_t ints[9];
+    } cases[] = {
+        {"b[*].x", 2, 2, {4, 5}},
+        {"*.x", 1, 1, {1}},
+        {"..x", 4, 4, {1, 4, 5, 6}},
+        {"..*", 16, 9, {1, 2, 3, 4, 5, 6, 7, 8, 9}},
+        {"c[*]", 3, 3, {7, 8, 9}},
+        {"..[-1]", 3, 2, {3, 9}},
+        {"c[1]", 1, 1, {8}},
+        {"b[*].nope", 0, 0, {0}},
+        {".", 1, 0, {0}},
+        {"c[0:2]", 2, 2, {7, 8}},
+        {"c[::-1]", 3, 3, {9, 8, 7}},
+        {"c[-2:]", 2, 2, {8, 9}},
+        {"c[5:]", 0, 0, {0}},
+        {"c[2,0,7]", 2, 2, {9, 7}},
+        {"a[\"x\",'nope','y'][0]", 1, 1, {2}},
+        {"..y[1:]", 1, 1, {3}},
+        {"b[*]['x','z'].x", 1, 1, {6}},
+    };
+
+    for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        SearchPath sp = NewSearchPath(0);
+        mu_check(PARSE_OK == ParseJSONPath(cases[i].path, strlen(cases[i].path), &sp));
+        Node *found = NewArrayNode(1);
+        mu_assert_int_eq(cases[i].count, SearchPath_FindAll(&sp, root, collectIntegers, found));
+        mu_assert_int_eq(cases[i].nints, Node_Length(found));
+        for (int j = 0; j < cases[i].nints; j++) {
+            Node *n;
+            Node_ArrayItem(found, j, &n);
+            mu_assert_int_eq(cases[i].ints[j], n->value.intval);
+        }
+        Node_Free(found);
+        SearchPath_Free(&sp);
+    }
+
+    // a lookup doesn't unpack, and the single node lookups refuse multiple matches
+    mu_check(NODE_IS_PACKED_ARRAY(c));
+    Node *n;
+    int errlevel;
+    SearchPath sp = NewSearchPath(0);
+    ParseJSONPath("b[*].x", 6, &sp);
+    mu_check(E_MULTI == SearchPath_Find(&sp, root, &n, NULL));
+    mu_check(E_MULTI == SearchPath_FindEx(&sp, root, &n, &a, &errlevel, NULL));
+    mu_assert_int_eq(1, errlevel);
+    SearchPath_Free(&sp);
+
+    // the callback can stop the search
+    sp = NewSearchPath(0);
+    ParseJSONPath("..*", 3, &sp);
+    Node *found = NewArrayNode(1);
+    for (int i = 0; i < 99; i++) Node_ArrayAppend(found, NULL);
+    mu_assert_int_eq(4, SearchPath_FindAll(&sp, root, collectIntegers, found));
+    Node_Free(found);
+    SearchPath_Free(&sp);
+
+    Node_Free(root);
+}
+
+static int collectIds(const SearchPathMatch *m, void *ctx) {
+    Node *id;
+    if (m->n && N_DICT == m->n->type && OBJ_OK == Node_DictGet(m->n, "id", &id)) {
+        Node_ArrayAppend((Node *)ctx, NewIntNode(id->value.intval));
+    } else if (m->n && N_INTEGER == m->n->type) {
+        Node_ArrayAppend((Node *)ctx, NewIntNode(m->n->value.intval));
+    }
+    return 0;
+}
+
+MU_TEST(testPathFilter) {
+    // {"orders": [{"id": 1, "status": "open", "total": 10.5, "tags": ["a"]},
+    //             {"id": 2, "status": "closed", "total": 3},
+    //             {"id": 3, "status": "open", "total": 30, "rush": true}, {"id": 4}],
+    //  "nums": [1, ..., 10]}
+    Node *root = NewDictNode(2), *orders = NewArrayNode(4), *o, *tags = NewArrayNode(1);
+    o = NewDictNode(4);
+    Node_DictSet(o, "id", NewIntNode(1));
+    Node_DictSet(o, "status", NewStringNode("open", 4));
+    Node_DictSet(o, "total", NewDoubleNode(10.5));
+    Node_ArrayAppend(tags, NewStringNode("a", 1));
+    Node_DictSet(o, "tags", tags);
+    Node_ArrayAppend(orders, o);
+    o = NewDictNode(3);
+    Node_DictSet(o, "id", NewIntNode(2));
+    Node_DictSet(o, "status", NewStringNode("closed", 6));
+    Node_DictSet(o, "total", NewIntNode(3));
+    Node_ArrayAppend(orders, o);
+    o = NewDictNode(4);
+    Node_DictSet(o, "id", NewIntNode(3));
+    Node_DictSet(o, "status", NewStringNode("open", 4));
+    Node_DictSet(o, "total", NewIntNode(30));
+    Node_DictSet(o, "rush", NewBoolNode(1));
+    Node_ArrayAppend(orders, o);
+    o = NewDictNode(1);
+    Node_DictSet(o, "id", NewIntNode(4));
+    Node_ArrayAppend(orders, o);
+    Node_DictSet(root, "orders", orders);
+    Node *nums = NewArrayNode(10);
+    for (int i = 1; i <= 10; i++) Node_ArrayAppendInt(NULL, nums, i);
+    Node_DictSet(root, "nums", nums);
+
+    struct {
+        const char *path;
+        int nids;
+        int64_t ids[4];
+    } cases[] = {
+        {"orders[?(@.status==\"open\")]", 2, {1, 3}},
+        {"orders[?(@.status != 'open')]", 2, {2, 4}},
+        {"orders[?(@.total > 5 && @.total <= 30)]", 2, {1, 3}},
+        {"orders[?(@.total < 5 || @.rush)]", 2, {2, 3}},
+        {"orders[?(!@.status)]", 1, {4}},
+        {"orders[?(@.tags[0] == 'a')]", 1, {1}},
+        {"orders[?(@['rush'] == true)]", 1, {3}},
+        {"orders[?( (@.id >= 2) && !(@.status == \"open\") )]", 2, {2, 4}},
+        {"orders[?(@.total == 3.0)].id", 1, {2}},
+        {"orders[?(@.status > \"c\")]", 3, {1, 2, 3}},
+        {"orders[?(@.status == null || @.total == false)]", 0, {0}},
+        {"orders[?(@.id == -1 || @.id == 2e0)]", 1, {2}},
+        {"..[?(@.id == 4)]", 1, {4}},
+        {"nums[?(@ > 7)]", 3, {8, 9, 10}},
+        {"nums[?(@ >= 2.5 && @ < 4)]", 1, {3}},
+        {"*[?(@ == 5 || @.id == 1)]", 2, {1, 5}},
+    };
+
+    for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        SearchPath sp = NewSearchPath(0);
+        mu_check(PARSE_OK == ParseJSONPath(cases[i].path, strlen(cases[i].path), &sp));
+        mu_check(SearchPath_IsMulti(&sp));
+        Node *found = NewArrayNode(1);
+        SearchPath_FindAll(&sp, root, collectIds, found);
+        mu_assert_int_eq(cases[i].nids, Node_Length(found));
+        for (int j = 0; j < cases[i].nids && j < Node_Length(found); j++) {
+            Node *n;
+            Node_ArrayItem(found, j, &n);
+            mu_assert_int_eq(cases[i].ids[j], n->value.intval);
+        }
+        Node_Free(found);
+        SearchPath_Free(&sp);
+    }
+    mu_check(NODE_IS_PACKED_ARRAY(nums));
+
+    const char *badpaths[] = {"foo[?(@.a ==)]",        "foo[?(@.a = 1)]",   "foo[?(@.a == 1]",
+                              "foo[?@.a]",             "foo[?(@..a)]",      "foo[?(@.a[?(@.b)])]",
+                              "foo[?(@.a == \"x)]",    "foo[?()]",          "foo[?(1 2)]",
+                              "foo[?(@.a && )]",       "foo[?(@.a[*])]",    "foo[?(@.a == 1 - 2)]",
+                              "foo[?(truex)]",         "foo[?(@.a)",        NULL};
+    for (int idx = 0; badpaths[idx] != NULL; idx++) {
+        SearchPath sp = NewSearchPath(0);
+        mu_check(PARSE_ERR == ParseJSONPath(badpaths[idx], strlen(badpaths[idx]), &sp));
+        SearchPath_Free(&sp);
+    }
+
+    // the nesting is limited, as is the stack that evaluates the expression
+    char deep[256] = "foo[?(";
+    for (int i = 0; i < 40; i++) strcat(deep, "(");
+    strcat(deep, "@");
+    for (int i = 0; i < 40; i++) strcat(deep, ")");
+    strcat(deep, ")]");
+    SearchPath sp = NewSearchPath(0);
+    mu_check(PARSE_ERR == ParseJSONPath(deep, strlen(deep), &sp));
+    SearchPath_Free(&sp);
+
+    Node_Free(root);
+}
+
 MU_TEST_SUITE(test_object) {
     // MU_SUITE_CONFIGURE(&test_setup, &test_teardown);
 
     MU_RUN_TEST(testNodeString);
     MU_RUN_TEST(testNodeArray);
+    MU_RUN_TEST(testNodePackedArray);
     MU_RUN_TEST(testObject);
+    MU_RUN_TEST(testObjectIndexed);
+    MU_RUN_TEST(testNodeArena);
+    MU_RUN_TEST(testKeyIntern);
+    MU_RUN_TEST(testLazyFree);
+    MU_RUN_TEST(testLRUCache);
     MU_RUN_TEST(testPath);
     MU_RUN_TEST(testPathEx);
     MU_RUN_TEST(testPathArray);
     MU_RUN_TEST(testPathParse);
     MU_RUN_TEST(testPathParseRoot);
+    MU_RUN_TEST(testPathParseWildcard);
+    MU_RUN_TEST(testPathParseSlice);
+    MU_RUN_TEST(testPathFindAll);
+    MU_RUN_TEST(testPathFilter);
 }
 
 int main(int argc, char *argv[]) {